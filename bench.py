@@ -0,0 +1,351 @@
+#!/usr/bin/env python3
+"""Load and latency benchmark for the bridge (BENCH=1 ./test.sh).
+
+Runs bridge.py against a local mock Telegram Bot API (TELEGRAM_API_BASE),
+with stub workers that answer every message instantly through /response,
+and drives it with synthetic webhook updates. Nothing reaches Telegram,
+tmux or a model CLI, so the numbers are the bridge's own overhead.
+
+The bridge's own send pacing (TELEGRAM_CHAT_RATE, TELEGRAM_GLOBAL_RATE) is
+raised to --send-rate, because at the production 1 msg/s per chat it would
+be the only thing measured. Use --send-rate 1 to see paced delivery.
+
+Prints one JSON line per worker count (and appends it to --output):
+webhook ack and reply delivery p50/p99 in ms, messages per second and the
+bridge's RSS, so releases can be compared.
+
+Usage:
+  bench.py [--workers 1,10,50] [--messages 200] [--concurrency 8]
+           [--latency-ms 0] [--rate-limit-every 0] [--send-rate 1000]
+           [--output FILE]
+  bench.py --serve-bridge N     (internal: bridge with N stub workers)
+"""
+
+import argparse
+import http.client
+import json
+import os
+import queue
+import re
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+
+SCRIPT_DIR = Path(__file__).resolve().parent
+ADMIN_CHAT_ID = 424242
+BENCH_ID_RE = re.compile(r"bench-(\d+)")
+
+
+def free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def percentile(values, pct):
+    """Nearest-rank percentile (None for no samples)."""
+    if not values:
+        return None
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, max(0, int(round(pct / 100 * len(ordered))) - 1))]
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Mock Telegram Bot API
+# ─────────────────────────────────────────────────────────────────────────────
+
+class MockTelegram(ThreadingHTTPServer):
+    """Answers every Bot API method with ok=true after `latency_ms`.
+
+    Every `rate_limit_every`-th sendMessage gets a 429 with retry_after=1,
+    as Telegram does past its per-chat limit. Delivery times of replies are
+    recorded by the bench-<n> id in their text.
+    """
+
+    daemon_threads = True
+
+    def __init__(self, latency_ms: float = 0, rate_limit_every: int = 0):
+        super().__init__(("127.0.0.1", 0), MockTelegramHandler)
+        self.latency = latency_ms / 1000
+        self.rate_limit_every = rate_limit_every
+        self.delivered = {}  # bench id -> monotonic time of its sendMessage
+        self.calls = {}  # method -> count
+        self.rate_limited = 0
+        self.lock = threading.Lock()
+
+    @property
+    def base_url(self) -> str:
+        return f"http://127.0.0.1:{self.server_address[1]}"
+
+    def handle_error(self, request, client_address):
+        pass  # The bridge is killed between runs; its pooled connections reset
+
+
+class MockTelegramHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, like api.telegram.org
+    disable_nagle_algorithm = True  # Headers and body go out as separate writes
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        method = self.path.rsplit("/", 1)[-1]
+        server = self.server
+        if server.latency:
+            time.sleep(server.latency)
+        with server.lock:
+            server.calls[method] = server.calls.get(method, 0) + 1
+            limited = (method == "sendMessage" and server.rate_limit_every
+                       and server.calls[method] % server.rate_limit_every == 0)
+            if limited:
+                server.rate_limited += 1
+        if limited:
+            self._reply(429, {"ok": False, "error_code": 429, "description": "Too Many Requests: retry after 1",
+                              "parameters": {"retry_after": 1}})
+            return
+        try:
+            data = json.loads(body or b"{}")
+        except ValueError:
+            data = {}  # Multipart uploads: not used by the benchmark
+        if method == "sendMessage":
+            now = time.monotonic()
+            with server.lock:
+                for bench_id in BENCH_ID_RE.findall(str(data.get("text", ""))):
+                    server.delivered.setdefault(int(bench_id), now)
+        if method == "getUpdates":
+            self._reply(200, {"ok": True, "result": []})
+            return
+        result = {"message_id": server.calls[method], "chat": {"id": data.get("chat_id")}, "date": int(time.time())}
+        self._reply(200, {"ok": True, "result": result})
+
+    def _reply(self, code: int, payload: dict):
+        body = json.dumps(payload).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Bridge with stub workers (child process)
+# ─────────────────────────────────────────────────────────────────────────────
+
+def serve_bridge(workers: int):
+    """Run bridge.main() with `workers` stub workers that reply instantly.
+
+    Workers are registered as non-interactive so routing never touches tmux.
+    send() hands the message to a few reply threads, each POSTing the answer
+    to /response over its own keep-alive connection, as the hook agent does.
+    """
+    sys.path.insert(0, str(SCRIPT_DIR))
+    import bridge
+
+    sessions = {f"w{i}": {"backend": "codex", "tmux": f"{bridge.TMUX_PREFIX}w{i}"} for i in range(workers)}
+    replies = queue.Queue()
+
+    def reply_loop():
+        conn = http.client.HTTPConnection("127.0.0.1", bridge.PORT, timeout=30)
+        while True:
+            name, message = replies.get()
+            payload = {"session": name, "text": f"re {message}", "escape": True,
+                       "trace_id": bridge.read_trace_id(name)}
+            for _ in range(2):  # One retry on a dropped keep-alive connection
+                try:
+                    conn.request("POST", "/response", body=json.dumps(payload).encode(),
+                                 headers={"Content-Type": "application/json", "Connection": "keep-alive"})
+                    conn.getresponse().read()
+                    break
+                except (OSError, http.client.HTTPException):
+                    conn.close()
+
+    for i in range(4):
+        threading.Thread(target=reply_loop, daemon=True, name=f"bench-reply-{i}").start()
+
+    manager = bridge.worker_manager
+    manager.get_registered_sessions = lambda registered=None: sessions
+    manager.is_online = lambda name, session=None: name in sessions
+    manager.send = lambda name, message, chat_id=None, session=None: replies.put((name, message)) or True
+    bridge.main()
+
+
+def start_bridge(workers: int, api_base: str, sessions_dir: str, send_rate: float) -> tuple:
+    port = free_port()
+    env = dict(
+        os.environ,
+        TELEGRAM_BOT_TOKEN="123456:bench",
+        TELEGRAM_API_BASE=api_base,
+        PORT=str(port),
+        SESSIONS_DIR=sessions_dir,
+        TMUX_PREFIX=f"bench-{os.getpid()}-",
+        ADMIN_CHAT_ID=str(ADMIN_CHAT_ID),
+        TELEGRAM_WEBHOOK_SECRET="",
+        TELEGRAM_POLLING="0",
+        BRIDGE_URL="",
+        TELEGRAM_CHAT_RATE=str(send_rate),
+        TELEGRAM_GLOBAL_RATE=str(send_rate),
+        TMUX_CONTROL="0",  # Stub workers never touch tmux; leave no control session behind
+        WORKER_POOL="",
+    )
+    proc = subprocess.Popen([sys.executable, "-u", __file__, "--serve-bridge", str(workers)],
+                            env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    deadline = time.monotonic() + 20
+    while time.monotonic() < deadline:
+        if proc.poll() is not None:
+            raise RuntimeError(f"bridge exited with {proc.returncode}")
+        try:
+            with socket.create_connection(("127.0.0.1", port), timeout=0.2):
+                return proc, port
+        except OSError:
+            time.sleep(0.05)
+    proc.kill()
+    raise RuntimeError("bridge did not start")
+
+
+def rss_kb(pid: int):
+    try:
+        for line in Path(f"/proc/{pid}/status").read_text().splitlines():
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1])
+    except OSError:
+        pass
+    try:
+        return int(subprocess.run(["ps", "-o", "rss=", "-p", str(pid)], capture_output=True, text=True).stdout)
+    except ValueError:
+        return None
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Load generator
+# ─────────────────────────────────────────────────────────────────────────────
+
+def run_load(port: int, workers: int, messages: int, concurrency: int) -> tuple:
+    """POST `messages` webhook updates, spread over the workers by @mention.
+
+    Returns ({bench id: monotonic send time}, [ack seconds]).
+    """
+    ids = queue.Queue()
+    for i in range(messages):
+        ids.put(i)
+    sent, acks, lock = {}, [], threading.Lock()
+
+    def client():
+        conn = http.client.HTTPConnection("127.0.0.1", port, timeout=30)
+        while True:
+            try:
+                i = ids.get_nowait()
+            except queue.Empty:
+                return
+            update = {"update_id": i + 1, "message": {
+                "message_id": i + 1, "date": int(time.time()),
+                "chat": {"id": ADMIN_CHAT_ID, "type": "private"}, "from": {"id": ADMIN_CHAT_ID},
+                "text": f"@w{i % workers} bench-{i}",
+            }}
+            body = json.dumps(update).encode()
+            started = time.monotonic()
+            conn.request("POST", "/", body=body, headers={"Content-Type": "application/json"})
+            conn.getresponse().read()
+            ack = time.monotonic() - started
+            with lock:
+                sent[i] = started
+                acks.append(ack)
+
+    threads = [threading.Thread(target=client, daemon=True) for _ in range(concurrency)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return sent, acks
+
+
+def bench(workers: int, messages: int, concurrency: int, latency_ms: float, rate_limit_every: int,
+          send_rate: float = 1000, timeout: float = 60) -> dict:
+    mock = MockTelegram(latency_ms, rate_limit_every)
+    threading.Thread(target=mock.serve_forever, daemon=True).start()
+    with tempfile.TemporaryDirectory() as node_dir:
+        proc, port = start_bridge(workers, mock.base_url, str(Path(node_dir) / "sessions"), send_rate)
+        try:
+            rss_idle = rss_kb(proc.pid)
+            started = time.monotonic()
+            sent, acks = run_load(port, workers, messages, concurrency)
+            deadline = time.monotonic() + timeout
+            while len(mock.delivered) < messages and time.monotonic() < deadline:
+                time.sleep(0.02)
+            with mock.lock:
+                delivered = dict(mock.delivered)
+            rss = rss_kb(proc.pid)
+        finally:
+            proc.terminate()
+            try:
+                proc.wait(5)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+            shutil.rmtree(f"/tmp/claudecode-telegram/bench-{os.getpid()}", ignore_errors=True)  # Worker pipes
+    mock.shutdown()
+
+    delivery = [delivered[i] - sent[i] for i in delivered if i in sent]
+    elapsed = (max(delivered.values()) - started) if delivered else None
+    ms = lambda seconds: round(seconds * 1000, 2) if seconds is not None else None
+    return {
+        "version": bridge_version(),
+        "workers": workers,
+        "messages": messages,
+        "delivered": len(delivered),
+        "concurrency": concurrency,
+        "latency_ms": latency_ms,
+        "send_rate": send_rate,
+        "ack_p50_ms": ms(percentile(acks, 50)),
+        "ack_p99_ms": ms(percentile(acks, 99)),
+        "delivery_p50_ms": ms(percentile(delivery, 50)),
+        "delivery_p99_ms": ms(percentile(delivery, 99)),
+        "msgs_per_sec": round(len(delivered) / elapsed, 1) if elapsed else None,
+        "rss_idle_kb": rss_idle,
+        "rss_kb": rss,
+        "rate_limited": mock.rate_limited,
+        "telegram_calls": sum(mock.calls.values()),
+    }
+
+
+def bridge_version() -> str:
+    match = re.search(r'^VERSION = "([^"]+)"', (SCRIPT_DIR / "bridge.py").read_text(), re.MULTILINE)
+    return match.group(1) if match else "unknown"
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Bridge load and latency benchmark (mock Telegram API)")
+    parser.add_argument("--workers", default="1,10,50", help="comma-separated worker counts")
+    parser.add_argument("--messages", type=int, default=200, help="webhook updates per run")
+    parser.add_argument("--concurrency", type=int, default=8, help="parallel webhook clients")
+    parser.add_argument("--latency-ms", type=float, default=0, help="mock Telegram latency per call")
+    parser.add_argument("--rate-limit-every", type=int, default=0, help="429 every Nth sendMessage (0 = never)")
+    parser.add_argument("--send-rate", type=float, default=1000, help="bridge send pacing, msgs/s (production: 1 per chat)")
+    parser.add_argument("--output", help="append JSON lines to this file")
+    parser.add_argument("--serve-bridge", type=int, help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.serve_bridge is not None:
+        serve_bridge(args.serve_bridge)
+        return 0
+
+    complete = True
+    for workers in [int(n) for n in args.workers.split(",") if n.strip()]:
+        result = bench(workers, args.messages, args.concurrency, args.latency_ms, args.rate_limit_every,
+                       args.send_rate)
+        line = json.dumps(result)
+        print(line, flush=True)
+        if args.output:
+            with open(args.output, "a") as f:
+                f.write(line + "\n")
+        complete = complete and result["delivered"] == result["messages"]
+    return 0 if complete else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
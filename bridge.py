@@ -1,20 +1,33 @@
 #!/usr/bin/env python3
 """Claude Code <-> Telegram Bridge - Multi-Session Control Panel"""
 
-VERSION = "0.19.0"
+VERSION = "0.49.0"
 
 import os
+import base64
+import bisect
+import hmac
+import hashlib
+import http.client
 import json
 import mimetypes
+import queue
 import signal
+import socket
 import subprocess
 import sys
+import tempfile
 import threading
 import time
 import re
-import urllib.request
+import select
+import selectors
+import shlex
+import shutil
+import urllib.parse
 import uuid
-from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
+from collections import OrderedDict
+from http.server import HTTPServer, BaseHTTPRequestHandler
 from pathlib import Path
 from typing import Dict, Optional, Protocol
 
@@ -23,9 +36,111 @@ from typing import Dict, Optional, Protocol
 # CONFIGURATION
 # ============================================================
 
-class ReuseAddrServer(ThreadingHTTPServer):
-    """HTTP server with SO_REUSEADDR to avoid 'Address already in use' on restart."""
+HTTP_WORKERS = int(os.environ.get("HTTP_WORKERS", "32"))  # Max requests handled at once
+HTTP_IDLE_TIMEOUT = float(os.environ.get("HTTP_IDLE_TIMEOUT", "30"))  # Seconds before an idle keep-alive closes
+
+
+class ReuseAddrServer(HTTPServer):
+    """HTTP server with SO_REUSEADDR and a bounded request pool.
+
+    ThreadingHTTPServer starts one thread per connection with no limit; here
+    at most HTTP_WORKERS connections are served at once and the rest wait in
+    the listen backlog. Webhooks are acknowledged before any work is done
+    (see UpdateDispatcher), so a request only holds a pool thread briefly.
+
+    A handler that sets `keep_open` after its last buffered request hands
+    the idle keep-alive socket back: one selector thread watches parked
+    sockets, queues a socket again when its next request arrives, and
+    closes it after `idle_timeout`. Agents' idle connections then hold no
+    pool thread, so they cannot starve webhook requests.
+    """
     allow_reuse_address = True
+    request_queue_size = 128
+
+    def __init__(self, server_address, handler_class, workers: int = HTTP_WORKERS, listen_fd: Optional[int] = None,
+                 idle_timeout: float = HTTP_IDLE_TIMEOUT):
+        # listen_fd: adopt an inherited listening socket (hot restart) instead of binding
+        super().__init__(server_address, handler_class, bind_and_activate=listen_fd is None)
+        if listen_fd is not None:
+            self.socket.close()
+            self.socket = socket.socket(fileno=listen_fd)
+            self.server_address = self.socket.getsockname()
+        self.draining = False  # Set once a hot restart handed the socket on: no more keep-alive
+        self._in_flight = 0
+        self._in_flight_lock = threading.Lock()
+        self._requests = queue.Queue()
+        self.idle_timeout = idle_timeout
+        self._to_park = []  # (socket, address) handed back by pool threads
+        self._park_lock = threading.Lock()
+        self._parked = selectors.DefaultSelector()
+        self._wake_r, self._wake_w = socket.socketpair()
+        self._wake_r.setblocking(False)
+        self._parked.register(self._wake_r, selectors.EVENT_READ, None)
+        # Daemon threads: an idle keep-alive client never blocks shutdown
+        for i in range(workers):
+            threading.Thread(target=self._serve_loop, daemon=True, name=f"http-{i}").start()
+        threading.Thread(target=self._park_loop, daemon=True, name="parked-http").start()
+
+    def process_request(self, request, client_address):
+        self._requests.put((request, client_address))
+
+    def finish_request(self, request, client_address) -> bool:
+        """Handle the connection; True if the handler wants it parked, not closed."""
+        return bool(getattr(self.RequestHandlerClass(request, client_address, self), "keep_open", False))
+
+    def _serve_loop(self):
+        while True:
+            request, client_address = self._requests.get()
+            park = False
+            try:
+                park = self.finish_request(request, client_address)
+            except Exception:
+                self.handle_error(request, client_address)
+            finally:
+                if park and not self.draining:
+                    with self._park_lock:
+                        self._to_park.append((request, client_address))
+                    self._wake_w.send(b"x")
+                else:
+                    self.shutdown_request(request)
+
+    def _park_loop(self):
+        """Watch idle keep-alive sockets; requeue on data, close after idle_timeout."""
+        while True:
+            for key, _ in self._parked.select(timeout=1.0):
+                if key.data is None:
+                    try:
+                        self._wake_r.recv(4096)
+                    except BlockingIOError:
+                        pass
+                    continue
+                self._parked.unregister(key.fileobj)
+                self._requests.put(key.data[:2])
+            with self._park_lock:
+                new, self._to_park = self._to_park, []
+            now = time.monotonic()
+            for request, client_address in new:
+                try:
+                    self._parked.register(request, selectors.EVENT_READ, (request, client_address, now))
+                except (OSError, ValueError):
+                    self.shutdown_request(request)
+            for key in list(self._parked.get_map().values()):
+                if key.data is not None and (self.draining or now - key.data[2] > self.idle_timeout):
+                    self._parked.unregister(key.fileobj)
+                    self.shutdown_request(key.fileobj)
+
+    def parked(self) -> int:
+        """Idle keep-alive connections waiting in the selector."""
+        return len(self._parked.get_map()) - 1
+
+    def request_started(self, delta: int = 1):
+        with self._in_flight_lock:
+            self._in_flight += delta
+
+    def busy(self) -> int:
+        """Connections waiting for a pool thread plus requests being handled."""
+        with self._in_flight_lock:
+            return self._requests.qsize() + self._in_flight
 
 BOT_TOKEN = os.environ.get("TELEGRAM_BOT_TOKEN", "")
 PORT = int(os.environ.get("PORT", "8080"))
@@ -44,6 +159,8 @@ PERSISTENCE_NOTE = "They'll stay on your team."
 # Default: mounts ~ to /workspace (rw)
 SANDBOX_ENABLED = os.environ.get("SANDBOX_ENABLED", "0") == "1"
 SANDBOX_IMAGE = os.environ.get("SANDBOX_IMAGE", "claudecode-telegram:latest")
+SANDBOX_REUSE = os.environ.get("SANDBOX_REUSE", "1") == "1"  # One kept container per worker, CLI via docker exec
+SANDBOX_PAUSE_IDLE = float(os.environ.get("SANDBOX_PAUSE_IDLE", "0"))  # Seconds idle before docker pause (0 = never)
 # Extra mounts from CLI: list of (host_path, container_path, readonly)
 # Parsed from SANDBOX_MOUNTS env var: "/host:/container,/path,ro:/secrets:/secrets"
 SANDBOX_EXTRA_MOUNTS = []
@@ -77,6 +194,120 @@ DEFAULT_BACKEND = "claude"
 DEFAULT_WORKER_BACKEND = DEFAULT_BACKEND
 
 
+# ============================================================
+# CORE: Metrics (GET /metrics, Prometheus text format)
+# ============================================================
+
+# Seconds; covers a 5 ms tmux call up to a 5-minute model turn
+METRICS_BUCKETS = (0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300)
+
+
+def _metric_labels(labels: tuple) -> str:
+    if not labels:
+        return ""
+    parts = []
+    for key, value in labels:
+        value = str(value).replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+        parts.append(f'{key}="{value}"')
+    return "{" + ",".join(parts) + "}"
+
+
+class Metrics:
+    """Counters and histograms recorded in-process, gauges read on scrape.
+
+    Recording is one dict update under a lock (no client library, no
+    background thread), so it stays on in production. Series that already
+    live in a component's stats dict are registered with a callback and read
+    only when /metrics is requested.
+    """
+
+    def __init__(self, buckets: tuple = METRICS_BUCKETS):
+        self.buckets = buckets
+        self._meta: Dict[str, tuple] = {}  # name -> (type, help, callback, label)
+        self._counters: Dict[tuple, float] = {}  # (name, labels) -> value
+        self._histograms: Dict[tuple, list] = {}  # (name, labels) -> [per-bucket..., +Inf, sum]
+        self._lock = threading.Lock()
+
+    def register(self, name: str, kind: str, help_text: str, callback=None, label: Optional[str] = None):
+        """Declare a series. callback() returns a number, or {label value: number}."""
+        self._meta[name] = (kind, help_text, callback, label)
+
+    def inc(self, name: str, value: float = 1, **labels):
+        key = (name, tuple(sorted(labels.items())))
+        with self._lock:
+            self._counters[key] = self._counters.get(key, 0) + value
+
+    def observe(self, name: str, seconds: float, **labels):
+        key = (name, tuple(sorted(labels.items())))
+        index = bisect.bisect_left(self.buckets, seconds)
+        with self._lock:
+            hist = self._histograms.get(key)
+            if hist is None:
+                hist = self._histograms[key] = [0] * (len(self.buckets) + 2)
+            hist[index] += 1
+            hist[-1] += seconds
+
+    def render(self) -> str:
+        with self._lock:
+            counters = dict(self._counters)
+            histograms = {key: list(hist) for key, hist in self._histograms.items()}
+        lines = []
+        for name, (kind, help_text, callback, label) in self._meta.items():
+            lines.append(f"# HELP {name} {help_text}")
+            lines.append(f"# TYPE {name} {kind}")
+            if callback is not None:
+                try:
+                    value = callback()
+                except Exception as e:
+                    print(f"Metrics: {name} callback failed: {e}")
+                    continue
+                if isinstance(value, dict):
+                    for label_value, number in sorted(value.items()):
+                        lines.append(f"{name}{_metric_labels(((label, label_value),))} {number}")
+                else:
+                    lines.append(f"{name} {value}")
+            elif kind == "histogram":
+                for (series, labels), hist in sorted(histograms.items()):
+                    if series != name:
+                        continue
+                    total = 0
+                    for bound, count in zip(self.buckets + ("+Inf",), hist):
+                        total += count
+                        lines.append(f"{name}_bucket{_metric_labels(labels + (('le', bound),))} {total}")
+                    lines.append(f"{name}_sum{_metric_labels(labels)} {round(hist[-1], 6)}")
+                    lines.append(f"{name}_count{_metric_labels(labels)} {total}")
+            else:
+                for (series, labels), value in sorted(counters.items()):
+                    if series == name:
+                        lines.append(f"{name}{_metric_labels(labels)} {value}")
+        return "\n".join(lines) + "\n"
+
+
+metrics = Metrics()
+metrics.register("telegram_requests_total", "counter", "Telegram API calls by method and HTTP status (error = no response)")
+metrics.register("telegram_api_seconds", "histogram", "Telegram API call latency by method")
+metrics.register("telegram_updates_total", "counter", "Inbound updates by result (accepted, duplicate, rejected)")
+metrics.register("update_handle_seconds", "histogram", "Time to handle one inbound update by kind (command, message, other)")
+metrics.register("tmux_command_seconds", "histogram", "tmux command latency by command and path (control, fork)")
+metrics.register("hire_seconds", "histogram", "Hire until the worker is ready, by worker, backend and source (cold, pool)")
+metrics.register("worker_turn_seconds", "histogram", "Message sent to worker until its reply reached the bridge")
+metrics.register("hook_transcript_wait_seconds", "histogram", "Time the Stop hook waited for the transcript flush")
+metrics.register("response_delivery_seconds", "histogram", "Reply received by the bridge until sent to Telegram (queue + send)")
+metrics.register("outbound_jobs_total", "counter", "Outbound dispatcher jobs by result",
+                 lambda: outbound.stats, "result")
+metrics.register("telegram_pool_total", "counter", "Telegram connection pool events",
+                 lambda: telegram_pool.stats, "event")
+metrics.register("adapter_queue_total", "counter", "Adapter queue events for non-interactive workers",
+                 lambda: adapter_queue.stats, "event")
+metrics.register("pending_workers", "gauge", "Workers with a message in progress",
+                 lambda: len(typing_ticker.pending()))
+metrics.register("outbound_queue_jobs", "gauge", "Outbound jobs queued or in flight", lambda: outbound.pending())
+metrics.register("update_queue_jobs", "gauge", "Inbound updates queued or in flight", lambda: update_dispatcher.pending())
+metrics.register("pipe_readers", "gauge", "Worker pipes watched by the multiplexer", lambda: len(pipe_mux.readers()))
+metrics.register("pane_streams", "gauge", "Worker panes streamed via pipe-pane", lambda: pane_streams.count())
+metrics.register("threads", "gauge", "Live Python threads in the bridge", threading.active_count)
+
+
 # ============================================================
 # CORE: Backend Protocol + implementations
 # ============================================================
@@ -117,33 +348,254 @@ def _get_tmux_send_lock(tmux_name: str):
         return _tmux_send_locks[tmux_name]
 
 
+TMUX_CONTROL = os.environ.get("TMUX_CONTROL", "1") != "0"  # Set 0 to fork one tmux per command
+TMUX_CONTROL_TIMEOUT = float(os.environ.get("TMUX_CONTROL_TIMEOUT", "5"))
+
+
+def _tmux_quote(arg: str) -> str:
+    """Quote one argument for a tmux command line (double quotes + escapes)."""
+    out = ['"']
+    for ch in str(arg):
+        if ch in '"\\$':
+            out.append("\\" + ch)
+        elif ch == "\n":
+            out.append("\\n")
+        elif ch == "\t":
+            out.append("\\t")
+        elif ch == "\r":
+            out.append("\\r")
+        elif ord(ch) < 32 or ord(ch) == 127:
+            out.append("\\%03o" % ord(ch))
+        else:
+            out.append(ch)
+    out.append('"')
+    return "".join(out)
+
+
+class TmuxControl:
+    """Long-lived `tmux -C` client: tmux commands over one pipe, no fork per call.
+
+    Each command is one line on stdin; tmux answers in order with a
+    %begin ... %end (or %error) block tagged with its command number.
+    Commands are written under a lock and queued as waiters; a %begin binds
+    the oldest unbound waiter to its number and the matching %end completes
+    it, so a late reply to a timed-out command is absorbed by its own waiter
+    instead of shifting later results. Notifications outside blocks are
+    ignored. The client is attached to a small "_<prefix>ctl" session that is
+    not a worker (no prefix match).
+
+    run()/run_many() return None only when a command was never written
+    (channel down); callers then fall back to subprocess (see tmux_run). A
+    written command that gets no reply in time comes back as (LOST, ""):
+    it may still run, so it must not be executed again.
+    """
+
+    LOST = -1  # Returncode for a written command whose reply never came
+
+    def __init__(self, session_name: str, socket_name: Optional[str] = None):
+        self.session_name = session_name
+        self.socket_name = socket_name
+        self.proc = None
+        self._waiters = []  # [event, result, command number] in command order
+        self._write_lock = threading.Lock()
+        self._lock = threading.Lock()
+        self._last_attempt = 0.0
+        self.stats = {"commands": 0, "errors": 0, "restarts": 0, "lost": 0}
+
+    def _tmux(self) -> list:
+        return ["tmux"] + (["-L", self.socket_name] if self.socket_name else [])
+
+    @property
+    def connected(self) -> bool:
+        return self.proc is not None and self.proc.poll() is None
+
+    def ensure(self) -> bool:
+        """Reconnect a dropped channel (only once start() was called)."""
+        if self.connected:
+            return True
+        return bool(self._last_attempt) and self.start()
+
+    def start(self) -> bool:
+        """Connect (idempotent). Retries at most every 5s after a failure."""
+        with self._lock:
+            if self.connected:
+                return True
+            now = time.monotonic()
+            if self._last_attempt and now - self._last_attempt < 5:
+                return False
+            if self._last_attempt:
+                self.stats["restarts"] += 1
+            self._last_attempt = now
+            try:
+                proc = subprocess.Popen(
+                    self._tmux() + ["-C", "new-session", "-A", "-s", self.session_name, "cat"],
+                    stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL
+                )
+            except Exception as e:
+                print(f"tmux control mode unavailable: {e}")
+                return False
+            self.proc = proc
+            self._waiters = []
+            threading.Thread(target=self._reader, args=(proc,), daemon=True, name="tmux-control").start()
+        # Pane output would only add noise to the stream
+        result = self.run(["refresh-client", "-f", "no-output"])
+        if result is None or result[0] == self.LOST:
+            print("tmux control mode failed to start, using tmux subprocesses")
+            return False
+        print(f"tmux control mode connected (session {self.session_name})")
+        return True
+
+    def _reader(self, proc):
+        block = None
+        try:
+            for raw in proc.stdout:
+                line = raw.decode("utf-8", errors="replace").rstrip("\n")
+                if block is None:
+                    parts = line.split(" ")
+                    # flags bit 1 = reply to a command we sent (0 = attach's own block)
+                    if parts[0] == "%begin" and len(parts) >= 4 and parts[3].isdigit() and int(parts[3]) & 1:
+                        block = []
+                        with self._write_lock:
+                            waiter = next((w for w in self._waiters if w[2] is None), None)
+                            if waiter:
+                                waiter[2] = parts[2]
+                    continue
+                if line.startswith(("%end ", "%error ")):
+                    rc = 0 if line.startswith("%end ") else 1
+                    number = line.split(" ")[2] if line.count(" ") >= 2 else None
+                    with self._write_lock:
+                        waiter = next((w for w in self._waiters if w[2] == number), None)
+                        if waiter:
+                            self._waiters.remove(waiter)
+                    if waiter:
+                        waiter[1] = (rc, "\n".join(block) + ("\n" if block else ""))
+                        waiter[0].set()
+                    block = None
+                    continue
+                block.append(line)
+        except Exception as e:
+            print(f"tmux control reader error: {e}")
+        self._fail_waiters(proc)
+
+    def _fail_waiters(self, proc):
+        with self._write_lock:
+            if self.proc is proc:
+                self.proc = None
+            waiters, self._waiters = self._waiters, []
+        for waiter in waiters:
+            waiter[0].set()
+
+    def run_many(self, commands: list, timeout: float = TMUX_CONTROL_TIMEOUT) -> Optional[list]:
+        """Pipeline several commands in one write; [(returncode, stdout)] or None.
+
+        None means nothing was written. Commands written but not answered
+        within `timeout` (or cut off by a dropped channel) come back as
+        (LOST, "").
+        """
+        proc = self.proc
+        if proc is None or proc.poll() is not None:
+            return None
+        waiters = [[threading.Event(), None, None] for _ in commands]
+        payload = "".join(" ".join(_tmux_quote(a) for a in cmd) + "\n" for cmd in commands)
+        try:
+            with self._write_lock:
+                self._waiters.extend(waiters)
+                proc.stdin.write(payload.encode("utf-8"))
+                proc.stdin.flush()
+        except Exception as e:
+            print(f"tmux control write failed: {e}")
+            self._fail_waiters(proc)
+            return None
+        deadline = time.monotonic() + timeout
+        for waiter in waiters:
+            # A late reply still lands on its own waiter, so the channel stays usable
+            waiter[0].wait(max(0.0, deadline - time.monotonic()))
+        results = [w[1] if w[1] is not None else (self.LOST, "") for w in waiters]
+        lost = sum(1 for w in waiters if w[1] is None)
+        if lost:
+            print(f"tmux control: no reply to {lost} command(s) within {timeout}s, not retrying")
+        self.stats["commands"] += len(commands)
+        self.stats["lost"] += lost
+        self.stats["errors"] += sum(1 for r in results if r[0] != 0)
+        return results
+
+    def run(self, args: list, timeout: float = TMUX_CONTROL_TIMEOUT) -> Optional[tuple]:
+        results = self.run_many([args], timeout)
+        return results[0] if results else None
+
+    def close(self, kill_session: bool = True):
+        """Disconnect; by default also remove the control session."""
+        proc = self.proc
+        if proc is None:
+            return
+        if kill_session:
+            self._last_attempt = 0.0  # Intentional close: no auto-reconnect
+            self.run(["kill-session", "-t", self.session_name], timeout=1)
+        try:
+            proc.stdin.close()
+        except Exception:
+            pass
+        try:
+            proc.terminate()
+        except Exception:
+            pass
+        self._fail_waiters(proc)
+
+
+tmux_control = TmuxControl(f"_{TMUX_PREFIX}ctl")
+
+
+def tmux_run(args: list, capture: bool = True) -> tuple:
+    """Run one tmux command -> (returncode, stdout).
+
+    Uses the control-mode channel when connected, else forks `tmux`. A
+    command already written to the channel is never forked again, even if
+    its reply was lost; it returns TmuxControl.LOST instead.
+    """
+    started = time.monotonic()
+    if tmux_control.ensure():
+        result = tmux_control.run(args)
+        if result is not None:
+            metrics.observe("tmux_command_seconds", time.monotonic() - started, command=args[0], path="control")
+            return result
+    result = subprocess.run(["tmux"] + list(args), capture_output=capture, text=True)
+    metrics.observe("tmux_command_seconds", time.monotonic() - started, command=args[0], path="fork")
+    return result.returncode, ((result.stdout or "") if capture else "")
+
+
+def tmux_run_many(commands: list) -> list:
+    """Run several tmux commands in one round trip when the channel is up.
+
+    Falls back to forking only when the batch was never written.
+    """
+    started = time.monotonic()
+    if tmux_control.ensure():
+        results = tmux_control.run_many(commands)
+        if results is not None:
+            metrics.observe("tmux_command_seconds", time.monotonic() - started, command="batch", path="control")
+            return results
+    return [tmux_run(cmd) for cmd in commands]
+
+
 def tmux_exists(tmux_name: str) -> bool:
     """Check if tmux session exists."""
-    return subprocess.run(
-        ["tmux", "has-session", "-t", tmux_name],
-        capture_output=True
-    ).returncode == 0
+    return tmux_run(["has-session", "-t", tmux_name])[0] == 0
 
 
 def tmux_send_message(tmux_name: str, text: str) -> bool:
     """Send text + Enter to tmux session with locking."""
     lock = _get_tmux_send_lock(tmux_name)
     with lock:
-        result = subprocess.run(["tmux", "send-keys", "-t", tmux_name, "-l", text])
-        if result.returncode != 0:
+        if tmux_run(["send-keys", "-t", tmux_name, "-l", text], capture=False)[0] != 0:
             return False
         time.sleep(0.2)  # Delay to let terminal process text before Enter
-        result = subprocess.run(["tmux", "send-keys", "-t", tmux_name, "Enter"])
-        return result.returncode == 0
+        return tmux_run(["send-keys", "-t", tmux_name, "Enter"], capture=False)[0] == 0
 
 
 def get_pane_command(tmux_name: str) -> str:
     """Get the current command running in tmux pane."""
-    result = subprocess.run(
-        ["tmux", "display-message", "-t", tmux_name, "-p", "#{pane_current_command}"],
-        capture_output=True, text=True
-    )
-    return result.stdout.strip() if result.returncode == 0 else ""
+    rc, out = tmux_run(["display-message", "-t", tmux_name, "-p", "#{pane_current_command}"])
+    return out.strip() if rc == 0 else ""
 
 
 def is_process_running(tmux_name: str, process_name: str) -> bool:
@@ -152,14 +604,11 @@ def is_process_running(tmux_name: str, process_name: str) -> bool:
     if process_name.lower() in cmd.lower():
         return True
 
-    result = subprocess.run(
-        ["tmux", "display-message", "-t", tmux_name, "-p", "#{pane_pid}"],
-        capture_output=True, text=True
-    )
-    if result.returncode != 0:
+    rc, out = tmux_run(["display-message", "-t", tmux_name, "-p", "#{pane_pid}"])
+    if rc != 0:
         return False
 
-    pane_pid = result.stdout.strip()
+    pane_pid = out.strip()
     if not pane_pid:
         return False
 
@@ -171,7 +620,130 @@ def is_process_running(tmux_name: str, process_name: str) -> bool:
 
 
 def tmux_send_escape(tmux_name: str):
-    subprocess.run(["tmux", "send-keys", "-t", tmux_name, "Escape"])
+    tmux_run(["send-keys", "-t", tmux_name, "Escape"], capture=False)
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Adapter queue (non-interactive backends: one adapter run per worker)
+# ─────────────────────────────────────────────────────────────────────────────
+
+ADAPTER_QUEUE_DEPTH = int(os.environ.get("ADAPTER_QUEUE_DEPTH", "20"))  # Waiting messages per worker
+ADAPTER_MERGE = os.environ.get("ADAPTER_MERGE", "1") != "0"  # Set 0 to run queued messages one by one
+ADAPTER_MERGE_MAX_CHARS = 64 * 1024  # Merged prompt travels as one argv string (Linux max 128 KB)
+
+
+class AdapterQueue:
+    """Per-worker FIFO in front of the non-interactive adapters.
+
+    Every codex/gemini/opencode message used to Popen its own adapter, and
+    the adapters then queued on a flock in arrival-agnostic order. Here each
+    worker has at most one adapter process; messages arriving meanwhile wait
+    in order (up to ADAPTER_QUEUE_DEPTH, then submit() refuses). When the run
+    finishes, everything waiting is merged into one prompt (blank-line
+    separated, up to ADAPTER_MERGE_MAX_CHARS) so a burst costs one CLI call.
+
+    The drain thread exists only while a worker has work.
+    """
+
+    def __init__(self, depth: int = ADAPTER_QUEUE_DEPTH, merge: bool = ADAPTER_MERGE):
+        self.depth = depth
+        self.merge = merge
+        self._queues: Dict[str, list] = {}  # name -> [(text, run)]
+        self._running: Dict[str, int] = {}  # name -> messages in the current run
+        self._lock = threading.Lock()
+        self.stats = {"runs": 0, "messages": 0, "merged": 0, "rejected": 0}
+
+    def submit(self, name: str, text: str, run) -> bool:
+        """Queue a message; run(prompt) performs one adapter turn."""
+        with self._lock:
+            queue = self._queues.setdefault(name, [])
+            if len(queue) >= self.depth:
+                self.stats["rejected"] += 1
+                print(f"Adapter queue full for '{name}' ({len(queue)} waiting), message refused")
+                return False
+            queue.append((text, run))
+            self.stats["messages"] += 1
+            if name in self._running:
+                return True
+            self._running[name] = 0
+        threading.Thread(target=self._drain, args=(name,), daemon=True, name=f"adapter-{name}").start()
+        return True
+
+    def _next_batch(self, name: str) -> Optional[tuple]:
+        with self._lock:
+            queue = self._queues.get(name)
+            if not queue:
+                self._queues.pop(name, None)
+                self._running.pop(name, None)
+                return None
+            count, size = 1, len(queue[0][0])
+            while self.merge and count < len(queue):
+                size += len(queue[count][0]) + 2
+                if size > ADAPTER_MERGE_MAX_CHARS:
+                    break
+                count += 1
+            batch, queue[:count] = queue[:count], []
+            self._running[name] = count
+            self.stats["runs"] += 1
+            if count > 1:
+                self.stats["merged"] += count
+        return "\n\n".join(text for text, _ in batch), batch[-1][1], count
+
+    def _drain(self, name: str):
+        while True:
+            batch = self._next_batch(name)
+            if batch is None:
+                return
+            prompt, run, count = batch
+            if count > 1:
+                print(f"Adapter run for '{name}': {count} queued messages merged")
+            try:
+                run(prompt)
+            except Exception as e:
+                print(f"Adapter run for '{name}' failed: {e}")
+
+    def busy(self) -> int:
+        """Workers with an adapter run in progress or messages waiting."""
+        with self._lock:
+            return len(self._running)
+
+    def depth_of(self, name: str) -> tuple:
+        """(waiting, in_flight) messages for a worker."""
+        with self._lock:
+            return len(self._queues.get(name, ())), self._running.get(name, 0)
+
+    def is_full(self, name: str) -> bool:
+        return self.depth_of(name)[0] >= self.depth
+
+    def discard(self, name: str) -> int:
+        """Drop a worker's waiting messages (the current run finishes)."""
+        with self._lock:
+            dropped = len(self._queues.get(name, ()))
+            if name in self._queues:
+                self._queues[name] = []
+        return dropped
+
+
+adapter_queue = AdapterQueue()
+
+
+def queue_adapter(backend: str, adapter: Path, worker_name: str, text: str,
+                  bridge_url: str, sessions_dir: Path) -> bool:
+    """Send one message through a non-interactive adapter (queued).
+
+    With ADAPTER_AGENT=1 the turn runs in the worker's resident adapter agent;
+    if the agent cannot start, it runs a cold adapter process as before.
+    """
+    def run(prompt: str):
+        tracer.span(read_trace_id(worker_name), "adapter_start", worker=worker_name)
+        if ADAPTER_AGENT:
+            agent = adapter_agents.get(worker_name, backend, bridge_url, sessions_dir)
+            if agent and agent.run(prompt):
+                return
+        subprocess.run(["python3", str(adapter), worker_name, prompt, bridge_url, str(sessions_dir)],
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    return adapter_queue.submit(worker_name, text, run)
 
 
 class ClaudeBackend:
@@ -209,12 +781,7 @@ class CodexBackend:
             print(f"Codex adapter not found: {adapter}")
             return False
 
-        subprocess.Popen(
-            ["python3", str(adapter), worker_name, text, bridge_url, str(sessions_dir)],
-            stdout=subprocess.DEVNULL,
-            stderr=subprocess.DEVNULL
-        )
-        return True
+        return queue_adapter(self.name, adapter, worker_name, text, bridge_url, sessions_dir)
 
     def is_online(self, tmux_name: str) -> bool:
         return tmux_exists(tmux_name)
@@ -235,12 +802,7 @@ class GeminiBackend:
             print(f"Gemini adapter not found: {adapter}")
             return False
 
-        subprocess.Popen(
-            ["python3", str(adapter), worker_name, text, bridge_url, str(sessions_dir)],
-            stdout=subprocess.DEVNULL,
-            stderr=subprocess.DEVNULL
-        )
-        return True
+        return queue_adapter(self.name, adapter, worker_name, text, bridge_url, sessions_dir)
 
     def is_online(self, tmux_name: str) -> bool:
         return tmux_exists(tmux_name)
@@ -261,12 +823,7 @@ class OpenCodeBackend:
             print(f"OpenCode adapter not found: {adapter}")
             return False
 
-        subprocess.Popen(
-            ["python3", str(adapter), worker_name, text, bridge_url, str(sessions_dir)],
-            stdout=subprocess.DEVNULL,
-            stderr=subprocess.DEVNULL
-        )
-        return True
+        return queue_adapter(self.name, adapter, worker_name, text, bridge_url, sessions_dir)
 
     def is_online(self, tmux_name: str) -> bool:
         return tmux_exists(tmux_name)
@@ -310,6 +867,7 @@ admin_chat_id = int(ADMIN_CHAT_ID_ENV) if ADMIN_CHAT_ID_ENV else None
 NODE_DIR = SESSIONS_DIR.parent  # ~/.claude/telegram/nodes/<node>
 LAST_CHAT_ID_FILE = NODE_DIR / "last_chat_id"
 LAST_ACTIVE_FILE = NODE_DIR / "last_active"
+UPDATE_OFFSET_FILE = NODE_DIR / "update_offset"  # getUpdates offset (TELEGRAM_POLLING=1)
 
 BOT_COMMANDS = [
     # Daily commands (frequency-first, natural workflow order)
@@ -342,11 +900,9 @@ BLOCKED_COMMANDS = [
 # ─────────────────────────────────────────────────────────────────────────────
 
 def save_last_chat_id(chat_id):
-    """Save last known chat ID to file for auto-notification on restart."""
+    """Save last known chat ID to file for auto-notification on restart (no-op if unchanged)."""
     try:
-        NODE_DIR.mkdir(parents=True, exist_ok=True, mode=0o700)
-        LAST_CHAT_ID_FILE.write_text(str(chat_id))
-        LAST_CHAT_ID_FILE.chmod(0o600)
+        session_store.write(LAST_CHAT_ID_FILE, str(chat_id))
     except Exception as e:
         print(f"Failed to save last_chat_id: {e}")
 
@@ -364,11 +920,9 @@ def load_last_chat_id():
 
 
 def save_last_active(name):
-    """Save last active worker name to file for auto-focus on restart."""
+    """Save last active worker name to file for auto-focus on restart (no-op if unchanged)."""
     try:
-        NODE_DIR.mkdir(parents=True, exist_ok=True, mode=0o700)
-        LAST_ACTIVE_FILE.write_text(name)
-        LAST_ACTIVE_FILE.chmod(0o600)
+        session_store.write(LAST_ACTIVE_FILE, name)
     except Exception as e:
         print(f"Failed to save last_active: {e}")
 
@@ -397,22 +951,253 @@ RESERVED_NAMES = {
 # TELEGRAM API
 # ============================================================
 
+# ─────────────────────────────────────────────────────────────────────────────
+# Keep-alive connection pool (shared by all outbound Telegram calls)
+# ─────────────────────────────────────────────────────────────────────────────
+
+TELEGRAM_API_BASE = os.environ.get("TELEGRAM_API_BASE", "https://api.telegram.org").rstrip("/")  # Local Bot API server or bench mock
+TELEGRAM_POOL_SIZE = int(os.environ.get("TELEGRAM_POOL_SIZE", "8"))  # Max idle connections kept
+TELEGRAM_POOL_IDLE_TIMEOUT = float(os.environ.get("TELEGRAM_POOL_IDLE_TIMEOUT", "60"))  # Seconds
+TELEGRAM_POOL_LOG_EVERY = 100  # Log pool stats every N requests
+DOWNLOAD_CHUNK_SIZE = 64 * 1024  # Bytes per read when streaming a response to disk
+
+# Errors that mean a reused keep-alive socket was closed by the server while idle
+_STALE_CONNECTION_ERRORS = (
+    http.client.RemoteDisconnected,
+    http.client.CannotSendRequest,
+    ConnectionResetError,
+    BrokenPipeError,
+)
+
+
+class TelegramConnectionPool:
+    """Pool of keep-alive HTTPS connections to the Telegram API.
+
+    Saves DNS + TCP + TLS setup on every call. Connections are checked out
+    per request and returned when the response is fully read. At most `size`
+    idle connections are kept; idle ones older than `idle_timeout` are closed.
+    """
+
+    # Safe to send twice; anything else (sendMessage, uploads) may already
+    # have been delivered once the request is written
+    IDEMPOTENT_METHODS = {"getUpdates", "getFile", "getMe", "getWebhookInfo", "sendChatAction"}
+
+    def __init__(self, base_url: str, size: int = TELEGRAM_POOL_SIZE,
+                 idle_timeout: float = TELEGRAM_POOL_IDLE_TIMEOUT):
+        parsed = urllib.parse.urlsplit(base_url)
+        self.scheme = parsed.scheme or "https"
+        self.host = parsed.hostname or ""
+        self.port = parsed.port
+        self.size = size
+        self.idle_timeout = idle_timeout
+        self._idle = []  # [(conn, last_used)]
+        self._lock = threading.Lock()
+        self.stats = {"requests": 0, "created": 0, "reused": 0, "stale": 0, "expired": 0}
+
+    def _new_connection(self, timeout: float):
+        if self.scheme == "https":
+            conn = http.client.HTTPSConnection(self.host, self.port, timeout=timeout)
+        else:
+            conn = http.client.HTTPConnection(self.host, self.port, timeout=timeout)
+        with self._lock:
+            self.stats["created"] += 1
+        return conn
+
+    def _acquire(self, timeout: float):
+        """Return (conn, reused). Drops idle connections past idle_timeout."""
+        now = time.time()
+        expired = []
+        conn = None
+        dropped = []
+        with self._lock:
+            while self._idle:
+                candidate, last_used = self._idle.pop()
+                if now - last_used > self.idle_timeout:
+                    expired.append(candidate)
+                    continue
+                if self._dropped(candidate):
+                    dropped.append(candidate)
+                    continue
+                conn = candidate
+                self.stats["reused"] += 1
+                break
+            self.stats["expired"] += len(expired)
+            self.stats["stale"] += len(dropped)
+        for old in expired + dropped:
+            old.close()
+        if conn is None:
+            return self._new_connection(timeout), False
+        conn.timeout = timeout
+        if conn.sock:
+            conn.sock.settimeout(timeout)
+        return conn, True
+
+    @staticmethod
+    def _dropped(conn) -> bool:
+        """An idle keep-alive socket that is readable was closed by the server."""
+        if conn.sock is None:
+            return True
+        try:
+            return bool(select.select([conn.sock], [], [], 0)[0])
+        except (OSError, ValueError):
+            return True
+
+    def _release(self, conn, reusable: bool):
+        if reusable:
+            with self._lock:
+                if len(self._idle) < self.size:
+                    self._idle.append((conn, time.time()))
+                    return
+        conn.close()
+
+    def _log_stats(self):
+        s = self.stats
+        if s["requests"] % TELEGRAM_POOL_LOG_EVERY == 0:
+            print(f"Telegram pool: {s['requests']} requests, {s['created']} connections, "
+                  f"{s['reused']} reused, {s['stale']} stale, {len(self._idle)} idle")
+
+    def request(self, method: str, path: str, body=None, headers: Optional[dict] = None,
+                timeout: float = 10, sink=None) -> tuple[int, bytes]:
+        """Send a request and return (status, body). Raises on network errors.
+
+        Every call is counted and timed per Telegram method (file downloads
+        as "download", so neither the token nor file paths become labels).
+        """
+        api_method = path.rsplit("/", 1)[-1] if path.startswith("/bot") else "download"
+        started = time.monotonic()
+        code = "error"
+        try:
+            status, data = self._request(method, path, body, headers, timeout, sink)
+            code = str(status)
+            return status, data
+        finally:
+            metrics.inc("telegram_requests_total", method=api_method, code=code)
+            metrics.observe("telegram_api_seconds", time.monotonic() - started, method=api_method)
+
+    def _request(self, method: str, path: str, body, headers: Optional[dict],
+                 timeout: float, sink) -> tuple[int, bytes]:
+        """Send a request and return (status, body). Raises on network errors.
+
+        Idle connections the server already closed are dropped before use.
+        A reused connection that still turns out to be stale is replaced once
+        with a fresh one if the request was never written, or if the method
+        is in IDEMPOTENT_METHODS or a GET. Otherwise the error propagates,
+        because a resent sendMessage would post twice. Fresh connections are
+        never retried.
+
+        With `sink`, a 200 body is passed to sink(chunk) in DOWNLOAD_CHUNK_SIZE
+        pieces instead of being returned (body is b""). The stale retry only
+        covers the request and status line, so the sink never sees a body
+        twice. If sink raises, the connection is dropped and the error
+        propagates.
+        """
+        with self._lock:
+            self.stats["requests"] += 1
+        idempotent = method == "GET" or path.rsplit("/", 1)[-1] in self.IDEMPOTENT_METHODS
+        conn, reused = self._acquire(timeout)
+        while True:
+            sent = False
+            try:
+                conn.request(method, path, body=body, headers=headers or {})
+                sent = True
+                response = conn.getresponse()
+                streaming = sink is not None and response.status == 200
+                data = b"" if streaming else response.read()
+            except _STALE_CONNECTION_ERRORS:
+                conn.close()
+                if not reused or (sent and not idempotent):
+                    raise
+                with self._lock:
+                    self.stats["stale"] += 1
+                conn, reused = self._new_connection(timeout), False
+                continue
+            except Exception:
+                conn.close()
+                raise
+            if streaming:
+                try:
+                    while True:
+                        chunk = response.read(DOWNLOAD_CHUNK_SIZE)
+                        if not chunk:
+                            break
+                        sink(chunk)
+                except Exception:
+                    conn.close()
+                    raise
+            self._release(conn, not response.will_close)
+            self._log_stats()
+            return response.status, data
+
+    def close(self):
+        """Close all idle connections."""
+        with self._lock:
+            idle, self._idle = self._idle, []
+        for conn, _ in idle:
+            conn.close()
+
+
+telegram_pool = TelegramConnectionPool(TELEGRAM_API_BASE)
+
+
+def _telegram_error_description(status: int, data: bytes) -> str:
+    """Extract Telegram's error description from a non-200 response body."""
+    try:
+        return json.loads(data).get("description", "") or f"HTTP {status}"
+    except Exception:
+        return f"HTTP {status}"
+
+
+class TelegramRetryAfter(Exception):
+    """Telegram answered 429 Too Many Requests."""
+
+    def __init__(self, method: str, retry_after: float):
+        super().__init__(f"{method}: rate limited, retry after {retry_after}s")
+        self.method = method
+        self.retry_after = retry_after
+
+
+def _telegram_retry_after(data: bytes) -> float:
+    """Extract parameters.retry_after (seconds) from a 429 response body."""
+    try:
+        return float(json.loads(data).get("parameters", {}).get("retry_after", 1))
+    except Exception:
+        return 1.0
+
+
 class TelegramAPI:
-    def __init__(self, token: str):
+    def __init__(self, token: str, pool: Optional[TelegramConnectionPool] = None):
         self.token = token
+        self.pool = pool or telegram_pool
 
-    def api(self, method: str, data: dict):
+    def request(self, method: str, data: dict, timeout: float = 10):
+        """Call a Telegram method. Like api(), but raises TelegramRetryAfter on 429."""
         if not self.token:
             return None
-        req = urllib.request.Request(
-            f"https://api.telegram.org/bot{self.token}/{method}",
-            data=json.dumps(data).encode(),
-            headers={"Content-Type": "application/json"}
-        )
         try:
-            with urllib.request.urlopen(req, timeout=10) as r:
-                return json.loads(r.read())
+            status, body = self.pool.request(
+                "POST", f"/bot{self.token}/{method}",
+                body=json.dumps(data).encode(),
+                headers={"Content-Type": "application/json"},
+                timeout=timeout
+            )
+        except Exception as e:
+            print(f"Telegram API error: {method}: {e}")
+            return None
+        if status == 429:
+            raise TelegramRetryAfter(method, _telegram_retry_after(body))
+        if status != 200:
+            print(f"Telegram API error: {method}: HTTP {status} {_telegram_error_description(status, body)}")
+            return None
+        try:
+            return json.loads(body)
         except Exception as e:
+            print(f"Telegram API error: {method}: invalid JSON: {e}")
+            return None
+
+    def api(self, method: str, data: dict):
+        try:
+            return self.request(method, data)
+        except TelegramRetryAfter as e:
             print(f"Telegram API error: {e}")
             return None
 
@@ -446,6 +1231,240 @@ def telegram_api(method, data):
     return telegram.api(method, data)
 
 
+# ─────────────────────────────────────────────────────────────────────────────
+# Outbound send dispatcher (bounded queue + per-chat/global rate limits)
+# ─────────────────────────────────────────────────────────────────────────────
+
+# Telegram guidance: ~1 msg/s per chat (short bursts OK), ~30 msg/s overall
+TELEGRAM_SEND_WORKERS = int(os.environ.get("TELEGRAM_SEND_WORKERS", "4"))
+TELEGRAM_SEND_QUEUE_SIZE = int(os.environ.get("TELEGRAM_SEND_QUEUE_SIZE", "200"))
+TELEGRAM_CHAT_RATE = float(os.environ.get("TELEGRAM_CHAT_RATE", "1"))  # Messages/second per chat
+TELEGRAM_CHAT_BURST = int(os.environ.get("TELEGRAM_CHAT_BURST", "5"))
+TELEGRAM_GLOBAL_RATE = float(os.environ.get("TELEGRAM_GLOBAL_RATE", "30"))  # Messages/second total
+TELEGRAM_MAX_RETRIES = int(os.environ.get("TELEGRAM_MAX_RETRIES", "3"))  # 429 retries per call
+TELEGRAM_UPLOAD_CONCURRENCY = int(os.environ.get("TELEGRAM_UPLOAD_CONCURRENCY", "4"))  # Parallel uploads per response
+BROADCAST_CONCURRENCY = int(os.environ.get("BROADCAST_CONCURRENCY", "8"))  # Parallel targets for @all and /notify
+
+
+class TokenBucket:
+    """Token bucket rate limiter. reserve() takes a token and returns the wait."""
+
+    def __init__(self, rate: float, burst: int):
+        self.rate = rate
+        self.burst = burst
+        self.tokens = float(burst)
+        self.updated = time.monotonic()
+        self._lock = threading.Lock()
+
+    def _refill(self):
+        now = time.monotonic()
+        self.tokens = min(self.burst, self.tokens + (now - self.updated) * self.rate)
+        self.updated = now
+
+    def reserve(self) -> float:
+        """Consume one token; return seconds to wait before using it."""
+        with self._lock:
+            self._refill()
+            self.tokens -= 1
+            return 0.0 if self.tokens >= 0 else -self.tokens / self.rate
+
+    def pause(self, seconds: float):
+        """Block the bucket for `seconds` (e.g. Telegram retry_after)."""
+        with self._lock:
+            self._refill()
+            self.tokens = min(self.tokens, 0.0) - seconds * self.rate
+
+
+class ChatOrderedQueue:
+    """Bounded job queue drained by a fixed pool, one job per chat at a time.
+
+    Jobs for the same chat run in submit order; different chats run in
+    parallel on at most `workers` threads.
+    """
+
+    name = "queue"
+
+    def __init__(self, workers: int, max_queue: int):
+        self.workers = workers
+        self.max_queue = max_queue
+        self._chats: Dict[str, list] = {}  # chat_id -> [(label, job)] in submit order
+        self._ready = []  # chat_ids with queued jobs and no job in flight
+        self._busy = set()  # chat_ids with a job in flight
+        self._queued = 0
+        self._cond = threading.Condition()
+        self._threads = []
+        self.stats = {"submitted": 0, "completed": 0, "rejected": 0, "failed": 0}
+
+    def start(self):
+        """Start worker threads (idempotent)."""
+        with self._cond:
+            if self._threads:
+                return
+            for i in range(self.workers):
+                t = threading.Thread(target=self._worker_loop, daemon=True, name=f"{self.name}-{i}")
+                self._threads.append(t)
+                t.start()
+
+    def submit(self, chat_id, job, label: str = "") -> bool:
+        """Queue a job for a chat. Returns False if the queue is full."""
+        self.start()
+        key = str(chat_id)
+        with self._cond:
+            if self._queued >= self.max_queue:
+                self.stats["rejected"] += 1
+                print(f"{self.name.capitalize()} queue full ({self._queued}/{self.max_queue}): "
+                      f"rejected {label or 'job'} for chat {key}")
+                return False
+            self._chats.setdefault(key, []).append((label, job))
+            if key not in self._busy and key not in self._ready:
+                self._ready.append(key)
+            self._queued += 1
+            self.stats["submitted"] += 1
+            self._cond.notify()
+        return True
+
+    def pending(self) -> int:
+        """Number of jobs queued or in flight."""
+        with self._cond:
+            return self._queued
+
+    def _worker_loop(self):
+        while True:
+            with self._cond:
+                while not self._ready:
+                    self._cond.wait()
+                key = self._ready.pop(0)
+                label, job = self._chats[key].pop(0)
+                self._busy.add(key)
+            try:
+                job()
+            except Exception as e:
+                with self._cond:
+                    self.stats["failed"] += 1
+                print(f"{self.name.capitalize()} job error ({label or 'job'} -> chat {key}): {e}")
+            with self._cond:
+                self._busy.discard(key)
+                self._queued -= 1
+                self.stats["completed"] += 1
+                if self._chats.get(key):
+                    self._ready.append(key)
+                    self._cond.notify()
+                else:
+                    self._chats.pop(key, None)
+                self._cond.notify_all()
+
+
+def fan_out(fn, items: list, limit: int) -> list:
+    """Call fn(item) for every item on up to `limit` threads; results in input order.
+
+    The calling thread waits for all of them. An item whose call raises
+    gets None.
+    """
+    results = [None] * len(items)
+
+    def run(i):
+        try:
+            results[i] = fn(items[i])
+        except Exception as e:
+            print(f"Fan-out error ({items[i]!r}): {e}")
+
+    if len(items) <= 1 or limit <= 1:
+        for i in range(len(items)):
+            run(i)
+        return results
+    next_index = iter(range(len(items)))
+    lock = threading.Lock()
+
+    def worker():
+        while True:
+            with lock:
+                i = next(next_index, None)
+            if i is None:
+                return
+            run(i)
+
+    threads = [threading.Thread(target=worker, daemon=True) for _ in range(min(limit, len(items)))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return results
+
+
+class OutboundDispatcher(ChatOrderedQueue):
+    """Bounded queue of Telegram send jobs drained by a small worker pool.
+
+    Jobs for the same chat run one at a time in submit order (chunk order is
+    kept); different chats are sent in parallel. Every send inside a job goes
+    through call()/throttle(), which apply per-chat + global token buckets and
+    honor retry_after on 429.
+    """
+
+    name = "outbound"
+
+    def __init__(self, api: TelegramAPI, workers: int = TELEGRAM_SEND_WORKERS,
+                 max_queue: int = TELEGRAM_SEND_QUEUE_SIZE):
+        super().__init__(workers, max_queue)
+        self.telegram = api
+        self.global_bucket = TokenBucket(TELEGRAM_GLOBAL_RATE, max(1, int(TELEGRAM_GLOBAL_RATE)))
+        self._chat_buckets: Dict[str, TokenBucket] = {}
+        self.stats["rate_limited"] = 0
+
+    def _chat_bucket(self, key: str) -> TokenBucket:
+        with self._cond:
+            bucket = self._chat_buckets.get(key)
+            if bucket is None:
+                bucket = TokenBucket(TELEGRAM_CHAT_RATE, TELEGRAM_CHAT_BURST)
+                self._chat_buckets[key] = bucket
+            return bucket
+
+    def throttle(self, chat_id):
+        """Wait until both the chat and global buckets allow one more send."""
+        wait = max(self._chat_bucket(str(chat_id)).reserve(), self.global_bucket.reserve())
+        if wait > 0:
+            time.sleep(wait)
+
+    def send_with_retries(self, chat_id, method: str, send):
+        """Throttle, run send(), and wait out 429 retry_after up to TELEGRAM_MAX_RETRIES."""
+        for attempt in range(TELEGRAM_MAX_RETRIES + 1):
+            self.throttle(chat_id)
+            try:
+                return send()
+            except TelegramRetryAfter as e:
+                with self._cond:
+                    self.stats["rate_limited"] += 1
+                self._chat_bucket(str(chat_id)).pause(e.retry_after)
+                print(f"Telegram 429: {method} to chat {chat_id}, retry after {e.retry_after}s "
+                      f"(attempt {attempt + 1}/{TELEGRAM_MAX_RETRIES + 1})")
+        print(f"Telegram API error: {method} to chat {chat_id} still rate limited after {TELEGRAM_MAX_RETRIES} retries")
+        return None
+
+    def call(self, chat_id, method: str, data: dict):
+        """Rate-limited Telegram call; waits out 429 retry_after up to TELEGRAM_MAX_RETRIES."""
+        return self.send_with_retries(chat_id, method, lambda: self.telegram.request(method, data))
+
+    def upload_many(self, chat_id, uploads: list, limit: int = TELEGRAM_UPLOAD_CONCURRENCY) -> list:
+        """Run (method, fn) uploads for one chat in parallel; results in input order.
+
+        Called from inside a job, so the chat's job order is unchanged; only
+        the uploads of one response overlap (at most `limit` at once). Each
+        upload is rate-limited and retried like call(); an upload that raises
+        returns None.
+        """
+        def run(upload):
+            method, fn = upload
+            try:
+                return self.send_with_retries(chat_id, method, fn)
+            except Exception as e:
+                print(f"Upload error: {method} to chat {chat_id}: {e}")
+                return None
+
+        return fan_out(run, uploads, limit)
+
+
+outbound = OutboundDispatcher(telegram)
+
+
 # ============================================================
 # MEDIA HANDLING
 # ============================================================
@@ -516,7 +1535,7 @@ def ensure_inbox_dir(session_name):
 
 
 def cleanup_inbox(session_name):
-    """Clean up all files in a session's inbox."""
+    """Clean up all files in a session's inbox, then unreferenced cache entries."""
     inbox = get_inbox_dir(session_name)
     if inbox.exists():
         for f in inbox.iterdir():
@@ -524,6 +1543,237 @@ def cleanup_inbox(session_name):
                 f.unlink()
             except Exception as e:
                 print(f"Failed to delete {f}: {e}")
+    prune_inbox_cache()
+
+
+# Per-node download cache: one copy per Telegram file_unique_id, hardlinked
+# into each inbox that receives it. Worker names are [a-z0-9-], so "_cache"
+# never collides with an inbox directory.
+INBOX_CACHE_DIR = FILE_INBOX_ROOT / "_cache"
+
+
+def _cache_key(file_unique_id) -> Optional[str]:
+    key = re.sub(r"[^A-Za-z0-9_-]", "", str(file_unique_id or ""))
+    return key or None
+
+
+def find_cached_file(file_unique_id) -> Optional[Path]:
+    """Cached download for a file_unique_id, if present."""
+    key = _cache_key(file_unique_id)
+    if not key or not INBOX_CACHE_DIR.exists():
+        return None
+    for entry in INBOX_CACHE_DIR.glob(f"{key}*"):
+        if entry.stem == key and entry.is_file():
+            return entry
+    return None
+
+
+def link_into_inbox(source: Path, inbox: Path, ext: Optional[str] = None) -> Path:
+    """Place a cached file in an inbox: hardlink, or a copy across filesystems."""
+    dest = inbox / f"{uuid.uuid4().hex}{source.suffix if ext is None else ext}"
+    try:
+        os.link(source, dest)
+    except OSError:
+        shutil.copyfile(source, dest)
+        dest.chmod(0o400)
+    return dest
+
+
+def prune_inbox_cache():
+    """Drop cache entries no inbox links to any more (link count 1)."""
+    if not INBOX_CACHE_DIR.exists():
+        return 0
+    removed = 0
+    for entry in INBOX_CACHE_DIR.iterdir():
+        if entry.name.startswith("."):
+            continue  # Download in progress
+        try:
+            if entry.stat().st_nlink <= 1:
+                entry.unlink()
+                removed += 1
+        except OSError:
+            pass
+    return removed
+
+
+INBOX_GC_INTERVAL = float(os.environ.get("INBOX_GC_INTERVAL", "60"))  # Seconds between inbox sweeps (0 = off)
+INBOX_TTL = float(os.environ.get("INBOX_TTL", str(24 * 3600)))  # Evict inbox files unused this long (0 = never)
+INBOX_WORKER_QUOTA_MB = float(os.environ.get("INBOX_WORKER_QUOTA_MB", "256"))  # Per-worker inbox cap (0 = none)
+INBOX_NODE_QUOTA_MB = float(os.environ.get("INBOX_NODE_QUOTA_MB", "1024"))  # All inboxes + cache (0 = none)
+
+
+class InboxCollector:
+    """Background sweeper keeping inboxes under TTL and byte quotas.
+
+    Every INBOX_GC_INTERVAL seconds it evicts inbox files unused for
+    INBOX_TTL, then least recently used files until each worker is under
+    INBOX_WORKER_QUOTA_MB and the node (hardlinked copies counted once) is
+    under INBOX_NODE_QUOTA_MB, then prunes cache entries no inbox links.
+    A file delivered to a worker is never evicted while that worker has a
+    message pending, nor within one interval of its download (the message
+    naming it is routed just after). /end still clears the whole inbox.
+    """
+
+    def __init__(self, interval: float = INBOX_GC_INTERVAL, ttl: float = INBOX_TTL,
+                 worker_quota_mb: float = INBOX_WORKER_QUOTA_MB, node_quota_mb: float = INBOX_NODE_QUOTA_MB):
+        self.interval = interval
+        self.ttl = ttl
+        self.worker_quota = int(worker_quota_mb * 1024 * 1024)
+        self.node_quota = int(node_quota_mb * 1024 * 1024)
+        self._protected: Dict[str, Dict[str, float]] = {}  # worker -> {path: delivered at}
+        self._sizes: Dict[str, tuple] = {}  # worker -> (files, bytes) at the last sweep
+        self._lock = threading.Lock()
+        self.stats = {"sweeps": 0, "evicted_ttl": 0, "evicted_worker_quota": 0, "evicted_node_quota": 0,
+                      "evicted_bytes": 0, "kept_referenced": 0}
+
+    def protect(self, name: str, path):
+        """Mark a file just delivered to a worker as referenced by its message."""
+        with self._lock:
+            self._protected.setdefault(name, {})[str(path)] = time.time()
+
+    def _referenced(self, now: float) -> set:
+        """Paths still referenced; releases those of workers with nothing pending."""
+        keep = set()
+        with self._lock:
+            protected = {name: dict(paths) for name, paths in self._protected.items()}
+        for name, paths in protected.items():
+            pending = is_pending(name)
+            live = {path: at for path, at in paths.items() if pending or now - at < max(self.interval, 1)}
+            keep.update(live)
+            with self._lock:
+                current = self._protected.get(name, {})
+                for path in paths:
+                    if path not in live and current.get(path) == paths[path]:
+                        current.pop(path, None)
+                if not current:
+                    self._protected.pop(name, None)
+        return keep
+
+    @staticmethod
+    def _scan() -> list:
+        """Inbox files as [last used, size, inode, worker, path]."""
+        files = []
+        if not FILE_INBOX_ROOT.exists():
+            return files
+        for worker_dir in FILE_INBOX_ROOT.iterdir():
+            inbox = worker_dir / "inbox"
+            if worker_dir.name.startswith("_") or not inbox.is_dir():
+                continue
+            for entry in inbox.iterdir():
+                if entry.name.startswith("."):
+                    continue  # Download in progress
+                try:
+                    st = entry.stat()
+                except OSError:
+                    continue
+                # A delivery links (ctime) or writes (mtime) the file; reads may touch atime
+                used = max(st.st_atime, st.st_mtime, st.st_ctime)
+                files.append([used, st.st_size, (st.st_dev, st.st_ino), worker_dir.name, entry])
+        return files
+
+    def _evict(self, entry: list, reason: str) -> bool:
+        try:
+            entry[4].unlink()
+        except FileNotFoundError:
+            return True
+        except OSError as e:
+            print(f"Inbox GC: failed to delete {entry[4]}: {e}")
+            return False
+        self.stats[f"evicted_{reason}"] += 1
+        self.stats["evicted_bytes"] += entry[1]
+        return True
+
+    def sweep(self, now: Optional[float] = None) -> int:
+        """One pass: TTL, worker quotas, node quota, cache prune. Returns files evicted."""
+        now = time.time() if now is None else now
+        prune_inbox_cache()
+        keep = self._referenced(now)
+        files = sorted(self._scan(), key=lambda f: f[0])  # Least recently used first
+        alive = []
+        kept = set()
+        evicted = 0
+        for entry in files:
+            if str(entry[4]) in keep:
+                alive.append(entry)
+                kept.add(str(entry[4]))
+            elif self.ttl > 0 and now - entry[0] > self.ttl and self._evict(entry, "ttl"):
+                evicted += 1
+            else:
+                alive.append(entry)
+
+        if self.worker_quota > 0:
+            per_worker: Dict[str, list] = {}
+            for entry in alive:
+                per_worker.setdefault(entry[3], []).append(entry)
+            for name, entries in per_worker.items():
+                used = sum(entry[1] for entry in entries)
+                for entry in entries:
+                    if used <= self.worker_quota:
+                        break
+                    if str(entry[4]) not in keep and self._evict(entry, "worker_quota"):
+                        entry[4] = None
+                        used -= entry[1]
+                        evicted += 1
+            alive = [entry for entry in alive if entry[4] is not None]
+
+        if self.node_quota > 0:
+            links: Dict[tuple, int] = {}
+            inode_sizes: Dict[tuple, int] = {}
+            for entry in alive:
+                links[entry[2]] = links.get(entry[2], 0) + 1
+                inode_sizes[entry[2]] = entry[1]
+            used = sum(inode_sizes.values())
+            for entry in alive:
+                if used <= self.node_quota:
+                    break
+                if str(entry[4]) not in keep and self._evict(entry, "node_quota"):
+                    entry[4] = None
+                    evicted += 1
+                    links[entry[2]] -= 1
+                    if links[entry[2]] == 0:
+                        used -= entry[1]  # Last link: the cache copy is pruned below
+            alive = [entry for entry in alive if entry[4] is not None]
+
+        if evicted:
+            prune_inbox_cache()
+            print(f"Inbox GC: evicted {evicted} file(s)")
+        sizes: Dict[str, tuple] = {}
+        for entry in alive:
+            count, size = sizes.get(entry[3], (0, 0))
+            sizes[entry[3]] = (count + 1, size + entry[1])
+        with self._lock:
+            self._sizes = sizes
+        self.stats["sweeps"] += 1
+        self.stats["kept_referenced"] += len(kept)
+        return evicted
+
+    def size_of(self, name: str) -> tuple:
+        """(files, bytes) in a worker's inbox as of the last sweep."""
+        with self._lock:
+            return self._sizes.get(name, (0, 0))
+
+    def sizes(self) -> Dict[str, int]:
+        with self._lock:
+            return {name: size for name, (_, size) in self._sizes.items()}
+
+    def _loop(self):
+        while True:
+            time.sleep(self.interval)
+            try:
+                self.sweep()
+            except Exception as e:
+                print(f"Inbox GC: sweep failed: {e}")
+
+    def start(self) -> bool:
+        if self.interval <= 0:
+            return False
+        threading.Thread(target=self._loop, daemon=True, name="inbox-gc").start()
+        return True
+
+
+inbox_gc = InboxCollector()
+metrics.register("inbox_bytes", "gauge", "Inbox bytes per worker at the last GC sweep", lambda: inbox_gc.sizes(), "worker")
+metrics.register("inbox_gc_total", "counter", "Inbox GC sweeps and evictions by reason", lambda: inbox_gc.stats, "event")
 
 
 # ============================================================
@@ -546,7 +1796,7 @@ def ensure_worker_pipe(name):
     """Create the named pipe for a worker if it doesn't exist.
 
     Creates: /tmp/claudecode-telegram/<node>/<worker>/in.pipe
-    Also starts a reader thread to forward messages to the worker.
+    Also registers it with the pipe multiplexer to forward messages to the worker.
     """
     pipe_path = get_worker_pipe_path(name)
     pipe_dir = pipe_path.parent
@@ -560,7 +1810,7 @@ def ensure_worker_pipe(name):
         os.mkfifo(str(pipe_path), mode=0o600)
         print(f"Created worker pipe: {pipe_path}")
 
-    # Start the pipe reader thread to forward messages to worker
+    # Register the pipe with the multiplexer to forward messages to worker
     start_pipe_reader(name)
 
     return pipe_path
@@ -568,7 +1818,7 @@ def ensure_worker_pipe(name):
 
 def cleanup_worker_pipe(name):
     """Remove the named pipe for a worker."""
-    # Stop the pipe reader thread first
+    # Stop reading the pipe first
     stop_pipe_reader(name)
 
     pipe_path = get_worker_pipe_path(name)
@@ -590,69 +1840,257 @@ def cleanup_worker_pipe(name):
 
 
 # ─────────────────────────────────────────────────────────────────────────────
-# Pipe Reader Threads (for inter-worker communication)
+# Pipe Multiplexer (one selector thread for every worker's in.pipe)
 # ─────────────────────────────────────────────────────────────────────────────
 
-# Dict to track pipe reader threads: name -> (thread, stop_event)
-_pipe_reader_threads: Dict[str, tuple] = {}
+PIPE_FRAME_START = "<<<"  # A line with just <<< starts a multi-line message...
+PIPE_FRAME_END = ">>>"  # ...and a line with just >>> ends it
+PIPE_READ_SIZE = 65536
+PIPE_FRAME_MAX = int(os.environ.get("PIPE_FRAME_MAX", "1048576"))  # Bytes in one <<< frame before it is dropped
+PIPE_FRAME_TIMEOUT = float(os.environ.get("PIPE_FRAME_TIMEOUT", "30"))  # Seconds a <<< frame may stay open
+PIPE_SEND_WORKERS = int(os.environ.get("PIPE_SEND_WORKERS", "4"))  # Threads delivering pipe messages
+PIPE_SEND_QUEUE_SIZE = int(os.environ.get("PIPE_SEND_QUEUE_SIZE", "1000"))  # Queued pipe messages, all workers
 
 
-def pipe_reader_loop(name: str, stop_event: threading.Event):
-    """Background thread that reads messages from a worker's input pipe.
+class _PipeState:
+    def __init__(self, name: str, read_fd: int, write_fd: int):
+        self.name = name
+        self.read_fd = read_fd
+        self.write_fd = write_fd  # Held dummy writer: no EOF when writers come and go
+        self.buffer = b""
+        self.frame: Optional[list] = None  # Lines of an open <<< ... >>> frame
+        self.frame_size = 0
+        self.frame_started = 0.0
+        self.frame_overflow = False  # Over PIPE_FRAME_MAX: discard lines until >>>
 
-    When another worker writes to this worker's pipe:
-      echo "message" > /tmp/claudecode-telegram/<node>/bob/in.pipe
 
-    This thread reads the message and forwards it to the worker's backend.
+class PipeMultiplexer:
+    """Reads all worker FIFOs from one selector (epoll/kqueue) thread.
+
+    Workers write to each other with:
+      echo "message" > /tmp/claudecode-telegram/<node>/bob/in.pipe
 
-    The reader uses blocking open() - this means the thread will block until
-    a writer opens the pipe. This is correct behavior for FIFOs. When the
-    writer closes, we get EOF, close our end, and re-open to wait for the
-    next writer.
+    Each non-empty line is one message. Multi-line messages are framed:
+      printf '<<<\nline 1\nline 2\n>>>\n' > .../bob/in.pipe
+    Writes up to PIPE_BUF (4 KB) are atomic; larger frames from concurrent
+    writers may interleave. A frame over PIPE_FRAME_MAX bytes, or not closed
+    within PIPE_FRAME_TIMEOUT seconds, is dropped with an error so it cannot
+    swallow the pipe's later messages.
+
+    FIFOs are opened O_NONBLOCK together with a dummy writer we keep open,
+    so a writer closing never produces EOF (no busy loop, no re-open).
+    add()/remove() only queue a change and wake the selector through a
+    self-pipe: O(1), no per-worker thread to unblock or join.
+
+    The selector thread only reads. Each message is delivered on a
+    ChatOrderedQueue keyed by worker name, so a slow tmux send or a worker
+    still starting up delays its own messages only, in arrival order.
     """
-    pipe_path = get_worker_pipe_path(name)
-    print(f"Pipe reader started for worker '{name}' at {pipe_path}")
 
-    while not stop_event.is_set():
+    def __init__(self):
+        self.sends = ChatOrderedQueue(PIPE_SEND_WORKERS, PIPE_SEND_QUEUE_SIZE)
+        self.sends.name = "pipe"
+        self._selector = None
+        self._pipes: Dict[str, _PipeState] = {}
+        self._ops: list = []  # ("add"|"remove", name)
+        self._lock = threading.Lock()
+        self._wake_r = self._wake_w = None
+        self._thread: Optional[threading.Thread] = None
+        self._stop = False
+
+    def is_running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def readers(self) -> list:
+        """Names of workers whose pipe is being read."""
+        with self._lock:
+            return sorted(self._pipes)
+
+    def _wake(self):
+        if self._wake_w is not None:
+            try:
+                os.write(self._wake_w, b"x")
+            except OSError:
+                pass  # Wake pipe full: the loop is about to run anyway
+
+    def ensure_running(self):
+        """Start the selector thread (or restart it if it died)."""
+        with self._lock:
+            if self.is_running():
+                return
+            if self._thread is not None:
+                print("Pipe multiplexer thread is dead, restarting")
+            self._close_selector()
+            self._selector = selectors.DefaultSelector()
+            self._wake_r, self._wake_w = os.pipe()
+            os.set_blocking(self._wake_r, False)
+            os.set_blocking(self._wake_w, False)
+            self._selector.register(self._wake_r, selectors.EVENT_READ, None)
+            # Pipes the dead loop was reading stay open (unread data survives)
+            for state in self._pipes.values():
+                self._selector.register(state.read_fd, selectors.EVENT_READ, state)
+            self._stop = False
+            self._thread = threading.Thread(target=self._loop, daemon=True, name="pipe-mux")
+            self._thread.start()
+
+    def add(self, name: str):
+        with self._lock:
+            self._ops.append(("add", name))
+        self.ensure_running()
+        self._wake()
+
+    def remove(self, name: str):
+        with self._lock:
+            self._ops.append(("remove", name))
+        self._wake()
+
+    def stop(self):
+        """Stop the loop and close every pipe (tests, shutdown)."""
+        thread = self._thread
+        self._stop = True
+        self._wake()
+        if thread is not None:
+            thread.join(timeout=1.0)
+
+    def _close_selector(self):
+        for fd in (self._wake_r, self._wake_w):
+            if fd is not None:
+                try:
+                    os.close(fd)
+                except OSError:
+                    pass
+        self._wake_r = self._wake_w = None
+        if self._selector is not None:
+            self._selector.close()
+            self._selector = None
+
+    def _open(self, name: str):
+        pipe_path = get_worker_pipe_path(name)
         try:
-            # Check if we should stop before blocking on open
-            if stop_event.is_set():
-                break
-
-            # Open pipe for reading (blocks until a writer connects)
-            # Use regular open() which blocks - this is the correct way to read FIFOs
-            with open(str(pipe_path), 'r') as pipe:
-                # Read until EOF (writer closes their end)
-                while not stop_event.is_set():
-                    line = pipe.readline()
-                    if not line:
-                        # EOF - writer closed, break to re-open
-                        break
-
-                    message = line.strip()
-                    if message:
-                        print(f"Pipe message for '{name}': {message[:100]}{'...' if len(message) > 100 else ''}")
-                        # Forward to worker using backend routing
-                        try:
-                            _forward_pipe_message(name, message)
-                        except Exception as e:
-                            print(f"Error forwarding pipe message to '{name}': {e}")
-
+            read_fd = os.open(str(pipe_path), os.O_RDONLY | os.O_NONBLOCK)
         except FileNotFoundError:
-            # Pipe was removed, stop the reader
-            print(f"Pipe for '{name}' no longer exists, stopping reader")
-            break
+            print(f"Cannot start pipe reader: pipe does not exist for '{name}'")
+            return
         except OSError as e:
-            if stop_event.is_set():
-                break
             print(f"Pipe reader error for '{name}': {e}")
-            # Wait a bit before retrying
-            stop_event.wait(0.5)
+            return
+        # A reader exists now, so a non-blocking write open succeeds
+        write_fd = os.open(str(pipe_path), os.O_WRONLY | os.O_NONBLOCK)
+        state = _PipeState(name, read_fd, write_fd)
+        self._pipes[name] = state
+        self._selector.register(read_fd, selectors.EVENT_READ, state)
+        print(f"Pipe reader started for worker '{name}' at {pipe_path}")
+
+    def _close(self, state: _PipeState):
+        try:
+            self._selector.unregister(state.read_fd)
+        except (KeyError, ValueError):
+            pass
+        for fd in (state.read_fd, state.write_fd):
+            try:
+                os.close(fd)
+            except OSError:
+                pass
+        print(f"Pipe reader stopped for worker '{state.name}'")
+
+    def _apply_ops(self):
+        with self._lock:
+            ops, self._ops = self._ops, []
+            for op, name in ops:
+                if op == "add":
+                    if name not in self._pipes:
+                        self._open(name)
+                elif name in self._pipes:
+                    self._close(self._pipes.pop(name))
+
+    def _read(self, state: _PipeState):
+        try:
+            data = os.read(state.read_fd, PIPE_READ_SIZE)
+        except BlockingIOError:
+            return
+        except OSError as e:
+            print(f"Pipe reader error for '{state.name}': {e}")
+            return
+        state.buffer += data
+        *lines, state.buffer = state.buffer.split(b"\n")
+        for raw in lines:
+            self._line(state, raw.decode("utf-8", errors="replace").rstrip("\r"))
+
+    def _drop_frame(self, state: _PipeState, reason: str):
+        print(f"Pipe frame for '{state.name}' dropped: {reason}")
+        state.frame = None
+        state.frame_overflow = False
+
+    def _expire_frames(self) -> Optional[float]:
+        """Drop frames open too long. Seconds until the next one expires."""
+        now, wait = time.monotonic(), None
+        for state in list(self._pipes.values()):
+            if state.frame is None:
+                continue
+            left = state.frame_started + PIPE_FRAME_TIMEOUT - now
+            if left <= 0:
+                self._drop_frame(state, f"no {PIPE_FRAME_END} within {PIPE_FRAME_TIMEOUT:g}s")
+            elif wait is None or left < wait:
+                wait = left
+        return wait
+
+    def _line(self, state: _PipeState, line: str):
+        if state.frame is not None and time.monotonic() - state.frame_started > PIPE_FRAME_TIMEOUT:
+            self._drop_frame(state, f"no {PIPE_FRAME_END} within {PIPE_FRAME_TIMEOUT:g}s")
+        if state.frame is None:
+            if line.strip() == PIPE_FRAME_START:
+                state.frame = []
+                state.frame_size = 0
+                state.frame_started = time.monotonic()
+                return
+            message = line.strip()
+        else:
+            if line.strip() != PIPE_FRAME_END:
+                if state.frame_overflow:
+                    return
+                state.frame_size += len(line) + 1
+                if state.frame_size > PIPE_FRAME_MAX:
+                    print(f"Pipe frame for '{state.name}' dropped: over {PIPE_FRAME_MAX} bytes")
+                    state.frame = []
+                    state.frame_overflow = True
+                    return
+                state.frame.append(line)
+                return
+            if state.frame_overflow:
+                state.frame = None
+                state.frame_overflow = False
+                return
+            message = "\n".join(state.frame).strip()
+            state.frame = None
+        if not message:
+            return
+        name = state.name
+        print(f"Pipe message for '{name}': {message[:100]}{'...' if len(message) > 100 else ''}")
+        self.sends.submit(name, lambda: _forward_pipe_message(name, message), label="pipe message")
+
+    def _loop(self):
+        selector, wake_r = self._selector, self._wake_r
+        while not self._stop:
+            self._apply_ops()
+            for key, _ in selector.select(self._expire_frames()):
+                if key.data is None:
+                    try:
+                        while os.read(wake_r, 4096):
+                            pass
+                    except BlockingIOError:
+                        pass
+                    continue
+                if key.data.name in self._pipes:
+                    self._read(key.data)
+        with self._lock:
+            for state in self._pipes.values():
+                self._close(state)
+            self._pipes = {}
+            self._close_selector()
+            self._thread = None
+
 
-    # Clean up registry so start_pipe_reader can restart if needed
-    if name in _pipe_reader_threads:
-        _pipe_reader_threads.pop(name, None)
-    print(f"Pipe reader stopped for worker '{name}'")
+pipe_mux = PipeMultiplexer()
 
 
 def _forward_pipe_message(name: str, message: str):
@@ -665,56 +2103,16 @@ def _forward_pipe_message(name: str, message: str):
 
 
 def start_pipe_reader(name: str):
-    """Start a background thread to read from the worker's input pipe."""
-    if name in _pipe_reader_threads:
-        thread, _stop = _pipe_reader_threads[name]
-        if thread.is_alive():
-            # Already running
-            return
-        # Thread crashed or exited — clean up stale entry and restart
-        print(f"Pipe reader thread for '{name}' is dead, restarting")
-        _pipe_reader_threads.pop(name, None)
-
-    pipe_path = get_worker_pipe_path(name)
-    if not pipe_path.exists():
+    """Start reading the worker's input pipe (restarts the multiplexer if it died)."""
+    if not get_worker_pipe_path(name).exists():
         print(f"Cannot start pipe reader: pipe does not exist for '{name}'")
         return
-
-    stop_event = threading.Event()
-    thread = threading.Thread(
-        target=pipe_reader_loop,
-        args=(name, stop_event),
-        daemon=True,
-        name=f"pipe-reader-{name}"
-    )
-    _pipe_reader_threads[name] = (thread, stop_event)
-    thread.start()
-    print(f"Started pipe reader thread for '{name}'")
+    pipe_mux.add(name)
 
 
 def stop_pipe_reader(name: str):
-    """Stop the pipe reader thread for a worker."""
-    if name not in _pipe_reader_threads:
-        return
-
-    thread, stop_event = _pipe_reader_threads.pop(name)
-    stop_event.set()
-
-    # Write a dummy byte to unblock the reader if it's waiting
-    pipe_path = get_worker_pipe_path(name)
-    if pipe_path.exists():
-        try:
-            # Open in non-blocking write mode to unblock reader
-            fd = os.open(str(pipe_path), os.O_WRONLY | os.O_NONBLOCK)
-            os.write(fd, b"\n")
-            os.close(fd)
-        except OSError:
-            pass  # Pipe may already be closed
-
-    # Wait for thread to finish (with timeout)
-    thread.join(timeout=1.0)
-    if thread.is_alive():
-        print(f"Warning: pipe reader thread for '{name}' did not stop gracefully")
+    """Stop reading the worker's input pipe. Returns immediately."""
+    pipe_mux.remove(name)
 
 
 def get_workers():
@@ -723,28 +2121,48 @@ def get_workers():
     return worker_manager.get_workers()
 
 
-def download_telegram_file(file_id, session_name):
+class DownloadTooLarge(Exception):
+    pass
+
+
+def download_telegram_file(file_id, session_name, file_unique_id=None):
     """Download a file from Telegram to the session's inbox.
 
     Returns the local file path or None on failure.
     SECURITY: Files are sandboxed in session's inbox directory.
+
+    The body is streamed to disk in chunks with a running MAX_FILE_SIZE check.
+    With a file_unique_id, the download lands in the per-node cache once and
+    every inbox gets a hardlink (read-only, shared inode); a repeat delivery
+    skips getFile and the download entirely.
     """
     if not BOT_TOKEN:
         return None
 
+    inbox = ensure_inbox_dir(session_name)
+    cached = find_cached_file(file_unique_id)
+    if cached:
+        try:
+            local_path = link_into_inbox(cached, inbox)
+            inbox_gc.protect(session_name, local_path)
+            print(f"Downloaded file (cached): {local_path}")
+            return str(local_path)
+        except OSError as e:
+            print(f"Cache link error: {e}")
+
     # Get file info from Telegram
     try:
-        req = urllib.request.Request(
-            f"https://api.telegram.org/bot{BOT_TOKEN}/getFile",
-            data=json.dumps({"file_id": file_id}).encode(),
-            headers={"Content-Type": "application/json"}
+        status, body = telegram_pool.request(
+            "POST", f"/bot{BOT_TOKEN}/getFile",
+            body=json.dumps({"file_id": file_id}).encode(),
+            headers={"Content-Type": "application/json"},
+            timeout=30
         )
-        with urllib.request.urlopen(req, timeout=30) as r:
-            result = json.loads(r.read())
-            if not result.get("ok"):
-                print(f"getFile failed: {result}")
-                return None
-            file_info = result.get("result", {})
+        result = json.loads(body)
+        if status != 200 or not result.get("ok"):
+            print(f"getFile failed: {result}")
+            return None
+        file_info = result.get("result", {})
     except Exception as e:
         print(f"getFile error: {e}")
         return None
@@ -762,28 +2180,56 @@ def download_telegram_file(file_id, session_name):
         return None
 
     # Download the file
-    download_url = f"https://api.telegram.org/file/bot{BOT_TOKEN}/{file_path}"
-    inbox = ensure_inbox_dir(session_name)
+    download_path = f"/file/bot{BOT_TOKEN}/{urllib.parse.quote(file_path)}"
 
     # Generate unique filename with original extension
     ext = Path(file_path).suffix or ""
-    local_filename = f"{uuid.uuid4().hex}{ext}"
-    local_path = inbox / local_filename
+    key = _cache_key(file_unique_id or file_info.get("file_unique_id"))
+    if key:
+        INBOX_CACHE_DIR.mkdir(parents=True, exist_ok=True, mode=0o700)
+        final_path = INBOX_CACHE_DIR / f"{key}{ext}"
+        part_path = INBOX_CACHE_DIR / f".{uuid.uuid4().hex}.part"
+    else:
+        final_path = inbox / f"{uuid.uuid4().hex}{ext}"
+        part_path = inbox / f".{final_path.name}.part"
 
     try:
-        req = urllib.request.Request(download_url)
-        with urllib.request.urlopen(req, timeout=60) as r:
-            content = r.read()
-            if len(content) > MAX_FILE_SIZE:
-                print(f"Downloaded file too large: {len(content)}")
-                return None
-            local_path.write_bytes(content)
-            local_path.chmod(0o600)
+        fd = os.open(part_path, os.O_WRONLY | os.O_CREAT | os.O_EXCL, 0o600)
+        with os.fdopen(fd, "wb") as f:
+            written = 0
+
+            def sink(chunk):
+                nonlocal written
+                written += len(chunk)
+                if written > MAX_FILE_SIZE:
+                    raise DownloadTooLarge(f"Downloaded file too large: over {MAX_FILE_SIZE}")
+                f.write(chunk)
+
+            status, _ = telegram_pool.request("GET", download_path, timeout=60, sink=sink)
+        if status != 200:
+            print(f"Download error: HTTP {status}")
+            part_path.unlink()
+            return None
+        if key:
+            part_path.chmod(0o400)  # Shared inode: no worker can edit another's copy
+            # Link before publishing, so prune never sees the new entry unreferenced
+            local_path = link_into_inbox(part_path, inbox, ext)
+            os.replace(part_path, final_path)
+        else:
+            os.replace(part_path, final_path)
+            local_path = final_path
+        inbox_gc.protect(session_name, local_path)
         print(f"Downloaded file: {local_path}")
         return str(local_path)
+    except DownloadTooLarge as e:
+        print(e)
     except Exception as e:
         print(f"Download error: {e}")
-        return None
+    try:
+        part_path.unlink()
+    except OSError:
+        pass
+    return None
 
 
 def validate_photo_path(photo_path):
@@ -823,6 +2269,90 @@ def validate_photo_path(photo_path):
     return True, photo_path
 
 
+MULTIPART_CHUNK_SIZE = 64 * 1024  # Bytes read from disk per socket write
+
+
+class MultipartBody:
+    """multipart/form-data body streamed from disk.
+
+    Text fields are small and built up front; the file part is read in
+    MULTIPART_CHUNK_SIZE chunks as http.client writes them to the socket, so
+    an upload never holds the file in memory. The length is known up front
+    (plain Content-Length, no chunked encoding), and each iteration reopens
+    the file, so the pool's stale-connection retry can resend the body.
+    """
+
+    def __init__(self, fields: dict, files: list):
+        """files: [(field_name, path, content_type)]; sendMediaGroup passes several."""
+        self.boundary = uuid.uuid4().hex
+        head = []
+        for name, value in fields.items():
+            head.append(
+                f'--{self.boundary}\r\nContent-Disposition: form-data; name="{name}"\r\n\r\n'.encode()
+                + str(value).encode() + b"\r\n"
+            )
+        self._head = b"".join(head)
+        self._files = []  # (part header, path, size)
+        for field, path, content_type in files:
+            header = (
+                f'--{self.boundary}\r\nContent-Disposition: form-data; name="{field}"; '
+                f'filename="{path.name}"\r\nContent-Type: {content_type}\r\n\r\n'.encode()
+            )
+            self._files.append((header, path, path.stat().st_size))
+        self._tail = f"--{self.boundary}--\r\n".encode()
+
+    def __len__(self):
+        files = sum(len(header) + size + 2 for header, _, size in self._files)
+        return len(self._head) + files + len(self._tail)
+
+    def headers(self) -> dict:
+        return {
+            "Content-Type": f"multipart/form-data; boundary={self.boundary}",
+            "Content-Length": str(len(self)),
+        }
+
+    def __iter__(self):
+        yield self._head
+        for header, path, size in self._files:
+            yield header
+            remaining = size
+            with open(path, "rb") as f:
+                while remaining > 0:
+                    chunk = f.read(min(MULTIPART_CHUNK_SIZE, remaining))
+                    if not chunk:
+                        raise IOError(f"{path.name} shrank during upload")
+                    remaining -= len(chunk)
+                    yield chunk
+            yield b"\r\n"
+        yield self._tail
+
+
+def upload_files(method: str, fields: dict, files: list):
+    """POST files to a Telegram upload method (sendPhoto, sendDocument, sendMediaGroup).
+
+    Returns (status, parsed JSON). Raises TelegramRetryAfter on 429 so the
+    outbound dispatcher can wait and retry.
+    """
+    body = MultipartBody(fields, files)
+    status, data = telegram_pool.request(
+        "POST", f"/bot{BOT_TOKEN}/{method}",
+        body=body,
+        headers=body.headers(),
+        timeout=60
+    )
+    if status == 429:
+        raise TelegramRetryAfter(method, _telegram_retry_after(data))
+    return status, json.loads(data)
+
+
+def upload_file(method: str, file_field: str, chat_id, file_path: Path, content_type: str, caption=None):
+    """POST one file (sendPhoto, sendDocument). Returns (status, parsed JSON)."""
+    fields = {"chat_id": chat_id}
+    if caption:
+        fields["caption"] = caption
+    return upload_files(method, fields, [(file_field, file_path, content_type)])
+
+
 def send_photo(chat_id, photo_path, caption=None):
     """Send a photo to Telegram using multipart/form-data.
 
@@ -838,52 +2368,18 @@ def send_photo(chat_id, photo_path, caption=None):
         return False
 
     photo_path = validated
-
-    # Build multipart form data
-    boundary = uuid.uuid4().hex
     content_type = mimetypes.guess_type(str(photo_path))[0] or "image/jpeg"
 
-    body_parts = []
-
-    # chat_id field
-    body_parts.append(f"--{boundary}".encode())
-    body_parts.append(b'Content-Disposition: form-data; name="chat_id"')
-    body_parts.append(b"")
-    body_parts.append(str(chat_id).encode())
-
-    # photo field
-    body_parts.append(f"--{boundary}".encode())
-    body_parts.append(f'Content-Disposition: form-data; name="photo"; filename="{photo_path.name}"'.encode())
-    body_parts.append(f"Content-Type: {content_type}".encode())
-    body_parts.append(b"")
-    body_parts.append(photo_path.read_bytes())
-
-    # caption field (optional)
-    if caption:
-        body_parts.append(f"--{boundary}".encode())
-        body_parts.append(b'Content-Disposition: form-data; name="caption"')
-        body_parts.append(b"")
-        body_parts.append(caption.encode())
-
-    body_parts.append(f"--{boundary}--".encode())
-    body_parts.append(b"")
-
-    body = b"\r\n".join(body_parts)
-
     try:
-        req = urllib.request.Request(
-            f"https://api.telegram.org/bot{BOT_TOKEN}/sendPhoto",
-            data=body,
-            headers={"Content-Type": f"multipart/form-data; boundary={boundary}"}
-        )
-        with urllib.request.urlopen(req, timeout=60) as r:
-            result = json.loads(r.read())
-            if result.get("ok"):
-                print(f"Photo sent: {photo_path.name}")
-                return True
-            else:
-                print(f"sendPhoto failed: {result}")
-                return False
+        status, result = upload_file("sendPhoto", "photo", chat_id, photo_path, content_type, caption)
+        if status == 200 and result.get("ok"):
+            print(f"Photo sent: {photo_path.name}")
+            return True
+        else:
+            print(f"sendPhoto failed: {result}")
+            return False
+    except TelegramRetryAfter:
+        raise
     except Exception as e:
         print(f"sendPhoto error: {e}")
         return False
@@ -951,140 +2447,164 @@ def send_document(chat_id, doc_path, caption=None):
         return False
 
     doc_path = validated
-
-    # Build multipart form data
-    boundary = uuid.uuid4().hex
     content_type = mimetypes.guess_type(str(doc_path))[0] or "application/octet-stream"
 
-    body_parts = []
-
-    # chat_id field
-    body_parts.append(f"--{boundary}".encode())
-    body_parts.append(b'Content-Disposition: form-data; name="chat_id"')
-    body_parts.append(b"")
-    body_parts.append(str(chat_id).encode())
+    try:
+        status, result = upload_file("sendDocument", "document", chat_id, doc_path, content_type, caption)
+        if status == 200 and result.get("ok"):
+            print(f"Document sent: {doc_path.name}")
+            return True
+        else:
+            print(f"sendDocument failed: {result}")
+            return False
+    except TelegramRetryAfter:
+        raise
+    except Exception as e:
+        print(f"sendDocument error: {e}")
+        return False
 
-    # document field
-    body_parts.append(f"--{boundary}".encode())
-    body_parts.append(f'Content-Disposition: form-data; name="document"; filename="{doc_path.name}"'.encode())
-    body_parts.append(f"Content-Type: {content_type}".encode())
-    body_parts.append(b"")
-    body_parts.append(doc_path.read_bytes())
 
-    # caption field (optional)
-    if caption:
-        body_parts.append(f"--{boundary}".encode())
-        body_parts.append(b'Content-Disposition: form-data; name="caption"')
-        body_parts.append(b"")
-        body_parts.append(caption.encode())
+MEDIA_GROUP_MAX = 10  # Telegram album size limit
+MEDIA_CAPTION_MAX = 1024  # Longer captions can't ride in an album item
 
-    body_parts.append(f"--{boundary}--".encode())
-    body_parts.append(b"")
 
-    body = b"\r\n".join(body_parts)
+def send_media_group(chat_id, kind: str, items: list):
+    """Send 2-10 validated files of one kind ("photo" or "document") as an album.
 
+    items: [(Path, caption)]. Each item keeps its own caption.
+    Returns True on success, False if Telegram rejected the album, and None
+    if no answer came back (the album may have been posted).
+    """
+    media, files = [], []
+    default_type = "image/jpeg" if kind == "photo" else "application/octet-stream"
+    for i, (path, caption) in enumerate(items):
+        entry = {"type": kind, "media": f"attach://file{i}"}
+        if caption:
+            entry["caption"] = caption
+        media.append(entry)
+        files.append((f"file{i}", path, mimetypes.guess_type(str(path))[0] or default_type))
     try:
-        req = urllib.request.Request(
-            f"https://api.telegram.org/bot{BOT_TOKEN}/sendDocument",
-            data=body,
-            headers={"Content-Type": f"multipart/form-data; boundary={boundary}"}
-        )
-        with urllib.request.urlopen(req, timeout=60) as r:
-            result = json.loads(r.read())
-            if result.get("ok"):
-                print(f"Document sent: {doc_path.name}")
-                return True
-            else:
-                print(f"sendDocument failed: {result}")
-                return False
-    except Exception as e:
-        print(f"sendDocument error: {e}")
+        status, result = upload_files("sendMediaGroup", {"chat_id": chat_id, "media": json.dumps(media)}, files)
+        if status == 200 and result.get("ok"):
+            print(f"Album sent: {len(items)} {kind}s")
+            return True
+        print(f"sendMediaGroup failed: {result}")
         return False
+    except TelegramRetryAfter:
+        raise
+    except Exception as e:
+        print(f"sendMediaGroup error: {e}")
+        return None
+
+
+def plan_media_batches(kind: str, items: list) -> list:
+    """Split validated (Path, caption, ...) items into album-sized batches.
+
+    Items whose caption is too long for an album item go alone. Batches are
+    filled evenly (12 -> 6+6, not 10+2) so parallel uploads finish together.
+    """
+    loners = [[item] for item in items if len(item[1] or "") > MEDIA_CAPTION_MAX]
+    groupable = [item for item in items if len(item[1] or "") <= MEDIA_CAPTION_MAX]
+    if not groupable:
+        return loners
+    count = -(-len(groupable) // MEDIA_GROUP_MAX)
+    size = -(-len(groupable) // count)
+    return [groupable[i:i + size] for i in range(0, len(groupable), size)] + loners
 
 
 # ============================================================
 # MESSAGE FORMATTING
 # ============================================================
 
-CODE_FENCE_RE = re.compile(r"```.*?```", re.DOTALL)
-INLINE_CODE_RE = re.compile(r"`[^`\n]*`")
+HOOKS_DIR = Path(__file__).resolve().parent / "hooks"
+
+
+def load_hook_module(name: str, filename: str):
+    """Import a hook script that has a dash in its file name (None if missing)."""
+    import importlib.util
+    path = HOOKS_DIR / filename
+    if not path.exists():
+        return None
+    spec = importlib.util.spec_from_file_location(name, path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
 
 
-def _split_protected_segments(text, pattern):
-    """Split text into (segment, is_protected) based on regex matches."""
-    segments = []
-    last = 0
-    for match in pattern.finditer(text):
-        if match.start() > last:
-            segments.append((text[last:match.start()], False))
-        segments.append((match.group(0), True))
-        last = match.end()
-    if last < len(text):
-        segments.append((text[last:], False))
-    return segments
+# Markdown rendering, escaping and markup-safe splitting, shared with the Stop hook
+telegram_html = load_hook_module("telegram_html", "telegram-html.py")
+
+# Code spans first: a tag or newline run inside code is left alone
+_CODE_SPANS = r"```.*?```|`[^`\n]*`"
+EXCESS_NEWLINES_RE = re.compile(rf"{_CODE_SPANS}|\n{{3,}}", re.DOTALL)
+_MEDIA_TAG_RES: Dict[tuple, "re.Pattern"] = {}
 
 
 def _collapse_excess_newlines(text):
     """Collapse 3+ newlines to 2, but avoid touching code blocks and inline code."""
-    output = []
-    for segment, protected in _split_protected_segments(text, CODE_FENCE_RE):
-        if protected:
-            output.append(segment)
-            continue
-        for inline_segment, inline_protected in _split_protected_segments(segment, INLINE_CODE_RE):
-            if inline_protected:
-                output.append(inline_segment)
-            else:
-                output.append(re.sub(r"\n{3,}", "\n\n", inline_segment))
-    return "".join(output)
+    return EXCESS_NEWLINES_RE.sub(lambda m: m.group(0) if m.group(0)[0] == "`" else "\n\n", text)
+
+
+def _media_tag_re(tag_names: tuple):
+    pattern = _MEDIA_TAG_RES.get(tag_names)
+    if pattern is None:
+        names = "|".join(tag_names)
+        pattern = re.compile(
+            rf"(?P<code>{_CODE_SPANS})|(?P<escaped>\\)?\[\[(?P<tag>{names}):(?P<path>[^\]|]+)(?:\|(?P<caption>[^\]]*))?\]\]",
+            re.DOTALL,
+        )
+        _MEDIA_TAG_RES[tag_names] = pattern
+    return pattern
 
 
-def _parse_media_tags(text, tag_name, validate_func):
-    """Parse media tags, skipping escaped tags and code spans.
+def _parse_media_tags(text, validators: dict):
+    """Parse media tags in one scan, skipping escaped tags and code spans.
 
-    Returns (clean_text, [(path, caption), ...]).
+    validators maps tag name -> validate_func. Returns (clean_text,
+    {tag_name: [(path, caption), ...]}).
     """
-    pattern = re.compile(rf"(\\)?\[\[{tag_name}:([^\]|]+)(?:\|([^\]]*))?\]\]")
-    items = []
+    items = {name: [] for name in validators}
     removed = 0
 
     def replace_tag(match):
         nonlocal removed
-        if match.group(1):
+        if match.group("code") is not None:
+            return match.group(0)
+        if match.group("escaped"):
             # Escaped tag, return without the escape slash.
             return match.group(0)[1:]
-        path = match.group(2).strip()
-        caption = (match.group(3) or "").strip()
-        ok, _ = validate_func(path)
+        tag = match.group("tag")
+        path = match.group("path").strip()
+        caption = (match.group("caption") or "").strip()
+        ok, _ = validators[tag](path)
         if ok:
-            items.append((path, caption))
+            items[tag].append((path, caption))
             removed += 1
             return ""
         return match.group(0)
 
-    output = []
-    for segment, protected in _split_protected_segments(text, CODE_FENCE_RE):
-        if protected:
-            output.append(segment)
-            continue
-        for inline_segment, inline_protected in _split_protected_segments(segment, INLINE_CODE_RE):
-            if inline_protected:
-                output.append(inline_segment)
-            else:
-                output.append(pattern.sub(replace_tag, inline_segment))
-
-    clean_text = "".join(output)
+    clean_text = _media_tag_re(tuple(validators)).sub(replace_tag, text)
     if removed:
         clean_text = _collapse_excess_newlines(clean_text).strip()
     return clean_text, items
 
 
+def parse_media_tags(text):
+    """Parse [[image:...]] and [[file:...]] tags in one scan.
+
+    Returns (clean_text, images, files), each a list of (path, caption).
+    """
+    clean_text, items = _parse_media_tags(text, {"image": validate_photo_path, "file": validate_document_path})
+    return clean_text, items["image"], items["file"]
+
+
 def parse_image_tags(text):
     """Parse [[image:/path|caption]] tags from text.
 
     Returns (clean_text, [(path, caption), ...])
     """
-    return _parse_media_tags(text, "image", validate_photo_path)
+    clean_text, items = _parse_media_tags(text, {"image": validate_photo_path})
+    return clean_text, items["image"]
 
 
 def parse_file_tags(text):
@@ -1092,7 +2612,8 @@ def parse_file_tags(text):
 
     Returns (clean_text, [(path, caption), ...])
     """
-    return _parse_media_tags(text, "file", validate_document_path)
+    clean_text, items = _parse_media_tags(text, {"file": validate_document_path})
+    return clean_text, items["file"]
 
 
 def escape_html(text: str) -> str:
@@ -1100,7 +2621,7 @@ def escape_html(text: str) -> str:
 
     Must escape &, <, > to prevent Telegram from interpreting them as HTML tags.
     """
-    return text.replace('&', '&amp;').replace('<', '&lt;').replace('>', '&gt;')
+    return telegram_html.esc(text)
 
 
 def format_response_text(session_name, text):
@@ -1118,52 +2639,11 @@ TELEGRAM_MAX_LENGTH = 4096
 def split_message(text, max_len=TELEGRAM_MAX_LENGTH):
     """Split text into chunks that fit within Telegram's message limit.
 
-    Splits on safe boundaries: blank lines → newlines → spaces → hard cut.
-    Returns list of text chunks.
-    """
-    if len(text) <= max_len:
-        return [text]
-
-    chunks = []
-    remaining = text
-
-    while remaining:
-        if len(remaining) <= max_len:
-            chunks.append(remaining)
-            break
-
-        # Find best split point within max_len
-        split_at = find_split_point(remaining, max_len)
-        chunks.append(remaining[:split_at].rstrip())
-        remaining = remaining[split_at:].lstrip()
-
-    return chunks
-
-
-def find_split_point(text, max_len):
-    """Find the best point to split text within max_len.
-
-    Priority: blank line → newline → space → hard cut.
+    Splits on safe boundaries: blank lines → newlines → spaces → hard cut,
+    never inside a tag or entity; tags open at a cut (e.g. a long <pre>) are
+    closed and reopened around it. Returns list of text chunks.
     """
-    search_area = text[:max_len]
-
-    # Try blank line (paragraph break)
-    pos = search_area.rfind('\n\n')
-    if pos > max_len // 2:  # Only use if reasonably far into text
-        return pos + 1  # Include one newline in current chunk
-
-    # Try newline
-    pos = search_area.rfind('\n')
-    if pos > max_len // 2:
-        return pos + 1
-
-    # Try space
-    pos = search_area.rfind(' ')
-    if pos > max_len // 2:
-        return pos + 1
-
-    # Hard cut at max_len
-    return max_len
+    return telegram_html.split_html(text, max_len)
 
 
 def format_multipart_messages(session_name, chunks):
@@ -1210,12 +2690,7 @@ def get_session_dir(name):
 
 def ensure_session_dir(name):
     """Create session directory if needed with secure permissions (0o700)."""
-    d = get_session_dir(name)
-    d.mkdir(parents=True, exist_ok=True, mode=0o700)
-    # Ensure parent directories also have secure permissions
-    SESSIONS_DIR.chmod(0o700)
-    d.chmod(0o700)
-    return d
+    return session_store.session_dir(name)
 
 
 def get_pending_file(name):
@@ -1226,40 +2701,291 @@ def get_chat_id_file(name):
     return get_session_dir(name) / "chat_id"
 
 
-def set_pending(name, chat_id):
+def write_session_file(path: Path, text: str):
+    """Write a 0o600 session file by replacing it, never truncating in place.
+
+    A reply for the previous message can arrive (read chat_id, clear
+    pending) while the next message is being marked pending. Each writer
+    gets its own temp file, so concurrent writers of one file never replace
+    it with each other's half-written text.
+    """
+    fd, tmp = tempfile.mkstemp(dir=path.parent, prefix=f".{path.name}.", suffix=".tmp")  # Created 0o600
+    try:
+        with os.fdopen(fd, "w") as f:
+            f.write(text)
+        os.replace(tmp, path)
+    except BaseException:
+        try:
+            os.unlink(tmp)
+        except OSError:
+            pass
+        raise
+
+
+class SessionStore:
+    """Write-through cache over the session and node state files.
+
+    The files stay the only state: hooks read chat_id and remove pending,
+    the CLI reads them, and a restarted bridge finds them as they were
+    left. The store only skips repeat work on the message path. Session
+    dirs are created and chmod'ed once. A file is rewritten only when its
+    text changes. Reads are answered from memory while one stat() shows the
+    file is still the one last written or read, so a hook removing or
+    replacing a file is always seen.
+    """
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._dirs = set()
+        self._files: Dict[Path, tuple] = {}  # path -> (stat key, text) last written or read
+        self.stats = {"writes": 0, "skipped": 0, "reads": 0, "hits": 0}
+
+    @staticmethod
+    def _stat_key(path: Path):
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+        return (st.st_ino, st.st_mtime_ns, st.st_size)
+
+    def session_dir(self, name) -> Path:
+        """Session dir (0o700), created on first use."""
+        d = get_session_dir(name)
+        with self._lock:
+            known = d in self._dirs
+        if known and d.is_dir():
+            return d
+        d.mkdir(parents=True, exist_ok=True, mode=0o700)
+        # Ensure parent directories also have secure permissions
+        SESSIONS_DIR.chmod(0o700)
+        d.chmod(0o700)
+        with self._lock:
+            self._dirs.add(d)
+        return d
+
+    def write(self, path: Path, text: str) -> bool:
+        """Replace path with text (0o600) unless it already holds it. True if written."""
+        with self._lock:
+            cached = self._files.get(path)
+        if cached and cached[1] == text and cached[0] == self._stat_key(path):
+            self.stats["skipped"] += 1
+            return False
+        try:
+            write_session_file(path, text)
+        except FileNotFoundError:
+            path.parent.mkdir(parents=True, exist_ok=True, mode=0o700)
+            write_session_file(path, text)
+        with self._lock:
+            self._files[path] = (self._stat_key(path), text)
+        self.stats["writes"] += 1
+        return True
+
+    def read(self, path: Path) -> Optional[str]:
+        """File text, or None if missing."""
+        key = self._stat_key(path)
+        with self._lock:
+            cached = self._files.get(path)
+            if key is None:
+                self._files.pop(path, None)
+                return None
+            if cached and cached[0] == key:
+                self.stats["hits"] += 1
+                return cached[1]
+        try:
+            text = path.read_text()
+        except OSError:
+            return None
+        with self._lock:
+            self._files[path] = (key, text)  # Key taken before the read: a later change restats differently
+        self.stats["reads"] += 1
+        return text
+
+    def remove(self, path: Path):
+        with self._lock:
+            self._files.pop(path, None)
+        path.unlink(missing_ok=True)  # A concurrent reply may have cleared it
+
+
+session_store = SessionStore()
+
+
+def set_pending(name, chat_id, trace_id=None):
     """Mark session as having a pending request with secure permissions (0o600)."""
+    remember_chat_id(name, chat_id)
     d = ensure_session_dir(name)
-    pending = d / "pending"
-    chat_id_file = d / "chat_id"
-    pending.write_text(str(int(time.time())))
-    pending.chmod(0o600)
-    chat_id_file.write_text(str(chat_id))
-    chat_id_file.chmod(0o600)
+    session_store.write(d / "pending", str(int(time.time())))
+    session_store.write(d / "chat_id", str(chat_id))
+    if trace_id:
+        session_store.write(d / "trace", trace_id)
+    else:
+        session_store.remove(d / "trace")
+    typing_ticker.add(name, chat_id)
+    draft_streamer.reset(name)
 
 
 def clear_pending(name):
     """Clear pending status for session."""
+    typing_ticker.discard(name)
     d = get_session_dir(name)
-    pending = d / "pending"
-    if pending.exists():
-        pending.unlink()
+    for path in (d / "pending", d / "trace"):
+        session_store.remove(path)
+
+
+def clear_answered_pending(name, pending: Optional[str], trace_id: Optional[str]) -> bool:
+    """Clear pending only if it is still the turn a response answered.
+
+    `pending`/`trace_id` are what the session held for that turn. A message
+    sent while the reply was queued has written its own; clearing those would
+    stop its typing indicator and lose its trace. True if cleared.
+    """
+    current_trace = read_trace_id(name)
+    if trace_id or current_trace:
+        if current_trace != trace_id:
+            return False
+    elif session_store.read(get_pending_file(name)) not in (None, pending):
+        return False
+    clear_pending(name)
+    return True
 
 
 def is_pending(name):
     """Check if session has a pending request. Auto-clears after 10 min timeout."""
     pending = get_pending_file(name)
-    if not pending.exists():
+    text = session_store.read(pending)  # One stat() while the file is unchanged
+    if text is None:
         return False
     try:
-        ts = int(pending.read_text().strip())
+        ts = int(text.strip())
         if (time.time() - ts) > 600:  # 10 min timeout - auto-clear stale pending
-            pending.unlink()
+            session_store.remove(pending)
             return False
         return True
     except:
         return False
 
 
+# Time Stop hooks spent waiting for the transcript flush (reported per reply)
+transcript_wait_stats = {"count": 0, "total_ms": 0, "max_ms": 0}
+last_transcript_wait: Dict[str, int] = {}
+
+
+def record_transcript_wait(name, wait_ms):
+    """Record how long a worker's hook waited before it could extract the reply."""
+    try:
+        wait_ms = max(0, int(wait_ms))
+    except (TypeError, ValueError):
+        return None
+    last_transcript_wait[name] = wait_ms
+    metrics.observe("hook_transcript_wait_seconds", wait_ms / 1000, worker=name, backend=get_worker_backend(name))
+    transcript_wait_stats["count"] += 1
+    transcript_wait_stats["total_ms"] += wait_ms
+    transcript_wait_stats["max_ms"] = max(transcript_wait_stats["max_ms"], wait_ms)
+    return wait_ms
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Message traces (GET /trace/<id>)
+# ─────────────────────────────────────────────────────────────────────────────
+
+TRACE_KEEP = int(os.environ.get("TRACE_KEEP", "500"))  # Recent traces kept in memory
+TRACE_LOG = os.environ.get("TRACE_LOG", "")  # Optional JSON-lines span log (path)
+
+
+def get_trace_file(name):
+    return get_session_dir(name) / "trace"
+
+
+def read_trace_id(name) -> Optional[str]:
+    """Trace id of the worker's current message (None if untraced)."""
+    return (session_store.read(get_trace_file(name)) or "").strip() or None
+
+
+class Tracer:
+    """Per-message spans from Telegram receipt to the delivered reply.
+
+    handle_message() begins a trace id for the calling thread; it is only
+    stored once a span is recorded (so commands that never reach a worker
+    cost nothing). The id is written next to `pending` and hooks and adapters
+    pass it back on /response, so spans recorded in other threads and
+    processes land on the same trace. Spans hold stage names, workers and
+    timings, never message text.
+    """
+
+    def __init__(self, keep: int = TRACE_KEEP, log_path: str = TRACE_LOG):
+        self.keep = keep
+        self.log_path = log_path
+        self._traces: "OrderedDict[str, dict]" = OrderedDict()
+        self._local = threading.local()
+        self._lock = threading.Lock()
+
+    def begin(self, chat_id, msg_id, sent_date=None) -> str:
+        """Start a trace for the message handled on this thread."""
+        now = time.time()
+        received = {"stage": "received", "at": now}
+        if sent_date:
+            received["telegram_lag_ms"] = max(0, int((now - sent_date) * 1000))
+        trace_id = uuid.uuid4().hex[:16]
+        self._local.trace = {"trace_id": trace_id, "chat_id": chat_id, "message_id": msg_id, "spans": [received]}
+        return trace_id
+
+    def current(self) -> Optional[str]:
+        trace = getattr(self._local, "trace", None)
+        return trace["trace_id"] if trace else None
+
+    def end(self):
+        self._local.trace = None
+
+    def span(self, trace_id: Optional[str], stage: str, **fields):
+        """Record one stage; unknown ids (evicted, pre-restart) only reach the log."""
+        if not trace_id:
+            return
+        span = dict(fields, stage=stage, at=time.time())
+        new = []
+        with self._lock:
+            trace = self._traces.get(trace_id)
+            local = getattr(self._local, "trace", None)
+            if trace is None and local and local["trace_id"] == trace_id:
+                trace = self._traces[trace_id] = local
+                new = list(local["spans"])
+                while len(self._traces) > self.keep:
+                    self._traces.popitem(last=False)
+            if trace is not None:
+                trace["spans"].append(span)
+        if self.log_path:
+            self._log(trace_id, new + [span])
+
+    def _log(self, trace_id: str, spans: list):
+        lines = "".join(json.dumps(dict(span, trace_id=trace_id)) + "\n" for span in spans)
+        try:
+            # Spans carry chat ids and worker names: 0o600 like the session files
+            fd = os.open(self.log_path, os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o600)
+            with os.fdopen(fd, "a") as f:
+                f.write(lines)
+        except OSError as e:
+            print(f"Trace log write failed: {e}")
+
+    def get(self, trace_id: str) -> Optional[dict]:
+        """Trace with each span's offset from receipt (ms), or None."""
+        with self._lock:
+            trace = self._traces.get(trace_id)
+            if trace is None:
+                return None
+            spans = [dict(span) for span in trace["spans"]]
+        start = spans[0]["at"]
+        for span in spans:
+            span["ms"] = int((span["at"] - start) * 1000)
+        return {
+            "trace_id": trace_id,
+            "chat_id": trace["chat_id"],
+            "message_id": trace["message_id"],
+            "total_ms": spans[-1]["ms"],
+            "spans": spans,
+        }
+
+
+tracer = Tracer()
+
+
 # ─────────────────────────────────────────────────────────────────────────────
 # Worker Backend Helpers
 # ─────────────────────────────────────────────────────────────────────────────
@@ -1336,6 +3062,8 @@ def format_team_lines(registered: dict, active: Optional[str], pending_lookup=No
             status.append("focused")
         status.append("working" if pending_lookup(name) else "available")
         status.append(f"backend={backend}")
+        if session.get("host"):
+            status.append(f"host={session['host']}")
         lines.append(f"- {name} ({', '.join(status)})")
     return lines
 
@@ -1347,7 +3075,10 @@ def format_progress_lines(
     online: bool,
     ready: bool,
     mode: str,
-    needs_attention: Optional[str] = None
+    needs_attention: Optional[str] = None,
+    transcript_wait_ms: Optional[int] = None,
+    queue: Optional[tuple] = None,
+    inbox: Optional[tuple] = None
 ) -> list[str]:
     """Format /progress response lines (backend-aware)."""
     status = []
@@ -1360,6 +3091,14 @@ def format_progress_lines(
     if needs_attention:
         status.append(f"Needs attention: {needs_attention}")
     status.append(f"Mode: {mode}")
+    if queue is not None:
+        waiting, in_flight = queue
+        status.append(f"Queue: {waiting} waiting, {in_flight} in flight (max {ADAPTER_QUEUE_DEPTH})")
+    if transcript_wait_ms is not None:
+        status.append(f"Last reply flush wait: {transcript_wait_ms} ms")
+    if inbox and inbox[0]:
+        files, size = inbox
+        status.append(f"Inbox: {files} file{'s' if files != 1 else ''}, {format_file_size(size)}")
     return status
 
 
@@ -1375,20 +3114,107 @@ def get_worker_backend(name: str, session: Optional[dict] = None) -> str:
     return DEFAULT_BACKEND
 
 
+def worker_welcome(backend_obj) -> str:
+    """Welcome message sent to a new worker."""
+    welcome = (
+        "You are connected to Telegram via claudecode-telegram bridge. "
+        "Manager can send you files (images, PDFs, documents) - they'll appear as local paths. "
+        "To send files back: [[file:/path/to/doc.pdf|caption]] or [[image:/path/to/img.png|caption]]. "
+        "Allowed paths: /tmp, current directory. "
+        "To message other workers: curl $BRIDGE_URL/workers to discover workers and their protocols. "
+        "For tmux workers: use tmux send-keys. "
+        "For pipe workers: use 'echo msg > pipe &' (background!) — writing to a pipe BLOCKS until read, so never use cat/echo without & or your session will freeze. "
+        "Do NOT output worker messages normally or they go to Telegram."
+    )
+    if not backend_obj.is_interactive:
+        welcome += (
+            " Your bridge URL is in $BRIDGE_URL env var. "
+            "You run in non-interactive mode — each message triggers a blocking CLI call, "
+            "responses arrive async in Telegram. Use nohup/& if calling CLI directly."
+        )
+    elif SANDBOX_ENABLED:
+        welcome += " Running in sandbox mode (Docker container)."
+    return welcome
+
+
 # ─────────────────────────────────────────────────────────────────────────────
 # CORE: WorkerManager
 # ─────────────────────────────────────────────────────────────────────────────
 
+REGISTRY_RECONCILE_INTERVAL = float(os.environ.get("REGISTRY_RECONCILE_INTERVAL", "30"))  # Seconds
+HIRE_SHELL_TIMEOUT = float(os.environ.get("HIRE_SHELL_TIMEOUT", "5"))  # New pane -> shell prompt
+HIRE_READY_TIMEOUT = float(os.environ.get("HIRE_READY_TIMEOUT", "30"))  # Start cmd -> backend prompt (x2 in sandbox)
+
+
 class WorkerManager:
+    """Worker lifecycle + an in-memory registry of workers.
+
+    The registry is loaded once (first read or startup), refreshed by
+    hire/end/restart and /team, and reconciled with tmux every
+    REGISTRY_RECONCILE_INTERVAL seconds by a background thread. Reads on the
+    message path never fork tmux. Without the reconcile thread (tests, direct
+    imports) a read rescans once the registry is older than the interval.
+    Each scan takes a generation number when it starts; a scan that finishes
+    after a newer one (or after invalidate()) does not replace the registry.
+    """
+
     def __init__(self, sessions_dir: Path, tmux_prefix: str):
         self.sessions_dir = sessions_dir
         self.tmux_prefix = tmux_prefix
+        self._registry: Optional[dict] = None
+        self._registry_at = 0.0
+        self._generation = 0  # Last generation handed to a scan
+        self._registry_generation = 0  # Generation of the cached registry (or of the last invalidate)
+        self._registry_lock = threading.Lock()
+        self._reconcile_thread = None
+        self.registry_stats = {"hits": 0, "scans": 0}
+        self._starting: Dict[str, threading.Event] = {}  # Interactive workers still booting
+        self._hire_started: Dict[str, tuple] = {}  # name -> (monotonic, backend, source) until ready
 
     def _sync_paths(self):
         if self.sessions_dir != SESSIONS_DIR:
             self.sessions_dir = SESSIONS_DIR
+            self.invalidate()
         if self.tmux_prefix != TMUX_PREFIX:
             self.tmux_prefix = TMUX_PREFIX
+            self.invalidate()
+
+    def invalidate(self):
+        """Drop the cached registry; the next read rescans."""
+        with self._registry_lock:
+            self._registry = None
+            self._registry_generation = self._generation  # Scans already running are stale
+
+    def _next_generation(self) -> int:
+        with self._registry_lock:
+            self._generation += 1
+            return self._generation
+
+    def refresh(self) -> dict:
+        """Rescan tmux + session dirs now and replace the cached registry.
+
+        The only way a scan reaches the registry: its generation is taken
+        before scanning, so a slow scan never overwrites a newer one.
+        """
+        generation = self._next_generation()
+        return self._rebuild(self.scan_tmux_sessions(), generation)
+
+    def start_reconcile(self, interval: float = REGISTRY_RECONCILE_INTERVAL):
+        """Start the periodic reconcile thread (idempotent)."""
+        if self._reconcile_thread and self._reconcile_thread.is_alive():
+            return
+
+        def loop():
+            while True:
+                time.sleep(interval)
+                try:
+                    worker_hosts.poll()  # Here, not on the hire/end path: an unreachable host costs a timeout
+                    self.refresh()
+                except Exception as e:
+                    print(f"Error reconciling worker registry: {e}")
+
+        self._reconcile_thread = threading.Thread(target=loop, daemon=True, name="registry-reconcile")
+        self._reconcile_thread.start()
 
     def scan_tmux_sessions(self):
         """Scan tmux for claude-* sessions (registered)."""
@@ -1396,14 +3222,11 @@ class WorkerManager:
         registered = {}
 
         try:
-            result = subprocess.run(
-                ["tmux", "list-sessions", "-F", "#{session_name}"],
-                capture_output=True, text=True
-            )
-            if result.returncode != 0:
+            rc, out = tmux_run(["list-sessions", "-F", "#{session_name}"])
+            if rc != 0:
                 return registered
 
-            for line in result.stdout.strip().split("\n"):
+            for line in out.strip().split("\n"):
                 if not line:
                     continue
                 session_name = line.strip()
@@ -1417,11 +3240,32 @@ class WorkerManager:
 
         return registered
 
-    def get_registered_sessions(self, registered=None):
-        """Get registered sessions from tmux (all backends have tmux now)."""
+    def _registry_fresh(self) -> bool:
+        if self._registry is None:
+            return False
+        if self._reconcile_thread and self._reconcile_thread.is_alive():
+            return True
+        return (time.monotonic() - self._registry_at) < REGISTRY_RECONCILE_INTERVAL
+
+    def get_registered_sessions(self):
+        """Get registered sessions (all backends have tmux now).
+
+        Returns a copy of the cached registry, rescanning through refresh()
+        when it is stale.
+        """
         self._sync_paths()
-        if registered is None:
-            registered = self.scan_tmux_sessions()
+        with self._registry_lock:
+            cached = dict((k, dict(v)) for k, v in self._registry.items()) if self._registry_fresh() else None
+            if cached is not None:
+                self.registry_stats["hits"] += 1
+        if cached is None:
+            return self.refresh()
+        return self._set_active(cached)
+
+    def _rebuild(self, registered: dict, generation: int) -> dict:
+        """Cache a tmux scan taken at `generation`, unless a newer one landed."""
+        with self._registry_lock:
+            self.registry_stats["scans"] += 1
 
         # Fallback: pick up non-interactive workers with backend file but orphaned tmux
         if self.sessions_dir.exists():
@@ -1434,21 +3278,54 @@ class WorkerManager:
                             backend = backend_file.read_text().strip()
                             registered[name] = {"backend": backend}
 
+        # Workers on other hosts (front bridge with WORKER_HOSTS), as of the last poll
+        for name, info in worker_hosts.sessions().items():
+            registered.setdefault(name, info)
+
+        with self._registry_lock:
+            if generation > self._registry_generation:
+                self._registry = dict((k, dict(v)) for k, v in registered.items())
+                self._registry_at = time.monotonic()
+                self._registry_generation = generation
+            elif self._registry is not None:
+                # A scan that started later already landed: serve that one
+                registered = dict((k, dict(v)) for k, v in self._registry.items())
+        return self._set_active(registered)
+
+    @staticmethod
+    def _set_active(registered: dict) -> dict:
+        """Keep the focused worker one that exists in this registry."""
         if state["active"] and state["active"] not in registered:
             state["active"] = None
         if registered and not state["active"]:
             state["active"] = list(registered.keys())[0]
-
         return registered
 
+    def is_starting(self, name: str) -> bool:
+        event = self._starting.get(name)
+        return event is not None and not event.is_set()
+
+    def wait_ready(self, name: str, timeout: float = HIRE_READY_TIMEOUT) -> bool:
+        """Block until a booting worker finished startup (True if not booting)."""
+        event = self._starting.get(name)
+        return event.wait(timeout) if event else True
+
     def is_online(self, name: str, session: dict = None) -> bool:
-        """Check if worker is online and ready."""
+        """Check if worker is online and ready (a booting worker counts as online)."""
         self._sync_paths()
+        if self.is_starting(name):
+            return True
         if not session:
             sessions = self.get_registered_sessions()
             session = sessions.get(name)
         if not session:
             return False
+        if session.get("host"):
+            try:
+                return bool(worker_hosts.call(session, "is_online", name=name))
+            except HostError as e:
+                print(f"Worker host {e}")
+                return False
 
         backend_name = normalize_backend(session.get("backend"))
         backend = get_backend(backend_name)
@@ -1464,11 +3341,25 @@ class WorkerManager:
             session = sessions.get(name)
         if not session:
             return False
+        if session.get("host"):
+            try:
+                return bool(worker_hosts.call(session, "send", name=name, message=message, chat_id=chat_id,
+                                              trace_id=read_trace_id(name)))
+            except HostError as e:
+                print(f"Worker host {e}")
+                return False
 
         backend_name = normalize_backend(session.get("backend"))
         backend = get_backend(backend_name)
         tmux_name = session.get("tmux", f"{self.tmux_prefix}{name}")
 
+        # Messages to a booting worker wait for its prompt (welcome goes first)
+        if self.is_starting(name) and not self.wait_ready(name):
+            print(f"Worker '{name}' still starting, sending anyway")
+        if SANDBOX_ENABLED and backend.is_interactive:
+            sandbox.touch(name)  # Unpauses an idle-paused container first
+        if PANE_STREAM and backend.is_interactive and pane_streams.attach(name, tmux_name):
+            pane_streams.mark(tmux_name)
         return backend.send(name, tmux_name, message, BRIDGE_URL, self.sessions_dir)
 
     def get_workers(self):
@@ -1477,6 +3368,8 @@ class WorkerManager:
         workers = []
         registered = self.get_registered_sessions()
         for name, info in registered.items():
+            if info.get("host"):
+                continue  # Listed below with the address valid on its host
             backend_name = get_worker_backend(name, info)
             backend = get_backend(backend_name)
             if not backend.is_interactive:
@@ -1498,10 +3391,17 @@ class WorkerManager:
                     "address": tmux_name,
                     "send_example": f"tmux send-keys -t {tmux_name} 'your message here' Enter"
                 })
+        workers.extend(worker_hosts.workers())
         return workers
 
     def hire(self, name: str, backend: str = DEFAULT_BACKEND, chat_id: int = None):
-        """Create a new worker instance."""
+        """Create a new worker instance.
+
+        Returns once the tmux session exists, env is exported and the start
+        command is typed. For interactive backends the rest (bypass dialog,
+        prompt, welcome) runs on a per-worker startup thread, so several
+        hires can proceed at once; send() waits for it.
+        """
         self._sync_paths()
         if not is_valid_backend(backend):
             return False, f"Unknown backend '{backend}'. Available: {', '.join(list_backends())}"
@@ -1511,24 +3411,39 @@ class WorkerManager:
         tmux_name = f"{self.tmux_prefix}{name}"
         if tmux_exists(tmux_name):
             return False, f"Worker '{name}' already exists"
+        if worker_hosts.hosts:
+            registered = self.refresh()
+            if name in registered:
+                return False, f"Worker '{name}' already exists"
+            local = sum(1 for info in registered.values() if not info.get("host"))
+            host = worker_hosts.place(local)
+            if host is not None:
+                return self._hire_remote(host, name, backend, chat_id)
+
+        started = time.monotonic()
+        if backend_obj.is_interactive and worker_pool.claim(name, backend, tmux_name):
+            self._hire_started[name] = (started, backend, "pool")
+            return self._hire_from_pool(name, backend, tmux_name)
+        self._hire_started[name] = (started, backend, "cold")
 
         result = subprocess.run(
             ["tmux", "new-session", "-d", "-s", tmux_name, "-x", "200", "-y", "50"],
             capture_output=True
         )
         if result.returncode != 0:
+            self._hire_started.pop(name, None)
             return False, "Could not start the worker workspace"
 
-        time.sleep(0.5)
+        if not wait_for_pane(tmux_name, pane_shell_ready, HIRE_SHELL_TIMEOUT):
+            print(f"Worker '{name}': no shell prompt after {HIRE_SHELL_TIMEOUT}s, continuing")
 
+        # tmux commands are synchronous and keystrokes queue in the pty,
+        # so env export + eval + start command need no sleeps in between
         export_hook_env(tmux_name, backend)
-        time.sleep(0.3)
 
         # Inject tmux session env vars into the running shell so processes
         # spawned inside (claude, codex, etc.) inherit them as real env vars
-        subprocess.run(["tmux", "send-keys", "-t", tmux_name,
-                        'eval "$(tmux show-environment -s)"', "Enter"])
-        time.sleep(0.3)
+        tmux_run(["send-keys", "-t", tmux_name, 'eval "$(tmux show-environment -s)"', "Enter"], capture=False)
 
         ensure_session_dir(name)
         if not backend_obj.is_interactive:
@@ -1537,63 +3452,123 @@ class WorkerManager:
         if not backend_obj.is_interactive:
             backend_file = self.sessions_dir / name / "backend"
             backend_file.write_text(backend)
+            if ADAPTER_AGENT:
+                # Warm the resident adapter so the first turn skips the cold start too
+                threading.Thread(
+                    target=adapter_agents.get, args=(name, backend, BRIDGE_URL, self.sessions_dir), daemon=True
+                ).start()
+        if backend_obj.is_interactive:
+            self._starting[name] = threading.Event()
+        self.refresh()  # New worker is visible to send()/is_online() from here on
 
         if SANDBOX_ENABLED and backend_obj.is_interactive:
-            docker_cmd = get_docker_run_cmd(name)
-            subprocess.run(["tmux", "send-keys", "-t", tmux_name, docker_cmd, "Enter"])
+            docker_cmd = sandbox.start_cmd(name)
+            tmux_run(["send-keys", "-t", tmux_name, docker_cmd, "Enter"], capture=False)
             print(f"Started worker '{name}' in sandbox mode")
         else:
             start_cmd = backend_obj.start_cmd()
-            subprocess.run(["tmux", "send-keys", "-t", tmux_name, start_cmd, "Enter"])
-            if backend_obj.is_interactive:
-                time.sleep(1.5)
-                subprocess.run(["tmux", "send-keys", "-t", tmux_name, "2"])
-                time.sleep(0.3)
-                subprocess.run(["tmux", "send-keys", "-t", tmux_name, "Enter"])
+            tmux_run(["send-keys", "-t", tmux_name, start_cmd, "Enter"], capture=False)
 
-        if backend_obj.is_interactive:
-            time.sleep(2.0 if not SANDBOX_ENABLED else 5.0)
-
-        welcome = (
-            "You are connected to Telegram via claudecode-telegram bridge. "
-            "Manager can send you files (images, PDFs, documents) - they'll appear as local paths. "
-            "To send files back: [[file:/path/to/doc.pdf|caption]] or [[image:/path/to/img.png|caption]]. "
-            "Allowed paths: /tmp, current directory. "
-            "To message other workers: curl $BRIDGE_URL/workers to discover workers and their protocols. "
-            "For tmux workers: use tmux send-keys. "
-            "For pipe workers: use 'echo msg > pipe &' (background!) — writing to a pipe BLOCKS until read, so never use cat/echo without & or your session will freeze. "
-            "Do NOT output worker messages normally or they go to Telegram."
-        )
+        welcome = worker_welcome(backend_obj)
         if not backend_obj.is_interactive:
             if chat_id:
                 set_pending(name, chat_id)
-            welcome += (
-                " Your bridge URL is in $BRIDGE_URL env var. "
-                "You run in non-interactive mode — each message triggers a blocking CLI call, "
-                "responses arrive async in Telegram. Use nohup/& if calling CLI directly."
-            )
             # Echo welcome to tmux (visible for debugging) but don't call backend
             # to avoid triggering a codex API call on hire
-            subprocess.run(["tmux", "send-keys", "-t", tmux_name, f"echo '{welcome[:200]}...'", "Enter"])
+            tmux_run(["send-keys", "-t", tmux_name, f"echo '{welcome[:200]}...'", "Enter"], capture=False)
         else:
-            if SANDBOX_ENABLED:
-                welcome += " Running in sandbox mode (Docker container)."
-            self.send(name, welcome)
+            self._start_startup_thread(name, tmux_name, welcome)
 
         state["active"] = name
         save_last_active(name)
 
         if not backend_obj.is_interactive:
             print(f"Created {backend} worker '{name}' (non-interactive mode)")
+            self._record_hire(name)
 
         return True, None
 
+    def _hire_remote(self, host, name: str, backend: str, chat_id: int = None):
+        started = time.monotonic()
+        try:
+            ok, err = host.call("hire", name=name, backend=backend, chat_id=chat_id)
+        except HostError as e:
+            return False, f"Worker host {e}"
+        if ok:
+            print(f"Hired '{name}' on host {host.name}")
+            if chat_id and not get_backend(backend).is_interactive:
+                set_pending(name, chat_id)  # Like a local hire: the welcome reply is delivered from here
+            metrics.observe("hire_seconds", time.monotonic() - started, worker=name, backend=backend, source=host.name)
+            host.poll()  # Just answered, so it is reachable
+            self.refresh()
+            state["active"] = name
+            save_last_active(name)
+        return ok, err
+
+    def _remote_call(self, session: dict, method: str, name: str):
+        """end/restart of a worker on another host."""
+        try:
+            ok, err = worker_hosts.call(session, method, name=name)
+        except HostError as e:
+            return False, f"Worker host {e}"
+        if ok and method == "end":
+            clear_pending(name)
+            if state["active"] == name:
+                state["active"] = None
+        worker_hosts.hosts[session["host"]].poll()
+        self.refresh()
+        return ok, err
+
+    def _record_hire(self, name: str):
+        hire = self._hire_started.pop(name, None)
+        if hire is not None:
+            started, backend, source = hire
+            metrics.observe("hire_seconds", time.monotonic() - started, worker=name, backend=backend, source=source)
+
+    def _hire_from_pool(self, name: str, backend: str, tmux_name: str):
+        """Finish a hire on a pre-warmed session (already renamed to tmux_name)."""
+        export_hook_env(tmux_name, backend)
+        ensure_session_dir(name)
+        self._starting[name] = threading.Event()
+        self.refresh()
+        self._start_startup_thread(name, tmux_name, worker_welcome(get_backend(backend)))
+        state["active"] = name
+        save_last_active(name)
+        print(f"Hired '{name}' from the {backend} pool")
+        return True, None
+
+    def _start_startup_thread(self, name: str, tmux_name: str, welcome: Optional[str]):
+        event = self._starting.setdefault(name, threading.Event())
+        event.clear()
+        threading.Thread(
+            target=self._finish_startup,
+            args=(name, tmux_name, welcome, event),
+            daemon=True,
+            name=f"startup-{name}"
+        ).start()
+
+    def _finish_startup(self, name: str, tmux_name: str, welcome: Optional[str], event: threading.Event):
+        """Wait for the backend prompt (answering the dialog), then send welcome."""
+        try:
+            wait_backend_ready(tmux_name, name)
+            if welcome and tmux_exists(tmux_name):
+                tmux_send_message(tmux_name, welcome)
+        except Exception as e:
+            print(f"Worker '{name}' startup error: {e}")
+        finally:
+            event.set()
+            if self._starting.get(name) is event:
+                self._starting.pop(name, None)
+            self._record_hire(name)
+
     def end(self, name: str):
         """Kill a worker instance."""
         self._sync_paths()
         registered = self.get_registered_sessions()
         if name not in registered:
             return False, f"Worker '{name}' not found"
+        if registered[name].get("host"):
+            return self._remote_call(registered[name], "end", name)
 
         session = registered[name]
         backend_name = get_worker_backend(name, session)
@@ -1611,19 +3586,24 @@ class WorkerManager:
                     session_id_file.unlink()
             except Exception as e:
                 return False, f"Failed to clean non-interactive metadata: {e}"
+            adapter_queue.discard(name)
+            adapter_agents.stop(name)
             clear_pending(name)
 
         if SANDBOX_ENABLED and backend.is_interactive:
             stop_docker_container(name)
+        pane_streams.detach(tmux_name)
 
         # All backends have tmux sessions now
         subprocess.run(["tmux", "kill-session", "-t", tmux_name], capture_output=True)
         cleanup_inbox(name)
         cleanup_worker_pipe(name)
+        remove_session_aliases(name)
+        forget_chat_id(name)
 
         if state["active"] == name:
             state["active"] = None
-            self.get_registered_sessions()
+        self.refresh()
 
         return True, None
 
@@ -1633,6 +3613,8 @@ class WorkerManager:
         registered = self.get_registered_sessions()
         if name not in registered:
             return False, f"Worker '{name}' not found"
+        if registered[name].get("host"):
+            return self._remote_call(registered[name], "restart", name)
 
         session = registered[name]
         backend_name = get_worker_backend(name, session)
@@ -1648,37 +3630,511 @@ class WorkerManager:
             session_dir.mkdir(parents=True, exist_ok=True)
             for session_id_file in session_dir.glob("*_session_id"):
                 session_id_file.unlink()
+            adapter_agents.stop(name)  # Drops the in-memory session id too
             ensure_worker_pipe(name)
             clear_pending(name)
         elif is_claude_running(tmux_name):
             return False, "Worker is already running"
 
         export_hook_env(tmux_name, backend_name)
-        time.sleep(0.3)
 
         # Inject tmux session env vars into the running shell
-        subprocess.run(["tmux", "send-keys", "-t", tmux_name,
-                        'eval "$(tmux show-environment -s)"', "Enter"])
-        time.sleep(0.3)
+        tmux_run(["send-keys", "-t", tmux_name, 'eval "$(tmux show-environment -s)"', "Enter"], capture=False)
 
         if SANDBOX_ENABLED and backend.is_interactive:
-            stop_docker_container(name)
-            time.sleep(0.5)
-            docker_cmd = get_docker_run_cmd(name)
-            subprocess.run(["tmux", "send-keys", "-t", tmux_name, docker_cmd, "Enter"])
+            if not SANDBOX_REUSE:
+                stop_docker_container(name)  # docker stop/rm return once the container is gone
+            # Reuse: the kept container is started if needed and a new CLI exec'd in it
+            docker_cmd = sandbox.start_cmd(name)
+            tmux_run(["send-keys", "-t", tmux_name, docker_cmd, "Enter"], capture=False)
         else:
             start_cmd = backend.start_cmd()
-            subprocess.run(["tmux", "send-keys", "-t", tmux_name, start_cmd, "Enter"])
+            tmux_run(["send-keys", "-t", tmux_name, start_cmd, "Enter"], capture=False)
 
+        if backend.is_interactive:
+            self._start_startup_thread(name, tmux_name, None)
+        self.refresh()
         return True, None
 
 
 worker_manager = WorkerManager(SESSIONS_DIR, TMUX_PREFIX)
 
 
+# ─────────────────────────────────────────────────────────────────────────────
+# Worker hosts (one bot, workers on several machines)
+# ─────────────────────────────────────────────────────────────────────────────
+
+HOST_AGENT = os.environ.get("HOST_AGENT", "0") == "1"  # Serve /rpc for a front bridge instead of Telegram
+WORKER_HOSTS = os.environ.get("WORKER_HOSTS", "")  # Front bridge: "name=http://host:port,..."
+HOST_SECRET = os.environ.get("HOST_SECRET", "")  # Shared by the front and its hosts (X-Host-Secret)
+HOST_RPC_TIMEOUT = float(os.environ.get("HOST_RPC_TIMEOUT", "10"))
+HOST_MIN_FREE_MB = int(os.environ.get("HOST_MIN_FREE_MB", "512"))  # Hosts with less free memory get no hires
+HOST_RPC_CONNECTIONS = 4  # Idle keep-alive connections kept per host
+
+
+def parse_worker_hosts(spec: str) -> Dict[str, str]:
+    """Parse WORKER_HOSTS (e.g. "gpu1=http://10.0.0.5:8090") into {name: url}."""
+    hosts = {}
+    for part in (spec or "").split(","):
+        name, sep, url = part.strip().partition("=")
+        if sep and name.strip() and url.strip():
+            hosts[name.strip()] = url.strip().rstrip("/")
+    return hosts
+
+
+def host_load(workers: int) -> dict:
+    """Placement inputs for this machine: worker count, 1-min load per CPU, free memory."""
+    try:
+        load = round(os.getloadavg()[0] / (os.cpu_count() or 1), 2)
+    except (OSError, AttributeError):
+        load = None
+    mem_free_mb = None
+    try:
+        with open("/proc/meminfo") as f:
+            for line in f:
+                if line.startswith("MemAvailable:"):
+                    mem_free_mb = int(line.split()[1]) // 1024
+                    break
+    except OSError:
+        pass  # Not Linux: placement uses workers and load only
+    return {"workers": workers, "load": load, "mem_free_mb": mem_free_mb}
+
+
+def placement_score(load: dict) -> Optional[float]:
+    """Lower is better: workers + 2 x load per CPU. None if memory is short."""
+    if load.get("mem_free_mb") is not None and load["mem_free_mb"] < HOST_MIN_FREE_MB:
+        return None
+    return load.get("workers", 0) + 2 * (load.get("load") or 0)
+
+
+class HostError(Exception):
+    pass
+
+
+class RemoteHost:
+    """RPC client for one worker host: JSON POSTs to its /rpc over kept-alive connections."""
+
+    IDEMPOTENT = {"status", "is_online"}  # Safe to resend if the host may already have run them
+
+    def __init__(self, name: str, url: str, secret: Optional[str] = None, timeout: float = HOST_RPC_TIMEOUT):
+        parsed = urllib.parse.urlsplit(url)
+        self.name = name
+        self.url = url
+        self.secret = HOST_SECRET if secret is None else secret
+        self.timeout = timeout
+        self._https = parsed.scheme == "https"
+        self._netloc = parsed.netloc
+        self._path = parsed.path.rstrip("/") + "/rpc"
+        self._idle = []
+        self._lock = threading.Lock()
+        self.sessions: Dict[str, dict] = {}  # Last listing (kept while the host is unreachable)
+        self.workers: list = []
+        self.load: dict = {}
+        self.online = False
+
+    def _connection(self):
+        with self._lock:
+            if self._idle:
+                return self._idle.pop(), True
+        cls = http.client.HTTPSConnection if self._https else http.client.HTTPConnection
+        return cls(self._netloc, timeout=self.timeout), False
+
+    def call(self, method: str, **params):
+        """Run one RPC; raises HostError if the host is unreachable or refuses."""
+        body = json.dumps({"method": method, "params": params}).encode()
+        headers = {"Content-Type": "application/json", "X-Host-Secret": self.secret, "Connection": "keep-alive"}
+        while True:
+            conn, reused = self._connection()
+            sent = False
+            try:
+                conn.request("POST", self._path, body, headers)
+                sent = True
+                response = conn.getresponse()
+                payload = response.read()
+                break
+            except (OSError, http.client.HTTPException) as e:
+                conn.close()
+                # A kept-alive connection the host closed while idle: retry on a new one, but
+                # never after a timeout, and after the request went out only if it is idempotent
+                stale = isinstance(e, (http.client.RemoteDisconnected, ConnectionResetError))
+                if reused and not isinstance(e, TimeoutError) and (not sent or (stale and method in self.IDEMPOTENT)):
+                    continue
+                if not sent or method in self.IDEMPOTENT:
+                    self.online = False
+                    raise HostError(f"{self.name} unreachable: {e}")
+                raise HostError(f"{self.name}: no answer to {method} ({e}), it may still have run")
+        with self._lock:
+            if len(self._idle) < HOST_RPC_CONNECTIONS:
+                self._idle.append(conn)
+            else:
+                conn.close()
+        if response.status != 200:
+            raise HostError(f"{self.name}: HTTP {response.status} {payload[:100].decode(errors='replace')}")
+        data = json.loads(payload)
+        self.online = True
+        if not data.get("ok"):
+            raise HostError(f"{self.name}: {data.get('error')}")
+        return data.get("result")
+
+    def poll(self):
+        """Refresh this host's workers and load (keeps the last listing on failure)."""
+        try:
+            result = self.call("status")
+        except HostError as e:
+            print(f"Worker host {e}")
+            return
+        self.sessions = result.get("sessions") or {}
+        self.workers = result.get("workers") or []
+        self.load = result.get("load") or {}
+
+
+class WorkerHosts:
+    """The front bridge's worker hosts (WORKER_HOSTS).
+
+    The front owns the bot, the webhook and CommandRouter. Each host runs
+    bridge.py with HOST_AGENT=1 and BRIDGE_URL pointing at the front, so
+    its hooks deliver responses straight to the front (which holds chat_id
+    and pending for every worker). Remote workers join the registry with a
+    "host" key; WorkerManager sends their hire/send/end/restart here.
+    Listings are polled by the reconcile loop and after a remote hire/end;
+    registry rebuilds, placement and the message path use the last poll.
+    """
+
+    def __init__(self, hosts: Dict[str, str]):
+        self.hosts = {name: RemoteHost(name, url) for name, url in hosts.items()}
+
+    def poll(self) -> Dict[str, dict]:
+        """Poll every host in parallel; returns remote sessions tagged with their host."""
+        fan_out(lambda host: host.poll(), list(self.hosts.values()), BROADCAST_CONCURRENCY)
+        return self.sessions()
+
+    def sessions(self) -> Dict[str, dict]:
+        merged = {}
+        for host in self.hosts.values():
+            for name, info in host.sessions.items():
+                merged.setdefault(name, dict(info, host=host.name))
+        return merged
+
+    def workers(self) -> list:
+        return [dict(worker, host=host.name) for host in self.hosts.values() for worker in host.workers]
+
+    def remote(self, name: str) -> Optional[dict]:
+        """A remote worker's entry (tagged with its host) from the last poll, or None."""
+        if not self.hosts:
+            return None
+        return self.sessions().get(name)
+
+    def call(self, session: dict, method: str, **params):
+        host = self.hosts.get(session.get("host"))
+        if host is None:
+            raise HostError(f"unknown host '{session.get('host')}'")
+        return host.call(method, **params)
+
+    def place(self, local_workers: int) -> Optional[RemoteHost]:
+        """Host for a new worker: None for this machine, else the least loaded host."""
+        candidates = [(placement_score(host_load(local_workers)), 0, None)]
+        for i, host in enumerate(self.hosts.values(), 1):
+            if host.online:
+                candidates.append((placement_score(dict(host.load, workers=len(host.sessions))), i, host))
+        candidates = [c for c in candidates if c[0] is not None]
+        if not candidates:
+            return None  # Every host is short on memory: keep the hire local
+        return min(candidates, key=lambda c: (c[0], c[1]))[2]
+
+
+worker_hosts = WorkerHosts(parse_worker_hosts(WORKER_HOSTS))
+
+
+def plaintext_rpc_warnings() -> list:
+    """Host links that are not https and leave this machine (secret/messages in the clear)."""
+    links = [(f"Worker host {host.name}", host.url, "HOST_SECRET and messages") for host in worker_hosts.hosts.values()]
+    if HOST_AGENT:
+        links.append(("BRIDGE_URL", BRIDGE_URL, "worker replies"))
+    warnings = []
+    for label, url, what in links:
+        parsed = urllib.parse.urlsplit(url)
+        if parsed.scheme != "https" and parsed.hostname not in ("localhost", "127.0.0.1", "::1"):
+            warnings.append(f"Warning: {label} {url} is not https: {what} travel in plain text")
+    return warnings
+
+
+def store_inbox_file(name: str, ext: str, data: bytes) -> Path:
+    """Write bytes the front bridge passed on into a worker's inbox here (0o600)."""
+    if len(data) > MAX_FILE_SIZE:
+        raise ValueError(f"file too large: {len(data)} > {MAX_FILE_SIZE}")
+    ext = ext if re.fullmatch(r'\.[A-Za-z0-9]{1,10}', ext or "") else ""
+    inbox = ensure_inbox_dir(name)
+    path = inbox / f"{uuid.uuid4().hex}{ext}"
+    part = inbox / f".{path.name}.part"
+    fd = os.open(part, os.O_WRONLY | os.O_CREAT | os.O_EXCL, 0o600)
+    with os.fdopen(fd, "wb") as f:
+        f.write(data)
+    os.replace(part, path)
+    inbox_gc.protect(name, path)
+    return path
+
+
+def hand_file_to_worker(name: str, local_path: str) -> Optional[str]:
+    """Path worker `name` can open for a file downloaded into this bridge's inbox.
+
+    A worker on another host gets a copy in its inbox there (put_file RPC)
+    and the local copy is removed. None if the host could not take it.
+    """
+    session = worker_hosts.remote(name)
+    if not session:
+        return local_path
+    path = Path(local_path)
+    try:
+        data = base64.b64encode(path.read_bytes()).decode()
+        return worker_hosts.call(session, "put_file", name=name, ext=path.suffix, data=data)
+    except (OSError, HostError) as e:
+        print(f"File for '{name}' not passed to its host: {e}")
+        return None
+    finally:
+        path.unlink(missing_ok=True)
+
+
+def fetch_worker_file(name: str, session: dict, path: str, kind: str) -> Optional[Path]:
+    """Copy a file a remote worker tagged in its reply from its host (get_file RPC).
+
+    The copy keeps its file name (Telegram shows it) in a private dot-dir of
+    the worker's inbox here, which inbox GC skips; the caller removes it.
+    """
+    try:
+        data = base64.b64decode(worker_hosts.call(session, "get_file", name=name, path=path, kind=kind))
+        folder = ensure_inbox_dir(name) / f".host-{uuid.uuid4().hex}"
+        folder.mkdir(mode=0o700)
+        local = folder / (Path(path).name or "file")
+        fd = os.open(local, os.O_WRONLY | os.O_CREAT | os.O_EXCL, 0o600)
+        with os.fdopen(fd, "wb") as f:
+            f.write(data)
+        return local
+    except (OSError, ValueError, HostError) as e:
+        print(f"Cannot fetch {path} from '{name}' host: {e}")
+        return None
+
+
+def handle_host_rpc(method: str, params: dict):
+    """Run one RPC from the front bridge on this host (HOST_AGENT=1)."""
+    _sync_worker_manager()
+    if method == "status":
+        registered = worker_manager.refresh()
+        return {"sessions": registered, "workers": worker_manager.get_workers(), "load": host_load(len(registered))}
+    name = params.get("name", "")
+    if not re.fullmatch(r'[a-z0-9-]+', name or ""):
+        raise ValueError("invalid worker name")
+    if method == "hire":
+        return list(worker_manager.hire(name, params.get("backend") or DEFAULT_BACKEND, chat_id=params.get("chat_id")))
+    if method == "end":
+        return list(worker_manager.end(name))
+    if method == "restart":
+        return list(worker_manager.restart(name))
+    if method == "is_online":
+        return worker_manager.is_online(name)
+    if method == "send":
+        # The hook only answers a pending worker, so mark it here too
+        worker_set_pending(name, params.get("chat_id"), params.get("trace_id"))
+        ok = worker_manager.send(name, params.get("message", ""), params.get("chat_id"))
+        if not ok:
+            clear_pending(name)
+        return ok
+    if method == "put_file":
+        return str(store_inbox_file(name, params.get("ext", ""), base64.b64decode(params.get("data", ""))))
+    if method == "get_file":
+        # Same checks as a local reply's media tag
+        validate = validate_photo_path if params.get("kind") == "photo" else validate_document_path
+        ok, validated = validate(params.get("path", ""))
+        if not ok:
+            raise ValueError(validated)
+        return base64.b64encode(validated.read_bytes()).decode()
+    raise ValueError(f"unknown method '{method}'")
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Pre-warmed worker pool
+# ─────────────────────────────────────────────────────────────────────────────
+
+def parse_worker_pool(spec: str) -> Dict[str, int]:
+    """Parse WORKER_POOL (e.g. "claude=2") into {backend: size}."""
+    sizes = {}
+    for part in (spec or "").split(","):
+        part = part.strip()
+        if not part:
+            continue
+        backend, _, count = part.partition("=")
+        backend = normalize_backend(backend.strip())
+        try:
+            size = int(count) if count else 1
+        except ValueError:
+            print(f"Ignoring WORKER_POOL entry '{part}': size must be a number")
+            continue
+        if not is_valid_backend(backend):
+            print(f"Ignoring WORKER_POOL entry '{part}': unknown backend")
+            continue
+        if not get_backend(backend).is_interactive:
+            print(f"Ignoring WORKER_POOL entry '{part}': {backend} has no startup cost to pre-warm")
+            continue
+        if size > 0:
+            sizes[backend] = size
+    return sizes
+
+
+WORKER_POOL = os.environ.get("WORKER_POOL", "")  # e.g. "claude=2"; empty = no pool
+
+
+class WorkerPool:
+    """Idle, fully started sessions per backend, claimed by /hire.
+
+    A slot is a tmux session "_<prefix>pool-<backend>-<id>" (not a worker:
+    no prefix match) with hook env exported and the backend at its prompt.
+    claim() renames it to the worker's tmux name and a background thread
+    tops the pool back up. In sandbox mode the container is renamed too;
+    its BRIDGE_SESSION is fixed when the container is created, so the slot's session dir
+    becomes a symlink to the worker's and hook responses are mapped back
+    with resolve_session_alias(). Slots left by a previous bridge run are
+    adopted on start (tmux IS persistence).
+    """
+
+    def __init__(self, sizes: Dict[str, int]):
+        self.sizes = sizes
+        self._idle: Dict[str, list] = {b: [] for b in sizes}  # backend -> [slot names], ready
+        self._warming: Dict[str, int] = {b: 0 for b in sizes}
+        self._lock = threading.Lock()
+        self.stats = {"claimed": 0, "warmed": 0, "misses": 0, "dead": 0}
+
+    def slot_prefix(self, backend: str = "") -> str:
+        return f"_{TMUX_PREFIX}pool-{backend}"
+
+    def start(self):
+        """Adopt existing slots and fill every backend up to its size."""
+        if not self.sizes:
+            return
+        self.adopt()
+        print(f"Worker pool: {', '.join(f'{b}={n}' for b, n in self.sizes.items())}")
+        self.top_up()
+
+    def adopt(self):
+        rc, out = tmux_run(["list-sessions", "-F", "#{session_name}"])
+        if rc != 0:
+            return
+        for slot in out.split():
+            for backend in self.sizes:
+                if slot.startswith(self.slot_prefix(backend) + "-") and self._slot_alive(slot):
+                    with self._lock:
+                        if slot not in self._idle[backend]:
+                            self._idle[backend].append(slot)
+                            print(f"Worker pool: adopted {slot}")
+
+    def idle(self, backend: str) -> int:
+        with self._lock:
+            return len(self._idle.get(backend, []))
+
+    def top_up(self):
+        """Start warm-up threads for every missing slot."""
+        for backend, size in self.sizes.items():
+            with self._lock:
+                missing = size - len(self._idle[backend]) - self._warming[backend]
+                self._warming[backend] += max(0, missing)
+            for _ in range(max(0, missing)):
+                threading.Thread(target=self._warm, args=(backend,), daemon=True,
+                                 name=f"pool-warm-{backend}").start()
+
+    def _slot_alive(self, slot: str) -> bool:
+        """Slot session exists and the backend (not a shell) is in the pane."""
+        return tmux_exists(slot) and get_pane_command(slot) not in SHELL_COMMANDS
+
+    def _warm(self, backend: str):
+        slot = f"{self.slot_prefix(backend)}-{uuid.uuid4().hex[:6]}"
+        ok = False
+        try:
+            ok = self.warm_slot(slot, backend)
+        finally:
+            with self._lock:
+                self._warming[backend] -= 1
+                if ok:
+                    self._idle[backend].append(slot)
+                    self.stats["warmed"] += 1
+        if not ok:
+            print(f"Worker pool: failed to warm {slot}")
+            tmux_run(["kill-session", "-t", slot])
+            if SANDBOX_ENABLED and SANDBOX_REUSE:
+                stop_docker_container(slot)  # Kept containers outlive the pane
+
+    def warm_slot(self, slot: str, backend: str) -> bool:
+        """Create a slot session and drive the backend to its prompt."""
+        backend_obj = get_backend(backend)
+        result = subprocess.run(
+            ["tmux", "new-session", "-d", "-s", slot, "-x", "200", "-y", "50"],
+            capture_output=True
+        )
+        if result.returncode != 0:
+            return False
+        wait_for_pane(slot, pane_shell_ready, HIRE_SHELL_TIMEOUT)
+        export_hook_env(slot, backend)
+        tmux_run(["send-keys", "-t", slot, 'eval "$(tmux show-environment -s)"', "Enter"], capture=False)
+        if SANDBOX_ENABLED:
+            cmd = sandbox.start_cmd(slot)
+        else:
+            cmd = backend_obj.start_cmd()
+        tmux_run(["send-keys", "-t", slot, cmd, "Enter"], capture=False)
+        return wait_backend_ready(slot, slot)
+
+    def claim(self, name: str, backend: str, tmux_name: str) -> bool:
+        """Rename an idle slot to tmux_name. False if none is available."""
+        if backend not in self.sizes:
+            return False
+        while True:
+            with self._lock:
+                slot = self._idle[backend].pop(0) if self._idle[backend] else None
+            if slot is None:
+                self.stats["misses"] += 1
+                print(f"Worker pool: no idle {backend} slot, cold start for '{name}'")
+                self.top_up()
+                return False
+            if not self._slot_alive(slot):
+                self.stats["dead"] += 1
+                tmux_run(["kill-session", "-t", slot])
+                if SANDBOX_ENABLED and SANDBOX_REUSE:
+                    stop_docker_container(slot)
+                continue
+            if tmux_run(["rename-session", "-t", slot, tmux_name])[0] != 0:
+                self.stats["dead"] += 1
+                continue
+            if SANDBOX_ENABLED:
+                sandbox.rename(slot, name)
+                # The container's hook still reports BRIDGE_SESSION=<slot>
+                alias = SESSIONS_DIR / slot
+                ensure_session_dir(name)
+                if not alias.exists():
+                    alias.symlink_to(name)
+            self.stats["claimed"] += 1
+            print(f"Worker pool: '{name}' claimed {slot}")
+            self.top_up()
+            return True
+
+
+worker_pool = WorkerPool(parse_worker_pool(WORKER_POOL))
+
+
+def resolve_session_alias(session_name: str) -> str:
+    """Map a pooled sandbox slot name back to the worker that claimed it."""
+    path = SESSIONS_DIR / session_name
+    if session_name.startswith("_") and path.is_symlink():
+        return Path(os.readlink(path)).name
+    return session_name
+
+
+def remove_session_aliases(name: str):
+    """Drop slot symlinks that point at a worker's session dir."""
+    if not SESSIONS_DIR.exists():
+        return
+    for path in SESSIONS_DIR.iterdir():
+        if path.is_symlink() and Path(os.readlink(path)).name == name:
+            path.unlink()
+
+
 def _sync_worker_manager():
-    worker_manager.sessions_dir = SESSIONS_DIR
-    worker_manager.tmux_prefix = TMUX_PREFIX
+    worker_manager._sync_paths()
 
 # ─────────────────────────────────────────────────────────────────────────────
 # grug say: one place for backend branching. no scatter.
@@ -1696,9 +4152,9 @@ def worker_is_online(name: str, session: dict = None) -> bool:
     return worker_manager.is_online(name, session)
 
 
-def worker_set_pending(name: str, chat_id: int):
+def worker_set_pending(name: str, chat_id: int, trace_id: Optional[str] = None):
     """Set pending state for worker."""
-    set_pending(name, chat_id)
+    set_pending(name, chat_id, trace_id)
 
 
 def worker_send(name: str, message: str, chat_id: int = None, session: dict = None) -> bool:
@@ -1719,13 +4175,10 @@ def worker_send(name: str, message: str, chat_id: int = None, session: dict = No
 
 def get_tmux_env_value(tmux_name: str, key: str) -> str:
     """Get a tmux session environment variable value."""
-    result = subprocess.run(
-        ["tmux", "show-environment", "-t", tmux_name, key],
-        capture_output=True, text=True
-    )
-    if result.returncode != 0:
+    rc, out = tmux_run(["show-environment", "-t", tmux_name, key])
+    if rc != 0:
         return ""
-    value = result.stdout.strip()
+    value = out.strip()
     if "=" not in value:
         return ""
     return value.split("=", 1)[1]
@@ -1737,47 +4190,559 @@ def scan_tmux_sessions():
     return worker_manager.scan_tmux_sessions()
 
 
-def get_registered_sessions(registered=None):
+def get_registered_sessions():
     """Get registered sessions from tmux (all backends have tmux now)."""
     _sync_worker_manager()
-    return worker_manager.get_registered_sessions(registered)
+    return worker_manager.get_registered_sessions()
+
+
+SHELL_COMMANDS = {"bash", "zsh", "sh", "dash", "fish", "ksh", "tcsh", "csh"}
+CLAUDE_BYPASS_DIALOG = "Yes, I accept"  # --dangerously-skip-permissions confirmation
+BACKEND_PROMPT_RE = re.compile(r'^[\s│|>]*❯', re.MULTILINE)
+
+
+def capture_pane(tmux_name: str) -> Optional[str]:
+    """Visible pane text, or None if the pane is gone."""
+    rc, out = tmux_run(["capture-pane", "-t", tmux_name, "-p"])
+    return out if rc == 0 else None
+
+
+def wait_for_pane(tmux_name: str, ready, timeout: float, interval: float = 0.1) -> bool:
+    """Poll pane text + current command until ready(text, command) is true."""
+    deadline = time.monotonic() + timeout
+    while True:
+        text = capture_pane(tmux_name)
+        if text is not None and ready(text, get_pane_command(tmux_name)):
+            return True
+        if time.monotonic() >= deadline:
+            return False
+        time.sleep(interval)
+
+
+def pane_shell_ready(text: str, command: str) -> bool:
+    """Shell is running and has drawn its prompt."""
+    return command in SHELL_COMMANDS and bool(text.strip())
+
+
+def backend_startup_state(text: str, command: str) -> Optional[str]:
+    """'dialog' (bypass confirmation shown), 'ready' (input prompt) or None.
+
+    Only the screen below the last dialog counts, since an answered dialog
+    may stay on screen above the prompt.
+    """
+    dialog_at = text.rfind(CLAUDE_BYPASS_DIALOG)
+    after = text[dialog_at + len(CLAUDE_BYPASS_DIALOG):] if dialog_at >= 0 else text
+    # A shell prompt may use ❯ too: only trust it once the backend replaced the shell
+    if command not in SHELL_COMMANDS and BACKEND_PROMPT_RE.search(after):
+        return "ready"
+    return "dialog" if dialog_at >= 0 else None
+
+
+def wait_backend_ready(tmux_name: str, label: str, timeout: Optional[float] = None) -> bool:
+    """Drive an interactive backend to its input prompt.
+
+    Answers the bypass-permissions dialog with 2 + Enter when it shows and
+    returns True once the ❯ prompt is up. On timeout, answers the dialog
+    blindly like older builds did and returns False.
+    """
+    if timeout is None:
+        timeout = HIRE_READY_TIMEOUT * (2 if SANDBOX_ENABLED else 1)
+    started = time.monotonic()
+    answered = False
+    while time.monotonic() - started < timeout:
+        text = capture_pane(tmux_name)
+        if text is None:
+            return False  # Session is gone
+        status = backend_startup_state(text, get_pane_command(tmux_name))
+        if status == "ready":
+            print(f"Worker '{label}' ready in {time.monotonic() - started:.1f}s")
+            return True
+        if status == "dialog" and not answered:
+            tmux_run(["send-keys", "-t", tmux_name, "2"], capture=False)
+            tmux_run(["send-keys", "-t", tmux_name, "Enter"], capture=False)
+            answered = True
+        time.sleep(0.1)
+    print(f"Worker '{label}': no prompt after {timeout:.0f}s, continuing")
+    if not answered and tmux_exists(tmux_name):
+        tmux_run(["send-keys", "-t", tmux_name, "2"], capture=False)
+        tmux_run(["send-keys", "-t", tmux_name, "Enter"], capture=False)
+    return False
+
+
+PANE_STREAM = os.environ.get("PANE_STREAM", "0") == "1"  # Stream interactive panes via tmux pipe-pane
+PANE_STREAM_BYTES = int(os.environ.get("PANE_STREAM_BYTES", str(256 * 1024)))  # Ring buffer per pane
+PANE_ESCAPE_RE = re.compile(rb'\x1b\][^\x07\x1b]*(?:\x07|\x1b\\)|\x1b\[[0-9;?<>=]*[ -/]*([@-~])|\x1b[@-Z\\-_]')
+PANE_CONTROL_RE = re.compile(r'[\x00-\x08\x0b-\x1f\x7f]')
+PANE_EMPTY_PROMPT_RE = re.compile(r'^❯\s*$', re.MULTILINE)
+PANE_FALLBACK_NOTE = "\n\n⚠️ May be incomplete. Retry if needed."
+
+
+def pane_text(raw: bytes) -> str:
+    """Terminal output as plain lines.
+
+    Not a terminal emulator: colours vanish, a cursor-forward becomes a space
+    and any other cursor or erase sequence ends the line. Redrawn frames (the
+    CLI repaints its prompt box in place) therefore follow each other, the
+    latest last.
+    """
+    def sub(m):
+        final = m.group(1)
+        if final is None or final == b"m":
+            return b""  # OSC, SGR and two-byte escapes
+        return b" " if final == b"C" else b"\n"
+    text = PANE_ESCAPE_RE.sub(sub, raw).decode("utf-8", errors="replace")
+    text = text.replace("\r\n", "\n").replace("\r", "\n")
+    return PANE_CONTROL_RE.sub("", text)
+
+
+def prompt_accepted(text: str) -> bool:
+    """The last ❯ prompt line in the text is empty."""
+    prompts = re.findall(r'^❯.*$', text, re.MULTILINE)
+    return bool(prompts) and not prompts[-1][1:].strip()
+
+
+def extract_pane_response(text: str) -> str:
+    """Last ● response block from pane text (port of the Stop hook's awk).
+
+    Used when the transcript has no reply yet. Skips status lines and the
+    feedback prompt; falls back to the previous response if the current one
+    is the feedback prompt.
+    """
+    feedback = "How is Claude doing this session"
+    status_words = ("stop hook", "Whirring", "Herding", "Mulling", "Recombobulating", "Cooked for", "Saut")
+    response, last_response, in_response = "", "", False
+    for line in text.split("\n"):
+        if re.match(r'^\s*● ', line):
+            in_response = True
+            response = re.sub(r'^\s*● *', "", line)
+            continue
+        if re.match(r'^\s*❯', line) or re.match(r'^\s*───', line):
+            if in_response and response and feedback not in response:
+                last_response = response
+            in_response, response = False, ""
+        if not in_response:
+            continue
+        if re.match(r'^[·✶✻⏵⎿]', line) or any(word in line for word in status_words):
+            continue
+        if re.match(r'^[a-z]+:$', line) or "Tip:" in line:
+            continue
+        line = re.sub(r'^\s{1,2}', "", line)
+        response = f"{response}\n{line}" if response else line
+    if response and feedback not in response:
+        return response
+    return last_response
+
+
+class _PaneStream:
+    __slots__ = ("name", "tmux_name", "fifo", "read_fd", "write_fd", "buffer", "total", "mark")
+
+    def __init__(self, name, tmux_name, fifo, read_fd, write_fd):
+        self.name, self.tmux_name, self.fifo = name, tmux_name, fifo
+        self.read_fd, self.write_fd = read_fd, write_fd
+        self.buffer = bytearray()
+        self.total = 0  # Bytes ever received (offset of the buffer's end)
+        self.mark = 0  # Offset when the last message was sent
+
+
+class PaneStreams:
+    """Push-based pane output (PANE_STREAM=1).
+
+    Each interactive worker's pane is piped (`tmux pipe-pane`) into a FIFO in
+    its session dir on the first send. One selector thread reads every FIFO
+    into a bounded ring buffer and wakes waiters, so prompt-acceptance checks
+    block on new output instead of polling capture-pane, and the Stop hook's
+    fallback is answered from the buffer without tmux or awk. Streams are
+    keyed by tmux name; a pool claim renames the session before the first
+    send, so the key is final when the pipe opens.
+    """
+
+    def __init__(self, max_bytes: int = PANE_STREAM_BYTES):
+        self.max_bytes = max_bytes
+        self._streams: Dict[str, _PaneStream] = {}
+        self._selector = selectors.DefaultSelector()
+        self._cond = threading.Condition()
+        self._thread: Optional[threading.Thread] = None
+
+    def attached(self, tmux_name: str) -> bool:
+        with self._cond:
+            return tmux_name in self._streams
+
+    def count(self) -> int:
+        with self._cond:
+            return len(self._streams)
+
+    def attach(self, name: str, tmux_name: str) -> bool:
+        """Pipe the pane into this worker's FIFO (no-op if already piped)."""
+        if self.attached(tmux_name):
+            return True
+        fifo = ensure_session_dir(name) / "pane.fifo"
+        try:
+            fifo.unlink(missing_ok=True)
+            os.mkfifo(fifo, 0o600)
+            read_fd = os.open(str(fifo), os.O_RDONLY | os.O_NONBLOCK)
+            # Held open so the FIFO never reports EOF between pipe-pane runs
+            write_fd = os.open(str(fifo), os.O_WRONLY | os.O_NONBLOCK)
+        except OSError as e:
+            print(f"Pane stream for '{name}' unavailable: {e}")
+            return False
+        stream = _PaneStream(name, tmux_name, fifo, read_fd, write_fd)
+        # Replaces any pipe left by a previous bridge run
+        if tmux_run(["pipe-pane", "-t", tmux_name, f"cat >> {shlex.quote(str(fifo))}"])[0] != 0:
+            self._close(stream)
+            return False
+        with self._cond:
+            self._streams[tmux_name] = stream
+            self._selector.register(read_fd, selectors.EVENT_READ, stream)
+            if self._thread is None or not self._thread.is_alive():
+                self._thread = threading.Thread(target=self._loop, daemon=True, name="pane-stream")
+                self._thread.start()
+        return True
+
+    def detach(self, tmux_name: str):
+        with self._cond:
+            stream = self._streams.pop(tmux_name, None)
+            if stream is not None:
+                self._selector.unregister(stream.read_fd)
+        if stream is not None:
+            tmux_run(["pipe-pane", "-t", tmux_name])  # No command closes the pipe
+            self._close(stream)
+
+    @staticmethod
+    def _close(stream: _PaneStream):
+        for fd in (stream.read_fd, stream.write_fd):
+            try:
+                os.close(fd)
+            except OSError:
+                pass
+        try:
+            stream.fifo.unlink(missing_ok=True)
+        except OSError:
+            pass
+
+    def _loop(self):
+        while True:
+            with self._cond:
+                if not self._streams:
+                    self._thread = None
+                    return
+            for key, _ in self._selector.select(timeout=0.5):
+                stream = key.data
+                try:
+                    data = os.read(stream.read_fd, 65536)
+                except (BlockingIOError, OSError):
+                    continue
+                with self._cond:
+                    stream.buffer += data
+                    if len(stream.buffer) > self.max_bytes:
+                        del stream.buffer[:len(stream.buffer) - self.max_bytes]
+                    stream.total += len(data)
+                    self._cond.notify_all()
+
+    def mark(self, tmux_name: str):
+        """Remember where the output stood before a send."""
+        with self._cond:
+            stream = self._streams.get(tmux_name)
+            if stream is not None:
+                stream.mark = stream.total
+
+    def text(self, tmux_name: str, since_mark: bool = False) -> Optional[str]:
+        """Buffered output as plain text (since the last mark if asked), or None."""
+        with self._cond:
+            stream = self._streams.get(tmux_name)
+            if stream is None:
+                return None
+            keep = stream.total - stream.mark if since_mark else len(stream.buffer)
+            raw = bytes(stream.buffer[-keep:]) if keep > 0 else b""
+        return pane_text(raw)
+
+    def wait(self, tmux_name: str, ready, timeout: float) -> Optional[bool]:
+        """Block until ready(text since mark) holds; None if not attached or nothing arrived."""
+        deadline = time.monotonic() + timeout
+        with self._cond:
+            stream = self._streams.get(tmux_name)
+            if stream is None:
+                return None
+            while True:
+                keep = stream.total - stream.mark
+                if keep > 0 and ready(pane_text(bytes(stream.buffer[-keep:]))):
+                    return True
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return False if keep > 0 else None
+                self._cond.wait(remaining)
+
+
+pane_streams = PaneStreams()
+
+
+def pane_fallback_response(name: str, tmux_name: str) -> str:
+    """Stop-hook fallback: the last response on screen, as Telegram HTML.
+
+    Reads the pane stream when one is attached, else 500 lines of scrollback
+    with one capture-pane. Empty string if no response block is found.
+    """
+    text = pane_streams.text(tmux_name)
+    if text is None:
+        rc, out = tmux_run(["capture-pane", "-t", tmux_name, "-p", "-S", "-500"])
+        text = out if rc == 0 else ""
+    response = extract_pane_response(text)
+    if not response:
+        return ""
+    return telegram_html.markdown_to_html(response + PANE_FALLBACK_NOTE)
 
 
 def tmux_prompt_empty(tmux_name, timeout=0.5):
     """Check if Claude Code's input prompt is empty (message was accepted).
 
-    After sending a message, polls the tmux pane to verify the prompt
-    line (❯) is empty, indicating Claude accepted the input.
+    With a pane stream, waits for output after the send whose last prompt
+    line (❯) is empty. Otherwise, or if the stream stayed silent, polls the
+    tmux pane. Output the stream could not read as an empty prompt (a redraw
+    the escape parser misses) gets one capture-pane check before False.
 
     Returns True if prompt is empty within timeout, False otherwise.
     """
-    import re
+    streamed = pane_streams.wait(tmux_name, prompt_accepted, timeout)
+    if streamed:
+        return True
+    if streamed is False:
+        rc, out = tmux_run(["capture-pane", "-t", tmux_name, "-p"])
+        return rc == 0 and bool(PANE_EMPTY_PROMPT_RE.search(out))
     start = time.time()
     while time.time() - start < timeout:
-        result = subprocess.run(
-            ["tmux", "capture-pane", "-t", tmux_name, "-p"],
-            capture_output=True, text=True
-        )
-        if result.returncode == 0:
+        rc, out = tmux_run(["capture-pane", "-t", tmux_name, "-p"])
+        if rc == 0:
             # Check for empty prompt: line starting with ❯ followed by only whitespace
-            if re.search(r'^❯\s*$', result.stdout, re.MULTILINE):
+            if PANE_EMPTY_PROMPT_RE.search(out):
                 return True
         time.sleep(0.1)
     return False
 
 
+HOOK_AGENT = os.environ.get("HOOK_AGENT", "0") == "1"  # Resident Stop-hook agent per node
+HOOK_AGENT_SCRIPT = Path(__file__).resolve().parent / "hooks" / "hook-agent.py"
+ADAPTER_AGENT = os.environ.get("ADAPTER_AGENT", "0") == "1"  # Resident adapter per non-interactive worker
+ADAPTER_AGENT_SCRIPT = Path(__file__).resolve().parent / "hooks" / "adapter-agent.py"
+
+
+class SocketAgentProcess:
+    """A helper script the bridge keeps running next to it on a Unix socket.
+
+    Subclasses give the socket path, the command line and a label; the agent
+    exits on its own when the bridge (its parent) goes away.
+    """
+
+    label = "Agent"
+    fallback = "using the full path"
+
+    def __init__(self):
+        self.proc: Optional[subprocess.Popen] = None
+        self._socket_ino: Optional[int] = None
+
+    @property
+    def socket_path(self) -> Path:
+        raise NotImplementedError
+
+    @property
+    def script(self) -> Path:
+        raise NotImplementedError
+
+    def command(self) -> list:
+        raise NotImplementedError
+
+    def running(self) -> bool:
+        return self.proc is not None and self.proc.poll() is None and self.socket_path.exists()
+
+    def start(self, timeout: float = 5.0) -> bool:
+        if self.running():
+            return True
+        if not self.script.exists():
+            print(f"{self.label}: {self.script} not found, {self.fallback}")
+            return False
+        self.socket_path.parent.mkdir(parents=True, exist_ok=True, mode=0o700)
+        self.proc = subprocess.Popen(self.command())
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            if self.running():
+                try:
+                    self._socket_ino = self.socket_path.stat().st_ino
+                except OSError:
+                    self._socket_ino = None
+                return True
+            if self.proc.poll() is not None:
+                break
+            time.sleep(0.05)
+        print(f"{self.label}: failed to start, {self.fallback}")
+        self.stop()
+        return False
+
+    def stop(self, timeout: float = 2.0):
+        """SIGTERM, then kill after `timeout` seconds (the agent flushes queued replies first)."""
+        if self.proc is not None and self.proc.poll() is None:
+            self.proc.terminate()
+            try:
+                self.proc.wait(timeout=timeout)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+        self.proc = None
+        try:
+            # After a hot restart the path may already be the new bridge's agent
+            if self._socket_ino is None or self.socket_path.stat().st_ino == self._socket_ino:
+                self.socket_path.unlink()
+        except FileNotFoundError:
+            pass
+        self._socket_ino = None
+
+
+class HookAgentProcess(SocketAgentProcess):
+    """Runs hooks/hook-agent.py next to the bridge, listening on a Unix socket.
+
+    Workers get HOOK_AGENT_SOCKET in their env; their Stop hook then hands the
+    event over with one curl instead of spawning tmux/jq/awk/python3 per turn.
+    The agent gets this node's SESSIONS_DIR, TMUX_PREFIX and /response URL on
+    its command line and exits when the bridge does. Hooks fall back to the
+    full path whenever the socket is missing.
+    """
+
+    label = "Hook agent"
+    fallback = "hooks use the full path"
+
+    @property
+    def socket_path(self) -> Path:
+        return SESSIONS_DIR.parent / "hook-agent.sock"
+
+    @property
+    def script(self) -> Path:
+        return HOOK_AGENT_SCRIPT
+
+    def command(self) -> list:
+        return [
+            sys.executable, str(HOOK_AGENT_SCRIPT), str(self.socket_path),
+            str(SESSIONS_DIR), TMUX_PREFIX, f"http://localhost:{PORT}/response",
+        ]
+
+
+class _UnixHTTPConnection(http.client.HTTPConnection):
+    """http.client over a Unix socket (no timeout: a turn runs as long as the CLI)."""
+
+    def __init__(self, path: str):
+        super().__init__("localhost", timeout=None)
+        self.unix_path = path
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.connect(self.unix_path)
+        self.sock = sock
+
+
+class AdapterAgentProcess(SocketAgentProcess):
+    """Resident hooks/adapter-agent.py for one non-interactive worker.
+
+    Loads the backend's adapter once; each queued turn is one POST /run over
+    <session_dir>/adapter.sock instead of a cold `python3 <adapter>.py`.
+    """
+
+    label = "Adapter agent"
+    fallback = "using a cold adapter per message"
+
+    def __init__(self, name: str, backend: str, bridge_url: str, sessions_dir: Path):
+        super().__init__()
+        self.name = name
+        self.backend = backend
+        self.bridge_url = bridge_url
+        self.sessions_dir = Path(sessions_dir)
+
+    @property
+    def socket_path(self) -> Path:
+        return self.sessions_dir / self.name / "adapter.sock"
+
+    @property
+    def script(self) -> Path:
+        return ADAPTER_AGENT_SCRIPT
+
+    def command(self) -> list:
+        return [
+            sys.executable, str(ADAPTER_AGENT_SCRIPT), str(self.socket_path),
+            self.backend, self.name, self.bridge_url, str(self.sessions_dir),
+        ]
+
+    def run(self, prompt: str) -> bool:
+        """Run one turn in the agent. False only if the prompt never reached it."""
+        conn = _UnixHTTPConnection(str(self.socket_path))
+        try:
+            conn.connect()
+        except OSError as e:
+            print(f"Adapter agent for '{self.name}' unreachable: {e}")
+            conn.close()
+            return False
+        try:
+            conn.request("POST", "/run", body=prompt.encode("utf-8"),
+                         headers={"Content-Type": "text/plain; charset=utf-8"})
+            response = conn.getresponse()
+            response.read()
+            if response.status != 200:
+                print(f"Adapter agent run for '{self.name}' failed: HTTP {response.status}")
+        except Exception as e:
+            # The turn may have run already: never fall back to a second run
+            print(f"Adapter agent run for '{self.name}' failed: {e}")
+        finally:
+            conn.close()
+        return True
+
+
+class AdapterAgents:
+    """One AdapterAgentProcess per worker, started on first use."""
+
+    def __init__(self):
+        self._agents: Dict[str, AdapterAgentProcess] = {}
+        self._lock = threading.Lock()
+
+    def get(self, name: str, backend: str, bridge_url: str, sessions_dir: Path) -> Optional[AdapterAgentProcess]:
+        with self._lock:
+            agent = self._agents.get(name)
+            if agent is None or agent.backend != backend or agent.sessions_dir != Path(sessions_dir):
+                if agent is not None:
+                    agent.stop()
+                agent = self._agents[name] = AdapterAgentProcess(name, backend, bridge_url, sessions_dir)
+            return agent if agent.start() else None
+
+    def stop(self, name: str):
+        with self._lock:
+            agent = self._agents.pop(name, None)
+        if agent is not None:
+            agent.stop()
+
+    def stop_all(self):
+        with self._lock:
+            agents, self._agents = list(self._agents.values()), {}
+        for agent in agents:
+            agent.stop()
+
+
+adapter_agents = AdapterAgents()
+
+
+hook_agent = HookAgentProcess()
+
+
 def export_hook_env(tmux_name, backend: str = DEFAULT_WORKER_BACKEND):
     """Export env vars for hook inside tmux session.
 
     Uses tmux set-environment which persists in session and survives restarts.
     Hook reads these via `tmux show-environment -t $SESSION_NAME`.
     """
-    subprocess.run(["tmux", "set-environment", "-t", tmux_name, "PORT", str(PORT)])
-    subprocess.run(["tmux", "set-environment", "-t", tmux_name, "TMUX_PREFIX", TMUX_PREFIX])
-    subprocess.run(["tmux", "set-environment", "-t", tmux_name, "SESSIONS_DIR", str(SESSIONS_DIR)])
-    subprocess.run(["tmux", "set-environment", "-t", tmux_name, "WORKER_BACKEND", normalize_backend(backend)])
-    # Always export BRIDGE_URL so workers know where their bridge is
-    subprocess.run(["tmux", "set-environment", "-t", tmux_name, "BRIDGE_URL", BRIDGE_URL])
+    env = [
+        ("PORT", str(PORT)),
+        ("TMUX_PREFIX", TMUX_PREFIX),
+        ("SESSIONS_DIR", str(SESSIONS_DIR)),
+        ("WORKER_BACKEND", normalize_backend(backend)),
+        # Always export BRIDGE_URL so workers know where their bridge is
+        ("BRIDGE_URL", BRIDGE_URL),
+    ]
+    if hook_agent.running():
+        env.append(("HOOK_AGENT_SOCKET", str(hook_agent.socket_path)))
+    if PANE_STREAM:
+        env.append(("PANE_STREAM", "1"))  # Stop hook asks the bridge for its fallback
+    tmux_run_many([["set-environment", "-t", tmux_name, key, value] for key, value in env])
 
 
 def get_docker_run_cmd(name):
@@ -1792,9 +4757,7 @@ def get_docker_run_cmd(name):
     Returns:
         Command string to run in tmux
     """
-    import platform
     container_name = f"claude-worker-{name}"
-    home = Path.home()
 
     # Base command
     cmd_parts = [
@@ -1802,6 +4765,22 @@ def get_docker_run_cmd(name):
         f"--name={container_name}",
         "--rm",  # Clean up on exit
     ]
+    cmd_parts.extend(docker_container_args(name))
+
+    # Image
+    cmd_parts.append(SANDBOX_IMAGE)
+
+    # Run claude with --dangerously-skip-permissions (same as non-sandbox)
+    cmd_parts.append("claude --dangerously-skip-permissions")
+
+    return " ".join(cmd_parts)
+
+
+def docker_container_args(name):
+    """Host gateway, mounts, hook env and workdir for a worker's container."""
+    import platform
+    home = Path.home()
+    cmd_parts = []
 
     # Host gateway for bridge communication
     if platform.system() == "Linux":
@@ -1838,17 +4817,12 @@ def get_docker_run_cmd(name):
         f"-e=BRIDGE_SESSION={name}",  # Session name for hook (tmux unavailable inside container)
         "-e=TMUX_FALLBACK=1",
     ])
+    if PANE_STREAM:
+        cmd_parts.append("-e=PANE_STREAM=1")  # No tmux in the container: the bridge answers the fallback
 
     # Working directory
     cmd_parts.extend(["-w", "/workspace"])
-
-    # Image
-    cmd_parts.append(SANDBOX_IMAGE)
-
-    # Run claude with --dangerously-skip-permissions (same as non-sandbox)
-    cmd_parts.append("claude --dangerously-skip-permissions")
-
-    return " ".join(cmd_parts)
+    return cmd_parts
 
 
 def stop_docker_container(name):
@@ -1856,6 +4830,208 @@ def stop_docker_container(name):
     container_name = f"claude-worker-{name}"
     subprocess.run(["docker", "stop", container_name], capture_output=True)
     subprocess.run(["docker", "rm", "-f", container_name], capture_output=True)
+    sandbox.forget(name)
+
+
+class SandboxContainers:
+    """Keeps one container per sandboxed worker and reuses it.
+
+    With SANDBOX_REUSE=1 the container is created once (docker create +
+    start, idling on `sleep infinity`) and the CLI runs in it through
+    `docker exec -it`. /relaunch then only starts a stopped container and
+    execs a new CLI, with no create, mount setup or layer work. SANDBOX_REUSE=0
+    keeps the old `docker run --rm` per start. With SANDBOX_PAUSE_IDLE set,
+    containers of workers with nothing pending are `docker pause`d after that
+    many idle seconds and unpaused before the next message. Each container is
+    labelled with a hash of its image and create args; one created with
+    other mounts, env or image is removed and created again.
+    """
+
+    CONFIG_LABEL = "claudecode-telegram.config"
+
+    def __init__(self, pause_idle: float = SANDBOX_PAUSE_IDLE):
+        self.pause_idle = pause_idle
+        self._last_active: Dict[str, float] = {}
+        self._paused = set()
+        self._started = time.monotonic()
+        self._lock = threading.Lock()
+        self.stats = {"created": 0, "recreated": 0, "started": 0, "reused": 0, "paused": 0, "unpaused": 0}
+
+    @staticmethod
+    def container_name(name: str) -> str:
+        return f"claude-worker-{name}"
+
+    @staticmethod
+    def config_hash(args: list) -> str:
+        return hashlib.sha256("\0".join([SANDBOX_IMAGE, *args]).encode()).hexdigest()[:16]
+
+    def _inspect(self, name: str) -> Optional[tuple]:
+        """(docker state, config label) or None if the container is missing."""
+        fmt = '{{.State.Status}} {{index .Config.Labels "%s"}}' % self.CONFIG_LABEL
+        result = subprocess.run(["docker", "inspect", "-f", fmt, self.container_name(name)],
+                                capture_output=True, text=True)
+        if result.returncode != 0:
+            return None
+        status, _, label = result.stdout.strip().partition(" ")
+        return status, label.strip()
+
+    def status(self, name: str) -> Optional[str]:
+        """Docker state (running, paused, exited, created) or None if missing."""
+        found = self._inspect(name)
+        return found[0] if found else None
+
+    def _docker(self, *args) -> bool:
+        result = subprocess.run(["docker", *args], capture_output=True, text=True)
+        if result.returncode != 0:
+            print(f"Sandbox: docker {args[0]} failed: {(result.stderr or '').strip()[:200]}")
+        return result.returncode == 0
+
+    def ensure(self, name: str) -> bool:
+        """Make the worker's container exist and run (create only the first time)."""
+        container = self.container_name(name)
+        args = docker_container_args(name)
+        config = self.config_hash(args)
+        found = self._inspect(name)
+        status = found[0] if found else None
+        if found and found[1] != config:
+            print(f"Sandbox: '{name}' container was created with other settings, recreating")
+            if not self._docker("rm", "-f", container):
+                return False
+            self.stats["recreated"] += 1
+            status = None
+        if status is None:
+            if not self._docker("create", f"--name={container}", f"--label={self.CONFIG_LABEL}={config}", *args,
+                                SANDBOX_IMAGE, "sleep", "infinity"):
+                return False
+            self.stats["created"] += 1
+            status = "created"
+        if status == "paused":
+            if not self._docker("unpause", container):
+                return False
+            self.stats["unpaused"] += 1
+        elif status != "running":
+            if not self._docker("start", container):
+                return False
+            self.stats["started"] += 1
+        else:
+            self.stats["reused"] += 1
+        with self._lock:
+            self._paused.discard(name)
+            self._last_active[name] = time.monotonic()
+        return True
+
+    def start_cmd(self, name: str) -> str:
+        """Command typed into the worker's tmux pane to start the CLI."""
+        if SANDBOX_REUSE and self.ensure(name):
+            return f"docker exec -it -w /workspace {self.container_name(name)} claude --dangerously-skip-permissions"
+        return get_docker_run_cmd(name)
+
+    def rename(self, old: str, new: str):
+        """Pool claim: the slot's container becomes the worker's."""
+        subprocess.run(["docker", "rename", self.container_name(old), self.container_name(new)], capture_output=True)
+        with self._lock:
+            self._last_active[new] = self._last_active.pop(old, time.monotonic())
+
+    def forget(self, name: str):
+        with self._lock:
+            self._last_active.pop(name, None)
+            self._paused.discard(name)
+
+    def touch(self, name: str):
+        """Mark activity; unpause first if the idle loop paused it."""
+        with self._lock:
+            self._last_active[name] = time.monotonic()
+            paused = name in self._paused
+            self._paused.discard(name)
+        if paused and self._docker("unpause", self.container_name(name)):
+            self.stats["unpaused"] += 1
+            print(f"Sandbox: unpaused '{name}'")
+
+    def pause_idle_workers(self, names):
+        """Pause containers of the given workers idle past pause_idle."""
+        now = time.monotonic()
+        for name in names:
+            with self._lock:
+                last = self._last_active.get(name, self._started)
+                idle = now - last
+                if name in self._paused or idle < self.pause_idle:
+                    continue
+            if is_pending(name) or self.status(name) != "running":
+                continue
+            if not self._docker("pause", self.container_name(name)):
+                continue
+            with self._lock:
+                touched = self._last_active.get(name, self._started) != last
+                if not touched:
+                    self._paused.add(name)
+            if touched:
+                # A message came in while pausing; its touch() saw nothing to unpause
+                if self._docker("unpause", self.container_name(name)):
+                    self.stats["unpaused"] += 1
+                continue
+            self.stats["paused"] += 1
+            print(f"Sandbox: paused '{name}' after {int(idle)}s idle")
+
+    def _pause_loop(self):
+        interval = max(1.0, min(30.0, self.pause_idle / 2))
+        while True:
+            time.sleep(interval)
+            try:
+                registered = get_registered_sessions()
+                names = [n for n, info in registered.items() if get_backend(get_worker_backend(n, info)).is_interactive]
+                self.pause_idle_workers(names)
+            except Exception as e:
+                print(f"Sandbox: idle pause check failed: {e}")
+
+    def prefetch_image(self) -> bool:
+        """Verify SANDBOX_IMAGE is present, pulling it if not (first hire skips the pull)."""
+        if subprocess.run(["docker", "image", "inspect", SANDBOX_IMAGE], capture_output=True).returncode == 0:
+            print(f"Sandbox image ready: {SANDBOX_IMAGE}")
+            return True
+        print(f"Sandbox image {SANDBOX_IMAGE} not found locally, pulling...")
+        if self._docker("pull", SANDBOX_IMAGE):
+            print(f"Sandbox image pulled: {SANDBOX_IMAGE}")
+            return True
+        print(f"Sandbox image {SANDBOX_IMAGE} unavailable: workers cannot start until it is built or pulled")
+        return False
+
+    def adopt_paused(self) -> int:
+        """Take over worker containers an earlier bridge process left paused.
+
+        The paused set lives in memory, so after a restart touch() would not
+        unpause them and those workers would never answer. With idle pausing
+        on they are tracked again (unpaused by the next message); with it off
+        they are unpaused now. Returns how many were found.
+        """
+        prefix = self.container_name("")
+        try:
+            result = subprocess.run(["docker", "ps", "-a", "--filter", "status=paused", "--filter", f"name=^{prefix}",
+                                     "--format", "{{.Names}}"], capture_output=True, text=True)
+        except OSError as e:
+            print(f"Sandbox: cannot list paused containers: {e}")
+            return 0
+        if result.returncode != 0:
+            return 0
+        names = [c[len(prefix):] for c in result.stdout.split() if c.startswith(prefix)]
+        for name in names:
+            if self.pause_idle > 0:
+                with self._lock:
+                    self._paused.add(name)
+            elif self._docker("unpause", self.container_name(name)):
+                self.stats["unpaused"] += 1
+        if names:
+            print(f"Sandbox: found {len(names)} paused container(s) from an earlier run: {', '.join(names)}")
+        return len(names)
+
+    def start(self):
+        """Adopt paused containers, then prefetch the image and start the idle pause loop (background)."""
+        self.adopt_paused()
+        threading.Thread(target=self.prefetch_image, daemon=True, name="sandbox-prefetch").start()
+        if self.pause_idle > 0:
+            threading.Thread(target=self._pause_loop, daemon=True, name="sandbox-pause").start()
+
+
+sandbox = SandboxContainers()
 
 
 def send_to_worker(name: str, message: str, chat_id: Optional[int] = None) -> bool:
@@ -1864,19 +5040,23 @@ def send_to_worker(name: str, message: str, chat_id: Optional[int] = None) -> bo
     return worker_manager.send(name, message, chat_id)
 
 
-def send_response_to_telegram(name: str, text: str, chat_id: int, escape: bool = True, log_prefix: str = "Response"):
+def send_response_to_telegram(name: str, text: str, chat_id: int, escape: bool = True, log_prefix: str = "Response",
+                              draft: Optional["_Draft"] = None):
     """Send a response to Telegram. Shared by hook responses.
 
+    Blocking; runs on an outbound dispatcher worker (see enqueue_response).
+    Every send is rate-limited per chat and honors 429 retry_after.
+
     Args:
         name: Session/worker name for message prefix
         text: Response text (may contain image/file tags)
         chat_id: Telegram chat ID
         escape: If True, escape HTML special chars. If False, text is pre-escaped.
         log_prefix: Prefix for log messages (e.g., "Response", "Hook response")
+        draft: Closed streaming draft; its message becomes the first chunk
     """
     # Parse image and file tags from text (before escaping to preserve tag syntax)
-    clean_text, images = parse_image_tags(text)
-    clean_text, files = parse_file_tags(clean_text)
+    clean_text, images, files = parse_media_tags(text)
     if escape:
         clean_text = escape_html(clean_text)
 
@@ -1896,7 +5076,14 @@ def send_response_to_telegram(name: str, text: str, chat_id: int, escape: bool =
             if prev_msg_id:
                 msg_data["reply_to_message_id"] = prev_msg_id
 
-            result = telegram_api("sendMessage", msg_data)
+            result = None
+            if i == 0 and draft is not None and draft.message_id:
+                result = outbound.call(chat_id, "editMessageText", dict(msg_data, message_id=draft.message_id))
+                if result and result.get("ok"):
+                    draft_streamer.stats["finalized"] += 1
+                    result = {"ok": True, "result": {"message_id": draft.message_id}}
+            if not (result and result.get("ok")):
+                result = outbound.call(chat_id, "sendMessage", msg_data)
             if result and result.get("ok"):
                 prev_msg_id = result.get("result", {}).get("message_id")
                 if len(formatted_parts) > 1:
@@ -1906,30 +5093,108 @@ def send_response_to_telegram(name: str, text: str, chat_id: int, escape: bool =
             else:
                 print(f"{log_prefix} failed: {name} -> {result}")
 
-            if i < len(formatted_parts) - 1:
-                time.sleep(0.05)
+    if images or files:
+        send_media(name, chat_id, images, files)
 
-    # Send images
-    for img_path, img_caption in images:
-        full_caption = f"{name}: {img_caption}" if img_caption else f"{name}:"
-        if send_photo(chat_id, img_path, full_caption):
-            print(f"Image sent: {name} -> {img_path}")
-        else:
-            telegram_api("sendMessage", {
-                "chat_id": chat_id,
-                "text": f"{name}: [Image failed: {img_path}]"
-            })
 
-    # Send files/documents
-    for file_path, file_caption in files:
-        full_caption = f"{name}: {file_caption}" if file_caption else f"{name}:"
-        if send_document(chat_id, file_path, full_caption):
-            print(f"File sent: {name} -> {file_path}")
-        else:
-            telegram_api("sendMessage", {
-                "chat_id": chat_id,
-                "text": f"{name}: [File failed: {file_path}]"
-            })
+def send_media(name: str, chat_id: int, images: list, files: list):
+    """Send a response's images and files: albums where possible, uploads in parallel.
+
+    Valid images are grouped into sendMediaGroup photo albums and valid files
+    into document albums (Telegram doesn't mix the two), up to 10 per album.
+    All uploads of the response run concurrently via outbound.upload_many(),
+    so delivery takes about as long as the slowest upload. An album Telegram
+    rejected is retried item by item; one that got no answer is not, since it
+    may have gone out. Anything still failing gets the usual notice. For a
+    worker on another host, each tagged file is fetched from there first.
+    """
+    kinds = [
+        ("photo", "Image", images, validate_photo_path, send_photo),
+        ("document", "File", files, validate_document_path, send_document),
+    ]
+    remote = worker_hosts.remote(name)  # Tagged paths are on the worker's host
+    fetched = []
+    try:
+        _send_media(name, chat_id, kinds, remote, fetched)
+    finally:
+        for folder in fetched:
+            shutil.rmtree(folder, ignore_errors=True)
+
+
+def _send_media(name: str, chat_id: int, kinds: list, remote: Optional[dict], fetched: list):
+    uploads, batches, failed = [], [], []
+    for kind, label, tagged, validate, send_one in kinds:
+        valid = []  # (validated Path, full caption, path as tagged)
+        for path, caption in tagged:
+            local = path
+            if remote:
+                local = fetch_worker_file(name, remote, path, kind)
+                if local is None:
+                    failed.append((label, path))
+                    continue
+                fetched.append(local.parent)
+            ok, validated = validate(local)
+            if ok:
+                valid.append((validated, f"{name}: {caption}" if caption else f"{name}:", path))
+            else:
+                print(validated)
+                failed.append((label, path))
+        for batch in plan_media_batches(kind, valid):
+            batches.append((label, batch, send_one))
+            if len(batch) == 1:
+                path, caption, _ = batch[0]
+                uploads.append((f"send{kind.capitalize()}", lambda s=send_one, p=path, c=caption: s(chat_id, p, c)))
+            else:
+                items = [(path, caption) for path, caption, _ in batch]
+                uploads.append(("sendMediaGroup", lambda k=kind, i=items: send_media_group(chat_id, k, i)))
+
+    for (label, batch, send_one), ok in zip(batches, outbound.upload_many(chat_id, uploads)):
+        if ok:
+            for _, _, orig in batch:
+                print(f"{label} sent: {name} -> {orig}")
+            continue
+        # Album rejected: retry its members one by one
+        for path, caption, orig in batch:
+            if len(batch) > 1 and ok is False and outbound.send_with_retries(
+                    chat_id, f"send {label.lower()}", lambda p=path, c=caption: send_one(chat_id, p, c)):
+                print(f"{label} sent: {name} -> {orig}")
+            else:
+                failed.append((label, orig))
+
+    for label, path in failed:
+        outbound.call(chat_id, "sendMessage", {
+            "chat_id": chat_id,
+            "text": f"{name}: [{label} failed: {path}]"
+        })
+
+
+def enqueue_response(name: str, text: str, chat_id: int, escape: bool = True, log_prefix: str = "Response",
+                     trace_id: Optional[str] = None) -> bool:
+    """Queue a worker response for the outbound dispatcher.
+
+    Returns False if the outbound queue is full. Pending is cleared once the
+    response has been sent, so the typing indicator lasts until delivery,
+    unless the worker got its next message meanwhile.
+    """
+    draft = draft_streamer.finish(name)
+    backend = get_worker_backend(name)
+    received = time.monotonic()
+    pending = session_store.read(get_pending_file(name))
+    try:
+        sent_at = int(pending.strip())
+        metrics.observe("worker_turn_seconds", max(0, time.time() - sent_at), worker=name, backend=backend)
+    except (AttributeError, ValueError):
+        pass  # No message in progress (e.g. a worker-initiated reply)
+
+    def job():
+        try:
+            send_response_to_telegram(name, text, chat_id, escape=escape, log_prefix=log_prefix, draft=draft)
+        finally:
+            clear_answered_pending(name, pending, trace_id)
+            metrics.observe("response_delivery_seconds", time.monotonic() - received, worker=name, backend=backend)
+            tracer.span(trace_id, "delivered", worker=name)
+
+    return outbound.submit(chat_id, job, label=f"{log_prefix.lower()} from {name}")
 
 
 def should_escape_response(data: dict) -> bool:
@@ -1983,33 +5248,332 @@ def switch_session(name):
 # Typing indicator
 # ─────────────────────────────────────────────────────────────────────────────
 
-def send_typing_loop(chat_id, session_name):
-    """Send typing indicator while request is pending."""
-    while is_pending(session_name):
-        telegram_api("sendChatAction", {"chat_id": chat_id, "action": "typing"})
-        time.sleep(4)
+TYPING_INTERVAL = float(os.environ.get("TYPING_INTERVAL", "4"))  # Telegram shows "typing" for ~5s
+PENDING_TIMEOUT = 600  # Matches is_pending() auto-clear
+
+
+class TypingTicker:
+    """One scheduler thread for all typing indicators.
+
+    Keeps an in-memory map of pending workers -> chat_id, fed by set_pending()
+    and clear_pending(). Each tick sends at most one sendChatAction per chat,
+    no matter how many workers are busy in it. Hooks remove the pending file
+    directly when they have nothing to send, so a tick also drops workers
+    whose pending file is gone (one stat per pending worker, on one thread).
+    """
+
+    def __init__(self, interval: float = TYPING_INTERVAL):
+        self.interval = interval
+        self._pending: Dict[str, tuple] = {}  # worker -> (chat_id, started)
+        self._last_sent: Dict[str, float] = {}  # chat_id -> monotonic time of last typing
+        self._lock = threading.Lock()
+        self._wake = threading.Event()
+        self._thread = None
+        self.stats = {"ticks": 0, "sent": 0}
+
+    def add(self, name: str, chat_id):
+        """Start typing for a worker's chat (first indicator goes out right away)."""
+        key = str(chat_id)
+        with self._lock:
+            self._pending[name] = (key, time.time())
+            new_chat = key not in self._last_sent
+        self.start()
+        if new_chat:
+            self._wake.set()
+
+    def discard(self, name: str):
+        with self._lock:
+            self._pending.pop(name, None)
+
+    def pending(self) -> Dict[str, str]:
+        """Pending workers -> chat id."""
+        with self._lock:
+            return {name: chat for name, (chat, _) in self._pending.items()}
+
+    def chats(self) -> set:
+        """Chat ids with at least one pending worker."""
+        with self._lock:
+            return {chat for chat, _ in self._pending.values()}
+
+    def start(self):
+        """Start the ticker thread (idempotent)."""
+        with self._lock:
+            if self._thread and self._thread.is_alive():
+                return
+            self._thread = threading.Thread(target=self._loop, daemon=True, name="typing-ticker")
+            self._thread.start()
+
+    def _loop(self):
+        while True:
+            try:
+                self.tick()
+            except Exception as e:
+                print(f"Typing ticker error: {e}")
+            self._wake.wait(self.interval)
+            self._wake.clear()
+
+    def tick(self):
+        """Drop finished/stale workers, then send one typing action per chat that is due."""
+        now = time.time()
+        with self._lock:
+            entries = list(self._pending.items())
+        for name, (chat, started) in entries:
+            if now - started > PENDING_TIMEOUT or not get_pending_file(name).exists():
+                with self._lock:
+                    if self._pending.get(name, (None, None))[1] == started:
+                        self._pending.pop(name, None)
+
+        mono = time.monotonic()
+        due = []
+        with self._lock:
+            self.stats["ticks"] += 1
+            active = {chat for chat, _ in self._pending.values()}
+            for chat in list(self._last_sent):
+                if chat not in active:
+                    del self._last_sent[chat]
+            for chat in active:
+                # Slack so a wake-up for a new chat never double-sends to the others
+                if mono - self._last_sent.get(chat, 0.0) >= self.interval * 0.9:
+                    self._last_sent[chat] = mono
+                    due.append(chat)
+            self.stats["sent"] += len(due)
+        for chat in due:
+            telegram_api("sendChatAction", {"chat_id": chat, "action": "typing"})
+
+
+typing_ticker = TypingTicker()
+
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Streaming drafts (partial output as one live, edited message)
+# ─────────────────────────────────────────────────────────────────────────────
+
+STREAM_DRAFTS = os.environ.get("STREAM_DRAFTS", "0") == "1"  # Show partial output while a turn runs
+STREAM_EDIT_INTERVAL = float(os.environ.get("STREAM_EDIT_INTERVAL", "3"))  # Seconds between edits per draft
+DRAFT_MARKER = "…"  # Appended while the turn is still running
+
+
+class _Draft:
+    def __init__(self, chat_id: str):
+        self.chat_id = chat_id
+        self.text = ""  # Latest partial text (raw, unescaped)
+        self.shown = None  # Last rendered HTML sent to Telegram
+        self.message_id: Optional[int] = None
+        self.last_sent = 0.0  # monotonic
+        self.scheduled = False  # A flush is queued or waiting for its interval
+        self.closed = False  # Final response arrived; late partials are dropped
+
+
+def render_draft(name: str, text: str) -> str:
+    """Draft HTML: tags stripped, escaped, tail kept when over one message."""
+    clean, _, _ = parse_media_tags(text)
+    clean = clean.strip()
+    limit = TELEGRAM_MAX_LENGTH - len(name) - 30
+    body = escape_html(clean)
+    if len(body) > limit:
+        start, size = len(clean), len(DRAFT_MARKER)
+        while start > 0 and size + len(escape_html(clean[start - 1])) <= limit:
+            start -= 1
+            size += len(escape_html(clean[start]))
+        body = DRAFT_MARKER + escape_html(clean[start:])
+    return format_response_text(name, f"{body} {DRAFT_MARKER}")
+
+
+class DraftStreamer:
+    """One live draft message per busy worker, edited as partial output arrives.
+
+    Partial text comes from POST /draft (adapters) and from the Claude
+    transcript poller. The first partial is sent right away; later ones are
+    coalesced so each draft is edited at most once per STREAM_EDIT_INTERVAL.
+    Sends go through the outbound dispatcher, so they use the per-chat
+    throttle and stay ordered before the final response, which edits the
+    draft into its first chunk (see send_response_to_telegram).
+    """
+
+    def __init__(self, interval: float = STREAM_EDIT_INTERVAL):
+        self.interval = interval
+        self._drafts: Dict[str, _Draft] = {}
+        self._lock = threading.Lock()
+        self.stats = {"drafts": 0, "edits": 0, "finalized": 0}
+
+    def update(self, name: str, chat_id, text: str) -> bool:
+        """Record the turn's partial text so far. False if the turn already ended."""
+        key = str(chat_id)
+        with self._lock:
+            draft = self._drafts.get(name)
+            if draft is None or draft.chat_id != key:
+                draft = self._drafts[name] = _Draft(key)
+            if draft.closed:
+                return False
+            draft.text = text
+            if draft.scheduled:
+                return True
+            draft.scheduled = True
+            delay = draft.last_sent + self.interval - time.monotonic()
+        if delay > 0:
+            timer = threading.Timer(delay, self._submit, args=(name, draft))
+            timer.daemon = True
+            timer.start()
+        else:
+            self._submit(name, draft)
+        return True
+
+    def _submit(self, name: str, draft: _Draft):
+        if not outbound.submit(draft.chat_id, lambda: self._flush(name, draft), label=f"draft from {name}"):
+            with self._lock:
+                draft.scheduled = False
+
+    def _flush(self, name: str, draft: _Draft):
+        with self._lock:
+            draft.scheduled = False
+            if draft.closed:
+                return
+            html = render_draft(name, draft.text)
+            if html == draft.shown:
+                return
+        if draft.message_id is None:
+            result = outbound.call(draft.chat_id, "sendMessage",
+                                   {"chat_id": draft.chat_id, "text": html, "parse_mode": "HTML"})
+            if result and result.get("ok"):
+                draft.message_id = result.get("result", {}).get("message_id")
+                self.stats["drafts"] += 1
+        else:
+            result = outbound.call(draft.chat_id, "editMessageText", {
+                "chat_id": draft.chat_id, "message_id": draft.message_id, "text": html, "parse_mode": "HTML"
+            })
+            if result and result.get("ok"):
+                self.stats["edits"] += 1
+        if result and result.get("ok"):
+            draft.shown = html
+        draft.last_sent = time.monotonic()
+
+    def finish(self, name: str) -> Optional[_Draft]:
+        """Close the worker's draft; the final response job reads its message_id."""
+        with self._lock:
+            draft = self._drafts.get(name)
+            if draft is None or draft.closed:
+                return None
+            draft.closed = True
+            return draft
+
+    def reset(self, name: str):
+        """Forget a closed draft (a new turn starts)."""
+        with self._lock:
+            draft = self._drafts.get(name)
+            if draft is not None and draft.closed:
+                del self._drafts[name]
+
+
+draft_streamer = DraftStreamer()
+
+
+class TranscriptDraftPoller:
+    """Feeds drafts from Claude transcripts while their workers are pending.
+
+    Every STREAM_EDIT_INTERVAL it peeks at each pending worker's transcript
+    with transcript-tail.py's incremental reader (the offset file is read,
+    never written: the Stop hook still owns it). Text only counts once a
+    user message newer than the hook's saved one exists, so the previous
+    turn's reply is never shown as a draft. A worker's first turn has no
+    offset file yet and is not streamed.
+    """
+
+    def __init__(self, interval: float = STREAM_EDIT_INTERVAL):
+        self.interval = interval
+        self._tail = None
+        self._thread = None
+
+    def start(self) -> bool:
+        if self._thread is not None:
+            return True
+        self._tail = load_hook_module("transcript_tail", "transcript-tail.py")
+        if self._tail is None:
+            print("Draft streaming: transcript-tail.py not found, Claude drafts disabled")
+            return False
+        self._thread = threading.Thread(target=self._loop, daemon=True, name="transcript-drafts")
+        self._thread.start()
+        return True
+
+    def _loop(self):
+        while True:
+            time.sleep(self.interval)
+            try:
+                self.poll()
+            except Exception as e:
+                print(f"Transcript draft poll error: {e}")
+
+    def poll(self):
+        for name, chat_id in typing_ticker.pending().items():
+            offset_file = get_session_dir(name) / "transcript_offset"
+            try:
+                saved = json.loads(offset_file.read_text())
+            except (OSError, ValueError):
+                continue
+            path = saved.get("path") if isinstance(saved, dict) else None
+            if not path or not os.path.isfile(path):
+                continue
+            rc, text, state = self._tail.extract(path, str(offset_file))
+            if rc == 0 and state["last_user"] != saved.get("last_user"):
+                draft_streamer.update(name, chat_id, text)
+
+
+transcript_drafts = TranscriptDraftPoller()
+
+
+known_chat_ids: Dict[Path, Dict[str, str]] = {}  # SESSIONS_DIR -> {worker: chat_id} (scanned once, then kept by set_pending/end)
+known_chat_ids_lock = threading.Lock()
+
+
+def remember_chat_id(name, chat_id):
+    with known_chat_ids_lock:
+        if SESSIONS_DIR in known_chat_ids:
+            known_chat_ids[SESSIONS_DIR][name] = str(chat_id)
+
+
+def forget_chat_id(name):
+    """Drop an ended worker's chat: from the cache and from its session dir."""
+    with known_chat_ids_lock:
+        known_chat_ids.get(SESSIONS_DIR, {}).pop(name, None)
+        session_store.remove(get_chat_id_file(name))
 
 
 def get_all_chat_ids():
-    """Get all unique chat_ids from session files."""
-    chat_ids = set()
-    if SESSIONS_DIR.exists():
-        for session_dir in SESSIONS_DIR.iterdir():
-            if session_dir.is_dir():
-                chat_id_file = session_dir / "chat_id"
-                if chat_id_file.exists():
-                    try:
-                        chat_id = chat_id_file.read_text().strip()
-                        if chat_id:
-                            chat_ids.add(chat_id)
-                    except Exception:
-                        pass
+    """Get all unique chat_ids from session files.
+
+    The session dirs are scanned on the first call only; set_pending() adds
+    chat_ids after that and ending a worker drops its own.
+    """
+    with known_chat_ids_lock:
+        cached = known_chat_ids.get(SESSIONS_DIR)
+        if cached is None:
+            cached = known_chat_ids[SESSIONS_DIR] = {}
+            if SESSIONS_DIR.exists():
+                for session_dir in SESSIONS_DIR.iterdir():
+                    # Slot aliases point at a worker dir that is scanned anyway
+                    if session_dir.is_dir() and not session_dir.is_symlink():
+                        chat_id_file = session_dir / "chat_id"
+                        if chat_id_file.exists():
+                            try:
+                                chat_id = chat_id_file.read_text().strip()
+                                if chat_id:
+                                    cached[session_dir.name] = chat_id
+                            except Exception:
+                                pass
+        chat_ids = set(cached.values())
     # Also include current admin if known
     if admin_chat_id:
         chat_ids.add(str(admin_chat_id))
     return chat_ids
 
 
+def notify_all_chats(text: str) -> int:
+    """Send text to every known chat in parallel. Returns how many got it."""
+    chat_ids = sorted(get_all_chat_ids())
+    results = fan_out(lambda chat_id: telegram_api("sendMessage", {"chat_id": chat_id, "text": text}),
+                      chat_ids, BROADCAST_CONCURRENCY)
+    return sum(1 for result in results if result and result.get("ok"))
+
+
 def send_shutdown_message():
     """Send shutdown notification to all known chat_ids."""
     chat_ids = get_all_chat_ids()
@@ -2018,11 +5582,7 @@ def send_shutdown_message():
         return
 
     print(f"Sending shutdown to {len(chat_ids)} chat(s)...")
-    for chat_id in chat_ids:
-        telegram_api("sendMessage", {
-            "chat_id": chat_id,
-            "text": "Going offline briefly. Your team stays the same."
-        })
+    notify_all_chats("Going offline briefly. Your team stays the same.")
     print("Shutdown notifications sent")
 
 
@@ -2057,6 +5617,14 @@ class CommandRouter:
         self.reply(chat_id, "\n".join(lines))
 
     def handle_message(self, update):
+        msg = update.get("message", {})
+        tracer.begin(msg.get("chat", {}).get("id"), msg.get("message_id"), msg.get("date"))
+        try:
+            self._handle_message(update)
+        finally:
+            tracer.end()
+
+    def _handle_message(self, update):
         global admin_chat_id
 
         msg = update.get("message", {})
@@ -2076,8 +5644,10 @@ class CommandRouter:
             if photo:
                 largest = max(photo, key=lambda p: p.get("file_size", 0))
                 file_id = largest.get("file_id")
+                file_unique_id = largest.get("file_unique_id")
             else:
                 file_id = document.get("file_id")
+                file_unique_id = document.get("file_unique_id")
 
             if file_id:
                 if admin_chat_id is None:
@@ -2089,12 +5659,15 @@ class CommandRouter:
                     self.reply(chat_id, "Needs decision - No focused worker. Use /focus <name> first.")
                     return
 
-                local_path = download_telegram_file(file_id, state["active"])
-                if local_path:
-                    image_text = f"Manager sent image: {local_path}"
+                local_path = download_telegram_file(file_id, state["active"], file_unique_id)
+                worker_path = local_path and hand_file_to_worker(state["active"], local_path)
+                if worker_path:
+                    image_text = f"Manager sent image: {worker_path}"
                     if text:
                         image_text = f"{text}\n\n{image_text}"
                     self.route_to_active(image_text, chat_id, msg_id)
+                elif local_path:
+                    self.reply(chat_id, f"Needs decision - Could not pass the image to {state['active']}'s host. Try again.")
                 else:
                     self.reply(chat_id, "Needs decision - Could not download image. Try again or send as file.")
                 return
@@ -2111,16 +5684,19 @@ class CommandRouter:
                     self.reply(chat_id, "Needs decision - No focused worker. Use /focus <name> first.")
                     return
 
-                local_path = download_telegram_file(file_id, state["active"])
-                if local_path:
+                local_path = download_telegram_file(file_id, state["active"], document.get("file_unique_id"))
+                worker_path = local_path and hand_file_to_worker(state["active"], local_path)
+                if worker_path:
                     file_name = document.get("file_name", "unknown")
                     file_size = document.get("file_size", 0)
                     mime_type = document.get("mime_type", "unknown")
                     size_str = format_file_size(file_size)
-                    file_text = f"Manager sent file: {file_name} ({size_str}, {mime_type})\nPath: {local_path}"
+                    file_text = f"Manager sent file: {file_name} ({size_str}, {mime_type})\nPath: {worker_path}"
                     if text:
                         file_text = f"{text}\n\n{file_text}"
                     self.route_to_active(file_text, chat_id, msg_id)
+                elif local_path:
+                    self.reply(chat_id, f"Needs decision - Could not pass the file to {state['active']}'s host. Try again.")
                 else:
                     self.reply(chat_id, "Needs decision - Could not download file. Try again.")
                 return
@@ -2312,8 +5888,7 @@ class CommandRouter:
         return True
 
     def cmd_team(self, chat_id):
-        registered = self.workers.scan_tmux_sessions()
-        registered = self.workers.get_registered_sessions(registered)
+        registered = self.workers.refresh()
 
         if not registered:
             self.reply(chat_id, "No team members yet. Add someone with /hire <name>.")
@@ -2356,10 +5931,12 @@ class CommandRouter:
         ready = False
         needs_attention = None
         mode = "tmux"
+        queue = None
 
         tmux_name = session.get("tmux", f"{self.workers.tmux_prefix}{name}")
         if not backend.is_interactive:
             # Non-interactive: online = tmux exists, ready = always (stateless)
+            queue = adapter_queue.depth_of(name)
             online = tmux_exists(tmux_name)
             ready = online  # Ready if tmux exists
             mode = f"{backend_name} (non-interactive)"
@@ -2381,7 +5958,10 @@ class CommandRouter:
             online=online,
             ready=ready,
             mode=mode,
-            needs_attention=needs_attention
+            needs_attention=needs_attention,
+            transcript_wait_ms=last_transcript_wait.get(name),
+            queue=queue,
+            inbox=inbox_gc.size_of(name)
         )
 
         self.reply(chat_id, "\n".join(status))
@@ -2399,6 +5979,7 @@ class CommandRouter:
             backend_name = get_worker_backend(name, session)
             backend = get_backend(backend_name)
             if not backend.is_interactive:
+                adapter_queue.discard(name)
                 clear_pending(name)
                 self.reply(chat_id, f"{name.capitalize()} is paused. I'll pick up where we left off.")
                 return True
@@ -2501,11 +6082,6 @@ class CommandRouter:
             return True
 
         worker_set_pending(name, chat_id)
-        threading.Thread(
-            target=send_typing_loop,
-            args=(chat_id, name),
-            daemon=True
-        ).start()
 
         send_ok = self.workers.send(name, prompt, chat_id, session)
         if not send_ok:
@@ -2533,21 +6109,66 @@ class CommandRouter:
         self.route_message(state["active"], text, chat_id, msg_id, one_off=False)
 
     def route_to_all(self, text, chat_id, msg_id):
+        """Broadcast to every online worker in parallel, then one summary reply.
+
+        Uses one registry snapshot; at most BROADCAST_CONCURRENCY workers are
+        sent to (and checked for acceptance) at once.
+        """
         registered = self.workers.get_registered_sessions()
         sessions = list(registered.keys())
         if not sessions:
             self.reply(chat_id, "No team members yet. Add someone with /hire <name>.")
             return
 
-        sent_to = []
-        for name in sessions:
+        trace_id = tracer.current()
+        # Stores the trace from this thread: fan_out threads only append to it
+        tracer.span(trace_id, "broadcast", workers=len(sessions))
+
+        def deliver(name):
             session = registered[name]
-            if self.workers.is_online(name, session):
-                self.route_message(name, text, chat_id, msg_id, one_off=True)
-                sent_to.append(name)
+            if not self.workers.is_online(name, session):
+                return None
+            return self.deliver_to_worker(name, session, text, chat_id, trace_id, check_accepted=bool(msg_id))
 
-        if not sent_to:
+        results = dict(zip(sessions, fan_out(deliver, sessions, BROADCAST_CONCURRENCY)))
+        reached = [name for name, result in results.items() if result is not None]
+        if not reached:
             self.reply(chat_id, "No one's online to share with.")
+            return
+
+        failed = [(name, results[name][0]) for name in reached if results[name][0]]
+        if msg_id and any(results[name][1] for name in reached):
+            self.telegram.set_reaction(chat_id, msg_id, [{"type": "emoji", "emoji": "👀"}])
+        if failed:
+            shared = [name for name in reached if not results[name][0]]
+            lines = [f"Shared with {', '.join(shared)}." if shared else "Could not share with anyone."]
+            lines.extend(error for _, error in failed)
+            self.reply(chat_id, "\n".join(lines), outcome="Needs decision")
+        elif len(reached) > 1:
+            self.reply(chat_id, f"Shared with {', '.join(reached)}.")
+
+    def deliver_to_worker(self, session_name, session, text, chat_id, trace_id=None, check_accepted=True):
+        """Mark pending and send. Returns (error reply or None, prompt accepted)."""
+        backend_name = get_worker_backend(session_name, session)
+        backend = get_backend(backend_name)
+
+        print(f"[{chat_id}] -> {session_name}: {text[:50]}...")
+
+        tracer.span(trace_id, "routed", worker=session_name, backend=backend_name)
+        worker_set_pending(session_name, chat_id, trace_id)
+
+        send_ok = self.workers.send(session_name, text, chat_id, session)
+        tracer.span(trace_id, "sent", worker=session_name, ok=send_ok)
+        if not send_ok:
+            if not backend.is_interactive and adapter_queue.is_full(session_name):
+                return (f"{session_name.capitalize()} has {adapter_queue.depth} messages waiting. "
+                        "Try again when they catch up."), False
+            clear_pending(session_name)
+            return f"Could not send to {session_name.capitalize()}. Try /relaunch.", False
+
+        if not check_accepted:
+            return None, False
+        return None, not backend.is_interactive or tmux_prompt_empty(session.get("tmux", ""))
 
     def route_message(self, session_name, text, chat_id, msg_id, one_off=False):
         registered = self.workers.get_registered_sessions()
@@ -2560,40 +6181,249 @@ class CommandRouter:
             self.reply(chat_id, f"{session_name.capitalize()} is offline. Try /relaunch.")
             return
 
-        backend_name = get_worker_backend(session_name, session)
-        backend = get_backend(backend_name)
+        error, accepted = self.deliver_to_worker(session_name, session, text, chat_id, tracer.current(),
+                                                 check_accepted=bool(msg_id))
+        if error:
+            self.reply(chat_id, error, outcome="Needs decision")
+            return
 
-        print(f"[{chat_id}] -> {session_name}: {text[:50]}...")
+        if msg_id and accepted:
+            self.telegram.set_reaction(chat_id, msg_id, [{"type": "emoji", "emoji": "👀"}])
 
-        worker_set_pending(session_name, chat_id)
-        threading.Thread(
-            target=send_typing_loop,
-            args=(chat_id, session_name),
-            daemon=True
-        ).start()
 
-        send_ok = self.workers.send(session_name, text, chat_id, session)
-        if not send_ok:
-            clear_pending(session_name)
-            self.reply(
-                chat_id,
-                f"Could not send to {session_name.capitalize()}. Try /relaunch.",
-                outcome="Needs decision"
-            )
-            return
+command_router = CommandRouter(telegram, worker_manager)
 
-        if msg_id and send_ok:
-            if not backend.is_interactive or tmux_prompt_empty(session.get("tmux", "")):
-                self.telegram.set_reaction(chat_id, msg_id, [{"type": "emoji", "emoji": "👀"}])
 
+# ─────────────────────────────────────────────────────────────────────────────
+# Inbound updates (ack first, then a bounded per-chat ordered pool)
+# ─────────────────────────────────────────────────────────────────────────────
 
-command_router = CommandRouter(telegram, worker_manager)
+UPDATE_WORKERS = int(os.environ.get("UPDATE_WORKERS", "4"))
+UPDATE_QUEUE_SIZE = int(os.environ.get("UPDATE_QUEUE_SIZE", "200"))
+UPDATE_DEDUPE_SIZE = int(os.environ.get("UPDATE_DEDUPE_SIZE", "1000"))  # Recent update_ids remembered
+
+
+def update_chat_id(update: dict):
+    """Chat an update belongs to (None for updates without one)."""
+    for key in ("message", "edited_message", "channel_post", "edited_channel_post"):
+        if key in update:
+            return update[key].get("chat", {}).get("id")
+    if "callback_query" in update:
+        return update["callback_query"].get("message", {}).get("chat", {}).get("id")
+    return None
+
+
+class UpdateDispatcher(ChatOrderedQueue):
+    """Runs Telegram updates off the webhook request.
+
+    The webhook is answered as soon as the update is queued, so a slow
+    /hire or tmux call never makes Telegram time out and redeliver. Updates
+    of one chat are handled in arrival order; other chats run in parallel.
+    Telegram redelivers an update it thinks failed, so the last
+    UPDATE_DEDUPE_SIZE update_ids are remembered and repeats are dropped.
+    """
+
+    name = "update"
+
+    def __init__(self, handle, workers: int = UPDATE_WORKERS, max_queue: int = UPDATE_QUEUE_SIZE,
+                 dedupe_size: int = UPDATE_DEDUPE_SIZE):
+        super().__init__(workers, max_queue)
+        self.handle = handle  # handle(update), run on a pool thread
+        self.dedupe_size = dedupe_size
+        self._seen: "OrderedDict[int, None]" = OrderedDict()
+        self._seen_lock = threading.Lock()
+        self.stats["duplicates"] = 0
+
+    def dispatch(self, update: dict) -> bool:
+        """Queue one update. False only when the queue is full (retry later)."""
+        update_id = update.get("update_id")
+        with self._seen_lock:
+            if update_id is not None and update_id in self._seen:
+                self.stats["duplicates"] += 1
+                print(f"Duplicate update {update_id} dropped")
+                metrics.inc("telegram_updates_total", result="duplicate")
+                return True
+        chat_id = update_chat_id(update)
+        if not self.submit(chat_id, lambda: self.handle(update), label=f"update {update_id}"):
+            metrics.inc("telegram_updates_total", result="rejected")
+            return False
+        metrics.inc("telegram_updates_total", result="accepted")
+        if update_id is not None:
+            with self._seen_lock:
+                self._seen[update_id] = None
+                while len(self._seen) > self.dedupe_size:
+                    self._seen.popitem(last=False)
+        return True
+
+
+def handle_update(update: dict):
+    """Handle one Telegram update (runs on an UpdateDispatcher thread)."""
+    # Debug: show what update type we received
+    update_types = [k for k in update.keys() if k != "update_id"]
+    if update_types and update_types[0] != "message":
+        print(f"Received update type: {update_types}")
+    if "message" in update:
+        started = time.monotonic()
+        text = update["message"].get("text") or ""
+        try:
+            command_router.handle_message(update)
+        finally:
+            kind = "command" if text.startswith("/") else "message"
+            metrics.observe("update_handle_seconds", time.monotonic() - started, kind=kind)
+    else:
+        metrics.observe("update_handle_seconds", 0, kind="other")
+
+
+update_dispatcher = UpdateDispatcher(handle_update)
+
+
+TELEGRAM_POLLING = os.environ.get("TELEGRAM_POLLING", "0") == "1"  # getUpdates instead of a webhook
+POLL_TIMEOUT = int(os.environ.get("POLL_TIMEOUT", "50"))  # Seconds Telegram holds a getUpdates call
+POLL_MAX_BACKOFF = 30  # Seconds between retries after repeated getUpdates errors
+
+
+class UpdatePoller:
+    """Pulls updates with getUpdates long polling (no tunnel, no webhook).
+
+    One thread keeps a single keep-alive connection open to Telegram and
+    feeds every update to the same UpdateDispatcher the webhook uses. The
+    next offset is written to the node dir after each batch is queued, so a
+    restart resumes where it stopped instead of replaying or dropping the
+    backlog Telegram still holds (up to 24 h).
+    """
+
+    def __init__(self, api: Optional[TelegramAPI] = None, offset_file: Path = UPDATE_OFFSET_FILE,
+                 timeout: int = POLL_TIMEOUT):
+        self.telegram = api or TelegramAPI(BOT_TOKEN, TelegramConnectionPool(TELEGRAM_API_BASE, size=1))
+        self.offset_file = offset_file
+        self.timeout = timeout
+        self.offset = self.load_offset()
+        self._thread = None
+        self._stop = threading.Event()
+        self._failures = 0
+        self.stats = {"polls": 0, "updates": 0, "errors": 0}
+
+    def load_offset(self) -> Optional[int]:
+        try:
+            return int(self.offset_file.read_text().strip())
+        except (OSError, ValueError):
+            return None
+
+    def save_offset(self):
+        try:
+            self.offset_file.parent.mkdir(parents=True, exist_ok=True, mode=0o700)
+            tmp = self.offset_file.with_name(self.offset_file.name + ".tmp")
+            tmp.write_text(str(self.offset))
+            tmp.chmod(0o600)
+            tmp.replace(self.offset_file)
+        except OSError as e:
+            print(f"Failed to save update offset: {e}")
+
+    def start(self) -> bool:
+        if self._thread is not None:
+            return True
+        # getUpdates answers 409 while a webhook is set
+        result = self.telegram.api("deleteWebhook", {"drop_pending_updates": False})
+        if not (result and result.get("ok")):
+            print("Polling: deleteWebhook failed, getUpdates may be refused (409)")
+        self._stop.clear()
+        self._thread = threading.Thread(target=self._loop, daemon=True, name="update-poller")
+        self._thread.start()
+        return True
+
+    def stop(self, timeout: Optional[float] = None):
+        """Stop after the getUpdates call in progress (Telegram allows one poller per bot)."""
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(self.timeout + 10 if timeout is None else timeout)
+            self._thread = None
+
+    def _loop(self):
+        while not self._stop.is_set():
+            wait = self.poll_once()
+            if wait:
+                self._stop.wait(wait)
+
+    def poll_once(self) -> float:
+        """One getUpdates call. Returns seconds to wait before the next one."""
+        data = {"timeout": self.timeout}
+        if self.offset is not None:
+            data["offset"] = self.offset
+        self.stats["polls"] += 1
+        try:
+            result = self.telegram.request("getUpdates", data, timeout=self.timeout + 10)
+        except TelegramRetryAfter as e:
+            print(f"Polling: {e}")
+            return e.retry_after
+        if not (result and result.get("ok")):
+            self.stats["errors"] += 1
+            self._failures += 1
+            return min(2 ** self._failures, POLL_MAX_BACKOFF)
+        self._failures = 0
+        updates = result.get("result", [])
+        accepted = 0
+        for update in updates:
+            if not update_dispatcher.dispatch(update):
+                break  # Queue full: refetch from this update next time
+            self.offset = update["update_id"] + 1
+            accepted += 1
+        if accepted:
+            self.stats["updates"] += accepted
+            self.save_offset()
+        return 1 if accepted < len(updates) else 0
+
+
+update_poller: Optional[UpdatePoller] = None
 
 # ============================================================
 # NON-CORE: HTTP Handler
 # ============================================================
 
 class Handler(BaseHTTPRequestHandler):
+    timeout = HTTP_IDLE_TIMEOUT  # Bounds a request that stalls mid-read
+
+    def handle(self):
+        """Serve the requests already sent, then park an idle keep-alive connection.
+
+        Unlike BaseHTTPRequestHandler.handle() this does not block the pool
+        thread waiting for the next request; ReuseAddrServer requeues the
+        socket when one arrives.
+        """
+        self.keep_open = False
+        self.close_connection = True
+        self.handle_one_request()
+        while not self.close_connection:
+            if not self._request_buffered():
+                self.keep_open = True
+                return
+            self.handle_one_request()
+
+    def _request_buffered(self) -> bool:
+        """Bytes of a next request already read or waiting (pipelined)."""
+        self.connection.setblocking(False)
+        try:
+            return bool(self.rfile.peek(1))
+        except OSError:
+            return False
+        finally:
+            self.connection.settimeout(self.timeout)
+
+    def handle_one_request(self):
+        self._counted = False
+        try:
+            super().handle_one_request()
+        finally:
+            if self._counted:
+                self.server.request_started(-1)
+
+    def parse_request(self):
+        # Counted from the request line on, so a hot restart's drain waits for it
+        ok = super().parse_request()
+        if ok:
+            self.server.request_started()
+            self._counted = True
+        return ok
+
     def do_POST(self):
         # Route based on path
         if self.path == "/response":
@@ -2601,6 +6431,15 @@ class Handler(BaseHTTPRequestHandler):
             self.handle_hook_response()
             return
 
+        if self.path == "/draft":
+            # Partial output from an adapter (internal, localhost only)
+            self.handle_draft()
+            return
+
+        if self.path == "/rpc":
+            self.handle_rpc()
+            return
+
         if self.path == "/notify":
             # Internal endpoint for system notifications (localhost only)
             self.handle_notify()
@@ -2619,12 +6458,12 @@ class Handler(BaseHTTPRequestHandler):
         body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
         try:
             update = json.loads(body)
-            # Debug: show what update type we received
-            update_types = [k for k in update.keys() if k != "update_id"]
-            if update_types and update_types[0] != "message":
-                print(f"Received update type: {update_types}")
-            if "message" in update:
-                command_router.handle_message(update)
+            if not update_dispatcher.dispatch(update):
+                # Telegram redelivers later; nothing was handled
+                self.send_response(503)
+                self.end_headers()
+                self.wfile.write(b"Busy")
+                return
         except Exception as e:
             print(f"Error: {e}")
             import traceback
@@ -2633,6 +6472,35 @@ class Handler(BaseHTTPRequestHandler):
         self.end_headers()
         self.wfile.write(b"OK")
 
+    def handle_rpc(self):
+        """Worker-host RPC from the front bridge (HOST_AGENT=1 only).
+
+        SECURITY: Requires the shared HOST_SECRET in X-Host-Secret; without
+        HOST_AGENT or a secret the endpoint does not exist.
+        """
+        if not HOST_AGENT or not HOST_SECRET:
+            self._hook_reply(404, b"Not found")
+            return
+        if not hmac.compare_digest(self.headers.get("X-Host-Secret", ""), HOST_SECRET):
+            print("RPC rejected: invalid host secret")
+            self._hook_reply(403, b"Forbidden")
+            return
+        try:
+            data = json.loads(self.rfile.read(int(self.headers.get("Content-Length", 0))))
+            result = {"ok": True, "result": handle_host_rpc(data.get("method", ""), data.get("params") or {})}
+        except Exception as e:
+            result = {"ok": False, "error": str(e)}
+        body = json.dumps(result).encode()
+        keep_alive = self.headers.get("Connection", "").lower() == "keep-alive" and not self.server.draining
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        # The front reuses one connection per call slot
+        self.send_header("Connection", "keep-alive" if keep_alive else "close")
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = not keep_alive
+
     def handle_notify(self):
         """Handle system notification request (internal, localhost only).
 
@@ -2653,11 +6521,7 @@ class Handler(BaseHTTPRequestHandler):
 
             # Send to all known chat_ids
             chat_ids = get_all_chat_ids()
-            sent = 0
-            for chat_id in chat_ids:
-                result = telegram_api("sendMessage", {"chat_id": chat_id, "text": text})
-                if result and result.get("ok"):
-                    sent += 1
+            sent = notify_all_chats(text)
 
             print(f"Notify: sent to {sent}/{len(chat_ids)} chats: {text[:50]}...")
 
@@ -2684,40 +6548,91 @@ class Handler(BaseHTTPRequestHandler):
             data = json.loads(body)
             session_name = data.get("session")
             text = data.get("text", "")
+            if session_name:
+                session_name = resolve_session_alias(session_name)
 
-            if not session_name or not text:
-                self.send_response(400)
-                self.end_headers()
-                self.wfile.write(b"Missing session or text")
+            pane_fallback = data.get("pane_fallback") is True and not text
+            if not session_name or not (text or pane_fallback):
+                self._hook_reply(400, b"Missing session or text")
                 return
 
             # Get chat_id from session's file
-            chat_id_file = get_chat_id_file(session_name)
-            if not chat_id_file.exists():
+            chat_id = (session_store.read(get_chat_id_file(session_name)) or "").strip()
+            if not chat_id:
                 print(f"Hook response: no chat_id for session '{session_name}'")
-                self.send_response(404)
-                self.end_headers()
-                self.wfile.write(b"No chat_id for session")
+                self._hook_reply(404, b"No chat_id for session")
                 return
 
-            chat_id = chat_id_file.read_text().strip()
-            print(f"Hook response: {session_name} -> chat {chat_id} ({len(text)} chars)")
-
-            # Send response using shared helper
+            if pane_fallback:
+                # Transcript had nothing: the hook asks for the screen instead of capturing it
+                text = pane_fallback_response(session_name, f"{TMUX_PREFIX}{session_name}")
+                if not text:
+                    print(f"Hook response: {session_name} pane fallback found no response")
+                    clear_pending(session_name)
+                    self._hook_reply(204, b"")
+                    return
+            wait_ms = record_transcript_wait(session_name, data.get("transcript_wait_ms"))
+            wait_note = f", transcript wait {wait_ms}ms" if wait_ms is not None else ""
+            print(f"Hook response: {session_name} -> chat {chat_id} ({len(text)} chars{wait_note})")
+            # Hooks echo the id they saw; older hooks fall back to the session dir
+            trace_id = data.get("trace_id") or read_trace_id(session_name)
+            tracer.span(trace_id, "response", worker=session_name, source=data.get("source") or "hook",
+                        transcript_wait_ms=wait_ms)
+
+            # Queue for the outbound dispatcher; reply as soon as it's accepted
             escape = should_escape_response(data)
-            send_response_to_telegram(session_name, text, int(chat_id), escape=escape, log_prefix="Response")
-
-            # Clear pending
-            clear_pending(session_name)
+            if not enqueue_response(session_name, text, int(chat_id), escape=escape, log_prefix="Response",
+                                    trace_id=trace_id):
+                self._hook_reply(503, b"Outbound queue full")
+                return
 
-            self.send_response(200)
-            self.end_headers()
-            self.wfile.write(b"OK")
+            self._hook_reply(200, b"OK")
         except Exception as e:
             print(f"Hook response error: {e}")
-            self.send_response(500)
-            self.end_headers()
-            self.wfile.write(str(e).encode())
+            self._hook_reply(500, str(e).encode())
+
+    def handle_draft(self):
+        """Handle partial output for the worker's live draft message.
+
+        POST /draft {"session": <name>, "text": <turn text so far, raw>}
+        204 when STREAM_DRAFTS is off, 409 once the turn's final response came.
+        """
+        try:
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            if not STREAM_DRAFTS:
+                self._hook_reply(204, b"")
+                return
+            data = json.loads(body)
+            session_name = resolve_session_alias(data.get("session") or "")
+            text = data.get("text", "")
+            if not session_name or not text:
+                self._hook_reply(400, b"Missing session or text")
+                return
+            chat_id = (session_store.read(get_chat_id_file(session_name)) or "").strip()
+            if not chat_id:
+                self._hook_reply(404, b"No chat_id for session")
+                return
+            if not draft_streamer.update(session_name, chat_id, text):
+                self._hook_reply(409, b"Turn already answered")
+                return
+            self._hook_reply(200, b"OK")
+        except Exception as e:
+            print(f"Draft error: {e}")
+            self._hook_reply(500, str(e).encode())
+
+    def _hook_reply(self, code: int, body: bytes):
+        """Reply to a hook; honor keep-alive so the hook agent reuses its connection.
+
+        While draining after a hot restart the connection is closed, so the
+        agent's next post reconnects and reaches the new process.
+        """
+        keep_alive = self.headers.get("Connection", "").lower() == "keep-alive" and not self.server.draining
+        self.send_response(code)
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("Connection", "keep-alive" if keep_alive else "close")
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = not keep_alive
 
     def do_GET(self):
         # Handle /workers endpoint for inter-worker discovery
@@ -2725,11 +6640,52 @@ class Handler(BaseHTTPRequestHandler):
             self.handle_workers_endpoint()
             return
 
+        if (self.path.startswith("/trace/") or self.path == "/metrics") and not self.observability_allowed():
+            print(f"Rejected {self.path.split('/')[1]} request: not authorized")
+            self.send_response(403)
+            self.send_header("Content-Length", "9")
+            self.end_headers()
+            self.wfile.write(b"Forbidden")
+            return
+
+        if self.path.startswith("/trace/"):
+            trace = tracer.get(self.path[len("/trace/"):])
+            body = json.dumps(trace).encode() if trace else b"Unknown trace"
+            self.send_response(200 if trace else 404)
+            self.send_header("Content-Type", "application/json" if trace else "text/plain")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+
+        if self.path == "/metrics":
+            body = metrics.render().encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+
         # Default health check endpoint
         self.send_response(200)
         self.end_headers()
         self.wfile.write(b"Claude-Telegram Multi-Session Bridge")
 
+    def observability_allowed(self) -> bool:
+        """/trace and /metrics carry chat ids and worker names.
+
+        SECURITY: With TELEGRAM_WEBHOOK_SECRET set, the caller must send it as
+        `Authorization: Bearer <secret>`. Without one, only direct local
+        clients are served; requests forwarded by the tunnel (which connects
+        from localhost) carry a forwarding header and are refused.
+        """
+        if WEBHOOK_SECRET:
+            return hmac.compare_digest(self.headers.get("Authorization", ""), f"Bearer {WEBHOOK_SECRET}")
+        if self.headers.get("Cf-Connecting-Ip") or self.headers.get("X-Forwarded-For"):
+            return False
+        return self.client_address[0] in ("127.0.0.1", "::1")
+
     def handle_workers_endpoint(self):
         """Return list of active workers with communication details.
 
@@ -2773,12 +6729,185 @@ def graceful_shutdown(signum, frame):
 
     print(f"\n[{timestamp}] Received {sig_name} ({parent_info}), shutting down...")
 
-    send_shutdown_message()
+    if not HOST_AGENT:
+        send_shutdown_message()
+    tmux_control.close()
+    hook_agent.stop()
+    adapter_agents.stop_all()
     sys.exit(0)
 
 
+HOT_RESTART_TIMEOUT = float(os.environ.get("HOT_RESTART_TIMEOUT", "30"))  # Seconds for the new process to be ready
+HOT_RESTART_DRAIN = float(os.environ.get("HOT_RESTART_DRAIN", "60"))  # Max seconds the old process drains
+
+
+class HotRestart:
+    """SIGUSR2: hand the listening socket to a new bridge process, drain, exit.
+
+    The new process gets the socket's fd (BRIDGE_LISTEN_FD) and a pipe
+    (BRIDGE_READY_FD) it writes to just before serving. Until then the old
+    process serves alone, so the port never stops accepting and the tunnel
+    and webhook, which only know the port, stay as they are. Once the new
+    process is ready the old one stops accepting, finishes what it already
+    took (requests in flight, queued updates, adapter runs, outbound sends,
+    up to HOT_RESTART_DRAIN seconds) and exits without the shutdown notice.
+    If the new process fails to come up, the old one keeps serving.
+    """
+
+    def __init__(self, timeout: float = HOT_RESTART_TIMEOUT, drain_timeout: float = HOT_RESTART_DRAIN):
+        self.timeout = timeout
+        self.drain_timeout = drain_timeout
+        self.server: Optional[ReuseAddrServer] = None
+        self.handed_off = False
+        self._lock = threading.Lock()
+
+    @staticmethod
+    def inherited_fd() -> Optional[int]:
+        fd = os.environ.get("BRIDGE_LISTEN_FD")
+        return int(fd) if fd and fd.isdigit() else None
+
+    def make_server(self, address) -> ReuseAddrServer:
+        """Server on the inherited socket after a hot restart, else a fresh bind."""
+        return ReuseAddrServer(address, Handler, listen_fd=self.inherited_fd())
+
+    def command(self) -> list:
+        return [sys.executable, "-u", str(Path(__file__).resolve())]
+
+    def serve(self, server: ReuseAddrServer):
+        """serve_forever(); after a handoff stopped it, drain before returning."""
+        self.server = server
+        if threading.current_thread() is threading.main_thread():
+            signal.signal(signal.SIGUSR2, lambda signum, frame: threading.Thread(
+                target=self.handoff, daemon=True, name="hot-restart").start())
+        self.notify_ready()
+        server.serve_forever()
+        if self.handed_off:
+            self.drain()
+
+    def notify_ready(self):
+        """Tell the process that started us (hot restart) that we are serving."""
+        fd = os.environ.pop("BRIDGE_READY_FD", None)
+        os.environ.pop("BRIDGE_LISTEN_FD", None)  # A later handoff passes its own
+        if not fd or not fd.isdigit():
+            return
+        try:
+            os.write(int(fd), b"ready")
+            os.close(int(fd))
+        except OSError as e:
+            print(f"Hot restart: could not signal ready: {e}")
+
+    def _wait_ready(self, read_fd: int, child: subprocess.Popen) -> bool:
+        deadline = time.monotonic() + self.timeout
+        while time.monotonic() < deadline and child.poll() is None:
+            ready, _, _ = select.select([read_fd], [], [], 0.2)
+            if ready:
+                return os.read(read_fd, 16) == b"ready"  # EOF: the child exited or closed it
+        return False
+
+    def handoff(self) -> bool:
+        """Start the new process on our socket; once it is ready, stop accepting."""
+        if self.server is None or not self._lock.acquire(blocking=False):
+            return False
+        try:
+            listen_fd = self.server.socket.fileno()
+            print(f"Hot restart: starting a new bridge on fd {listen_fd}...")
+            if update_poller:
+                update_poller.stop()  # One getUpdates consumer at a time
+            read_fd, write_fd = os.pipe()
+            env = dict(os.environ, BRIDGE_LISTEN_FD=str(listen_fd), BRIDGE_READY_FD=str(write_fd))
+            try:
+                child = subprocess.Popen(self.command(), env=env, pass_fds=(listen_fd, write_fd))
+            except OSError as e:
+                child = None
+                print(f"Hot restart: could not start new bridge: {e}")
+            finally:
+                os.close(write_fd)
+            ready = child is not None and self._wait_ready(read_fd, child)
+            os.close(read_fd)
+            if not ready:
+                print("Hot restart: new bridge not ready, this one keeps serving")
+                if child is not None and child.poll() is None:
+                    child.kill()
+                if update_poller:
+                    update_poller.start()
+                return False
+            self.handed_off = True
+            self.server.draining = True
+            pid_file = NODE_DIR / "bridge.pid"
+            if pid_file.exists():  # The CLI watchdog follows the bridge by this file
+                pid_file.write_text(str(child.pid))
+            print(f"Hot restart: PID {child.pid} is serving, draining this process")
+            self.server.shutdown()  # serve_forever() returns, serve() drains
+            return True
+        finally:
+            if not self.handed_off:
+                self._lock.release()
+
+    def drain(self) -> bool:
+        """Wait for accepted work to finish, then stop our helpers. True if all finished."""
+        deadline = time.monotonic() + self.drain_timeout
+        # Replies the hook agent already took from Stop hooks are posted before it exits
+        hook_agent.stop(timeout=self.drain_timeout)
+        while True:
+            busy = self.server.busy() + update_dispatcher.pending() + adapter_queue.busy() + outbound.pending()
+            if not busy or time.monotonic() >= deadline:
+                break
+            time.sleep(0.05)
+        if busy:
+            print(f"Hot restart: drain timed out with {busy} job(s) left")
+        else:
+            print("Hot restart: drained, exiting")
+        self.server.server_close()
+        tmux_control.close(kill_session=False)  # The new process is attached to the same control session
+        adapter_agents.stop_all()
+        return not busy
+
+
+hot_restart = HotRestart()
+
+
+def serve_host_agent():
+    """HOST_AGENT=1: host workers for a front bridge (RPC on /rpc, no Telegram)."""
+    if not HOST_SECRET:
+        print("Error: HOST_AGENT=1 needs HOST_SECRET (shared with the front bridge)")
+        return
+    if not os.environ.get("BRIDGE_URL"):
+        print("Error: HOST_AGENT=1 needs BRIDGE_URL set to the front bridge (hooks deliver there)")
+        return
+    signal.signal(signal.SIGTERM, graceful_shutdown)
+    signal.signal(signal.SIGINT, graceful_shutdown)
+    SESSIONS_DIR.mkdir(parents=True, exist_ok=True, mode=0o700)
+    SESSIONS_DIR.chmod(0o700)
+    _sync_worker_manager()
+    registered = worker_manager.refresh()
+    for name, info in registered.items():
+        if not get_backend(get_worker_backend(name, info)).is_interactive:
+            ensure_worker_pipe(name)
+    worker_manager.start_reconcile()
+    if TMUX_CONTROL:
+        tmux_control.start()
+    if HOOK_AGENT and hook_agent.start():
+        print(f"Hook agent: {hook_agent.socket_path}")
+    if SANDBOX_ENABLED:
+        sandbox.start()
+    worker_pool.start()
+    inbox_gc.start()
+    print(f"Worker host agent on :{PORT} (RPC /rpc), responses go to {BRIDGE_URL}")
+    for warning in plaintext_rpc_warnings():
+        print(warning)
+    print(f"Sessions: {list(registered.keys()) or 'none'}")
+    try:
+        hot_restart.serve(hot_restart.make_server(("0.0.0.0", PORT)))
+    except KeyboardInterrupt:
+        graceful_shutdown(signal.SIGINT, None)
+
+
 def main():
-    global admin_chat_id
+    global admin_chat_id, update_poller
+
+    if HOST_AGENT:
+        serve_host_agent()
+        return
 
     if not BOT_TOKEN:
         print("Error: TELEGRAM_BOT_TOKEN not set")
@@ -2793,8 +6922,9 @@ def main():
     SESSIONS_DIR.chmod(0o700)
 
     # Discover existing sessions
-    registered = scan_tmux_sessions()
-    registered = get_registered_sessions(registered)
+    worker_hosts.poll()
+    _sync_worker_manager()
+    registered = worker_manager.refresh()
     if registered:
         print(f"Discovered sessions: {list(registered.keys())}")
         for name, info in registered.items():
@@ -2818,8 +6948,30 @@ def main():
             admin_chat_id = last_chat_id
             print(f"Restored admin from last_chat_id: {admin_chat_id}")
 
+    worker_manager.start_reconcile()
+    if TMUX_CONTROL:
+        tmux_control.start()
+    if HOOK_AGENT and hook_agent.start():
+        print(f"Hook agent: {hook_agent.socket_path}")
+    if STREAM_DRAFTS and transcript_drafts.start():
+        print(f"Draft streaming: edits every {STREAM_EDIT_INTERVAL:g}s")
+    if SANDBOX_ENABLED:
+        sandbox.start()
+    worker_pool.start()
+    if inbox_gc.start():
+        print(f"Inbox GC: every {INBOX_GC_INTERVAL:g}s")
     setup_bot_commands()
+    if TELEGRAM_POLLING:
+        update_poller = UpdatePoller()
+        update_poller.start()
+        offset_note = f"offset {update_poller.offset}" if update_poller.offset is not None else "no saved offset"
+        print(f"Updates: getUpdates long poll ({POLL_TIMEOUT}s, {offset_note})")
     print(f"Multi-Session Bridge on :{PORT}")
+    for host in worker_hosts.hosts.values():
+        state_note = f"{len(host.sessions)} workers" if host.online else "unreachable"
+        print(f"Worker host: {host.name} at {host.url} ({state_note})")
+    for warning in plaintext_rpc_warnings():
+        print(warning)
     print(f"Hook endpoint: http://localhost:{PORT}/response")
     print(f"Active: {state['active'] or 'none'}")
     print(f"Sessions: {list(registered.keys()) or 'none'}")
@@ -2835,6 +6987,9 @@ def main():
     # Sandbox status
     if SANDBOX_ENABLED:
         print(f"Sandbox mode: Workers run in Docker containers")
+        reuse = "kept per worker (docker exec)" if SANDBOX_REUSE else "docker run --rm per start"
+        pause = f", paused after {SANDBOX_PAUSE_IDLE:g}s idle" if SANDBOX_PAUSE_IDLE > 0 else ""
+        print(f"Containers: {reuse}{pause}")
         print(f"Mounted: {Path.home()} → /workspace")
         if SANDBOX_EXTRA_MOUNTS:
             for host, container, ro in SANDBOX_EXTRA_MOUNTS:
@@ -2845,7 +7000,10 @@ def main():
         print("Sandbox mode: disabled (direct execution)")
 
     # Send startup notification if we have a last known chat ID
-    if last_chat_id:
+    if hot_restart.inherited_fd() is not None:
+        state["startup_notified"] = True  # Hot restart: no chat saw us go away
+        print(f"Hot restart: serving on inherited fd {hot_restart.inherited_fd()}")
+    elif last_chat_id:
         state["startup_notified"] = True
         sessions = list(registered.keys())
         active = state["active"]
@@ -2868,7 +7026,7 @@ def main():
             print(f"Failed to send startup notification: {result}")
 
     try:
-        ReuseAddrServer(("0.0.0.0", PORT), Handler).serve_forever()
+        hot_restart.serve(hot_restart.make_server(("0.0.0.0", PORT)))
     except KeyboardInterrupt:
         graceful_shutdown(signal.SIGINT, None)
 
@@ -9,7 +9,7 @@ set -euo pipefail
 # CONFIG + GLOBALS
 # ============================================================
 
-VERSION="0.19.0"
+VERSION="0.49.0"
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 
 # ─────────────────────────────────────────────────────────────────────────────
@@ -22,6 +22,7 @@ SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 #   ADMIN_CHAT_ID           - Pre-set admin (otherwise auto-learns first user)
 #   TUNNEL_URL              - Use existing tunnel instead of starting cloudflared
 #   TELEGRAM_WEBHOOK_SECRET - Webhook verification secret
+#   TELEGRAM_POLLING        - Set to "1" to pull updates with getUpdates (same as --polling)
 #
 # Sandbox mode (Docker isolation):
 #   SANDBOX_ENABLED         - Set to "1" to run workers in Docker containers (default: 0)
@@ -278,16 +279,16 @@ require_port_free() {
 
 telegram_api() {
     local token="$1" method="$2" data="$3"
-    curl -s -X POST "https://api.telegram.org/bot${token}/${method}" \
+    curl -s -X POST "${TELEGRAM_API_BASE:-https://api.telegram.org}/bot${token}/${method}" \
         -H "Content-Type: application/json" -d "$data"
 }
 
 telegram_set_webhook() {
     local token="$1" url="$2"
     if [[ -n "${TELEGRAM_WEBHOOK_SECRET:-}" ]]; then
-        curl -s "https://api.telegram.org/bot${token}/setWebhook?url=${url}&secret_token=${TELEGRAM_WEBHOOK_SECRET}"
+        curl -s "${TELEGRAM_API_BASE:-https://api.telegram.org}/bot${token}/setWebhook?url=${url}&secret_token=${TELEGRAM_WEBHOOK_SECRET}"
     else
-        curl -s "https://api.telegram.org/bot${token}/setWebhook?url=${url}"
+        curl -s "${TELEGRAM_API_BASE:-https://api.telegram.org}/bot${token}/setWebhook?url=${url}"
     fi
 }
 
@@ -378,7 +379,8 @@ cmd_run() {
     node=$(resolve_target_node)
 
     # Parse args first (CLI takes precedence over config)
-    local port="" tunnel_url="" no_tunnel=false
+    local port="" tunnel_url="" no_tunnel=false polling=false
+    [[ "${TELEGRAM_POLLING:-0}" == "1" ]] && polling=true
 
     while [[ $# -gt 0 ]]; do
         case "$1" in
@@ -387,6 +389,7 @@ cmd_run() {
             --tunnel-url=*)      tunnel_url="${1#*=}"; shift;;
             --tunnel-url)        tunnel_url="$2"; shift 2;;
             --no-tunnel)         no_tunnel=true; shift;;
+            --polling)           polling=true; shift;;
             --headless)          HEADLESS=true; shift;;
             -q|--quiet)          QUIET=true; shift;;
             -v|--verbose)        VERBOSE=true; shift;;
@@ -404,7 +407,7 @@ cmd_run() {
     check_cmd tmux || { error "tmux not installed"; hint "brew install tmux"; exit 4; }
     check_cmd python3 || { error "python3 not installed"; exit 4; }
 
-    if ! $no_tunnel && [[ -z "$tunnel_url" ]]; then
+    if ! $no_tunnel && ! $polling && [[ -z "$tunnel_url" ]]; then
         check_cmd cloudflared || { error "cloudflared not installed"; hint "brew install cloudflared (or use --no-tunnel)"; exit 4; }
     fi
 
@@ -443,6 +446,9 @@ cmd_run() {
     # Set up env vars for bridge
     export TELEGRAM_BOT_TOKEN="$token" PORT="$port"
     export SESSIONS_DIR="$sessions_dir" TMUX_PREFIX="$tmux_prefix"
+    if $polling; then
+        export TELEGRAM_POLLING=1
+    fi
 
     # Sandbox mode env vars
     export SANDBOX_ENABLED="${SANDBOX:-0}"
@@ -476,8 +482,10 @@ cmd_run() {
     local tunnel_pid=""
     local tunnel_log=""
 
-    # Start tunnel (or use provided URL)
-    if [[ -n "$tunnel_url" ]]; then
+    # Start tunnel (or use provided URL); polling needs neither tunnel nor webhook
+    if $polling; then
+        log "$(dim "Polling mode: no tunnel, bridge pulls updates with getUpdates")"
+    elif [[ -n "$tunnel_url" ]]; then
         log "$(dim "Using provided tunnel URL")"
         success "Tunnel: $tunnel_url"
     else
@@ -513,38 +521,42 @@ cmd_run() {
     fi
     sleep 1
 
-    # Set webhook
-    local current_webhook=""
-    local wr; wr=$(telegram_api "$token" "getWebhookInfo" "{}")
-    current_webhook=$(echo "$wr" | grep -o '"url":"[^"]*"' | cut -d'"' -f4)
-
-    if [[ "$current_webhook" == "$tunnel_url" ]]; then
-        log "$(dim "Webhook already configured")"
-        success "Webhook: $tunnel_url"
+    # Set webhook (the bridge deletes it itself in polling mode)
+    if $polling; then
+        success "Updates: getUpdates long poll (offset in $node_dir/update_offset)"
     else
-        log "Setting webhook..."
-        local r ok=false
-
-        for delay in 0 1 2 5 15 30 60; do
-            [[ $delay -gt 0 ]] && { log "Webhook not ready, retrying in ${delay}s..."; sleep "$delay"; }
-            r=$(telegram_set_webhook "$token" "$tunnel_url")
-            if echo "$r" | grep -q '"ok":true'; then
-                ok=true
-                break
-            fi
-        done
+        local current_webhook=""
+        local wr; wr=$(telegram_api "$token" "getWebhookInfo" "{}")
+        current_webhook=$(echo "$wr" | grep -o '"url":"[^"]*"' | cut -d'"' -f4)
 
-        log ""
-        if $ok; then
-            success "Webhook configured"
+        if [[ "$current_webhook" == "$tunnel_url" ]]; then
+            log "$(dim "Webhook already configured")"
+            success "Webhook: $tunnel_url"
         else
-            error "Webhook setup failed (DNS may still be propagating)"
-            hint "Retry manually: ./claudecode-telegram.sh webhook $tunnel_url"
-            # Cleanup before exit
-            [[ -n "$bridge_pid" ]] && kill "$bridge_pid" 2>/dev/null
-            [[ -n "$tunnel_pid" ]] && kill "$tunnel_pid" 2>/dev/null
-            rm -f "$node_dir/bridge.pid" "$node_dir/tunnel.pid" "$node_dir/pid"
-            exit 1
+            log "Setting webhook..."
+            local r ok=false
+
+            for delay in 0 1 2 5 15 30 60; do
+                [[ $delay -gt 0 ]] && { log "Webhook not ready, retrying in ${delay}s..."; sleep "$delay"; }
+                r=$(telegram_set_webhook "$token" "$tunnel_url")
+                if echo "$r" | grep -q '"ok":true'; then
+                    ok=true
+                    break
+                fi
+            done
+
+            log ""
+            if $ok; then
+                success "Webhook configured"
+            else
+                error "Webhook setup failed (DNS may still be propagating)"
+                hint "Retry manually: ./claudecode-telegram.sh webhook $tunnel_url"
+                # Cleanup before exit
+                [[ -n "$bridge_pid" ]] && kill "$bridge_pid" 2>/dev/null
+                [[ -n "$tunnel_pid" ]] && kill "$tunnel_pid" 2>/dev/null
+                rm -f "$node_dir/bridge.pid" "$node_dir/tunnel.pid" "$node_dir/pid"
+                exit 1
+            fi
         fi
     fi
 
@@ -569,6 +581,10 @@ cmd_run() {
         log "Shutting down node '$node'..."
         [[ -n "${tunnel_pid:-}" ]] && kill "$tunnel_pid" 2>/dev/null || true
         [[ -n "${bridge_pid:-}" ]] && kill "$bridge_pid" 2>/dev/null || true
+        # A hot restart may have started a successor since the watchdog last looked
+        local current_pid
+        current_pid=$(cat "$node_dir/bridge.pid" 2>/dev/null || true)
+        [[ -n "$current_pid" && "$current_pid" != "${bridge_pid:-}" ]] && kill "$current_pid" 2>/dev/null || true
         rm -f "$pid_file" "$node_dir/bridge.pid" "$node_dir/tunnel.pid" "$node_dir/tunnel.log" "$node_dir/tunnel_url" "$node_dir/port" "$node_dir/bot_id" "$node_dir/bot_username"
         exit 0
     }
@@ -577,6 +593,14 @@ cmd_run() {
     # 5. Watchdog loop
     while true; do
         if ! kill -0 "$bridge_pid" 2>/dev/null; then
+            # Hot restart: the old bridge wrote its successor's PID before exiting
+            local next_pid
+            next_pid=$(cat "$node_dir/bridge.pid" 2>/dev/null || true)
+            if [[ -n "$next_pid" && "$next_pid" != "$bridge_pid" ]] && kill -0 "$next_pid" 2>/dev/null; then
+                log "$(dim "Bridge hot-restarted: PID $bridge_pid -> $next_pid")"
+                bridge_pid="$next_pid"
+                continue
+            fi
             error "Bridge died unexpectedly"
             exit 1
         fi
@@ -705,9 +729,9 @@ stop_single_node() {
         rm -f "$node_dir/tunnel.pid" "$node_dir/tunnel.log" "$node_dir/tunnel_url"
     fi
 
-    # Kill tmux sessions for this node
+    # Kill tmux sessions for this node (workers + bridge-owned _<prefix> pool/control sessions)
     local sessions
-    sessions=$(tmux list-sessions -F '#{session_name}' 2>/dev/null | grep "^${tmux_prefix}" || true)
+    sessions=$(tmux list-sessions -F '#{session_name}' 2>/dev/null | grep -e "^${tmux_prefix}" -e "^_${tmux_prefix}" || true)
     if [[ -n "$sessions" ]]; then
         while IFS= read -r session; do
             if tmux kill-session -t "$session" 2>/dev/null; then
@@ -776,6 +800,14 @@ cmd_restart() {
     local node
     node=$(resolve_target_node)
 
+    local arg
+    for arg in "$@"; do
+        if [[ "$arg" == "--hot" ]]; then
+            restart_hot "$node"
+            return
+        fi
+    done
+
     log "Restarting node '$node' (preserving tmux sessions)..."
 
     # Stop bridge and tunnel only (NOT tmux sessions)
@@ -805,6 +837,38 @@ cmd_restart() {
     NODE_NAME="$node" cmd_run "$@"
 }
 
+# Hot restart: the bridge hands its listening socket to a new process on SIGUSR2,
+# drains and exits. (Not SIGHUP: a closed terminal must not spawn a bridge.) Tunnel, webhook and the run watchdog stay up.
+restart_hot() {
+    local node="$1" node_dir bridge_pid new_pid
+    node_dir=$(get_node_dir "$node")
+    bridge_pid=$(cat "$node_dir/bridge.pid" 2>/dev/null || true)
+
+    if [[ -z "$bridge_pid" ]] || ! kill -0 "$bridge_pid" 2>/dev/null; then
+        error "Node '$node' has no running bridge"
+        hint "Start it: ./claudecode-telegram.sh --node $node run"
+        exit 1
+    fi
+
+    log "Hot restart of node '$node' (bridge PID $bridge_pid, tunnel and webhook kept)..."
+    kill -USR2 "$bridge_pid"
+
+    # Polling mode first waits out the current getUpdates call
+    local i
+    for i in $(seq 1 200); do
+        new_pid=$(cat "$node_dir/bridge.pid" 2>/dev/null || true)
+        if [[ -n "$new_pid" && "$new_pid" != "$bridge_pid" ]] && kill -0 "$new_pid" 2>/dev/null; then
+            success "New bridge serving (PID $new_pid); PID $bridge_pid drains and exits"
+            return 0
+        fi
+        sleep 0.5
+    done
+
+    error "New bridge did not come up; PID $bridge_pid keeps serving"
+    hint "See $node_dir/bridge.log, or do a full restart: ./claudecode-telegram.sh --node $node restart"
+    exit 1
+}
+
 # Detect orphan processes (tunnels/bridges not owned by any node)
 detect_orphan_processes() {
     local owned_tunnel_pids=() owned_bridge_pids=()
@@ -1205,12 +1269,13 @@ cmd_hook_install() {
     cp "$src" "$dst" && chmod 755 "$dst"
     success "Hook installed: $dst"
 
-    # Also copy helper script
-    local helper_src="$SCRIPT_DIR/hooks/forward-to-bridge.py"
-    local helper_dst="$HOOKS_DIR/forward-to-bridge.py"
-    if [[ -f "$helper_src" ]]; then
-        cp "$helper_src" "$helper_dst" && chmod 755 "$helper_dst"
-    fi
+    # Also copy helper scripts
+    local helper
+    for helper in forward-to-bridge.py telegram-html.py transcript-tail.py; do
+        if [[ -f "$SCRIPT_DIR/hooks/$helper" ]]; then
+            cp "$SCRIPT_DIR/hooks/$helper" "$HOOKS_DIR/$helper" && chmod 755 "$HOOKS_DIR/$helper"
+        fi
+    done
 
     mkdir -p "$CLAUDE_DIR"
     local hook_cmd="$HOME/.claude/hooks/$HOOK_SCRIPT"
@@ -1260,8 +1325,8 @@ cmd_hook_uninstall() {
         log "$(dim "Hook file not found: $hook_file")"
     fi
 
-    # Remove helper
-    rm -f "$HOOKS_DIR/forward-to-bridge.py"
+    # Remove helpers
+    rm -f "$HOOKS_DIR/forward-to-bridge.py" "$HOOKS_DIR/telegram-html.py" "$HOOKS_DIR/transcript-tail.py"
 
     # Remove from settings.json
     if [[ -f "$SETTINGS_FILE" ]] && check_cmd jq; then
@@ -1344,6 +1409,7 @@ TELEGRAM COMMANDS
 SHELL COMMANDS
   run               Start bridge + tunnel + webhook
   restart           Restart (preserves tmux sessions)
+  restart --hot     Swap in a new bridge on the same socket (keeps tunnel/webhook)
   stop              Stop node (bridge, tunnel, sessions)
   clean             Reset admin/chat_id (fixes stale config)
   status            Show current status
@@ -1361,6 +1427,7 @@ FLAGS
   --all                 Target all nodes (stop, status)
   -p, --port <port>     Bridge port (default: 8080)
   --no-tunnel           Skip tunnel/webhook (manual setup)
+  --polling             Pull updates with getUpdates (no tunnel/webhook)
   --tunnel-url <url>    Use existing tunnel URL
   --headless            Non-interactive mode
   -q, --quiet           Suppress non-error output
@@ -1381,6 +1448,7 @@ ENVIRONMENT
   PORT                    Server port (default: 8080)
   TUNNEL_URL              Pre-configured tunnel URL
   TELEGRAM_WEBHOOK_SECRET Webhook verification secret (optional)
+  TELEGRAM_POLLING        Pull updates with getUpdates (1/0, default: 0)
   SANDBOX_ENABLED         Enable sandbox mode (1/0, default: 0)
   SANDBOX_IMAGE           Docker image for workers
 
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Resident adapter for one non-interactive worker (started by the bridge with ADAPTER_AGENT=1).
+
+Usage: adapter-agent.py <socket_path> <backend> <worker-name> <bridge-url> <sessions-dir>
+
+Without it every message starts a cold `python3 hooks/<backend>-adapter.py`:
+interpreter start, imports, lock file, session-id file read and a new HTTP
+connection to /response before the CLI even runs. The agent loads the same
+adapter module once and runs turns in-process:
+
+    POST /run   body = prompt (UTF-8)  -> 200 {"returncode": N} after the reply was posted
+    GET  /stats                        -> counters
+
+The Codex session id stays in memory (still written to codex_session_id so a
+cold adapter can resume it), replies go out over one keep-alive connection
+(hook-agent.py's BridgeClient), and the adapter's flock is still taken per
+turn. The CLIs themselves have no persistent prompt mode here, so each turn
+still runs `codex exec` / `gemini -p` / `opencode run`.
+
+With STREAM_DRAFTS=1 (inherited from the bridge) Codex agent messages are
+also POSTed to /draft as they complete.
+
+The bridge stops the agent on /end and /relaunch (which reset the session);
+it also exits when the bridge does.
+"""
+
+import importlib.util
+import json
+import os
+import socketserver
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+
+HOOK_DIR = Path(__file__).resolve().parent
+ADAPTERS = {
+    "codex": "codex-tmux-adapter.py",
+    "gemini": "gemini-adapter.py",
+    "opencode": "opencode-adapter.py",
+}
+
+
+def load_sibling(name, filename):
+    """Import a hook script that has a dash in its file name."""
+    spec = importlib.util.spec_from_file_location(name, HOOK_DIR / filename)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+class AdapterAgent:
+    def __init__(self, backend, worker_name, bridge_url, sessions_dir):
+        self.backend = backend
+        self.worker_name = worker_name
+        self.sessions_dir = sessions_dir
+        self.adapter = load_sibling(f"{backend}_adapter", ADAPTERS[backend])
+        bridge_client = load_sibling("hook_agent", "hook-agent.py").BridgeClient
+        self.client = bridge_client(f"{bridge_url}/response")
+        self.session_id = None  # Codex: loaded once, then kept in memory
+        self.stream = os.environ.get("STREAM_DRAFTS") == "1"  # Inherited from the bridge
+        self.draft_path = urllib.parse.urlsplit(f"{bridge_url}/draft").path
+        self._lock = threading.Lock()
+        self.stats = {"runs": 0, "errors": 0, "forwarded": 0}
+
+    def _session_lock(self):
+        if self.backend == "codex":
+            return self.adapter.session_lock(self.adapter.get_session_lock_file(self.worker_name, self.sessions_dir))
+        return self.adapter.SessionLock(self.adapter.get_lock_file(self.worker_name, self.sessions_dir))
+
+    def run(self, message):
+        """Run one turn and post the reply. Returns the CLI's return code."""
+        with self._lock, self._session_lock():
+            trace_id = self.adapter.load_trace_id(self.worker_name, self.sessions_dir)
+            if self.backend == "codex":
+                if self.session_id is None:
+                    self.session_id = self.adapter.load_session_id(self.worker_name, self.sessions_dir)
+                on_partial = self._draft if self.stream else None
+                response, new_session_id, returncode = self.adapter.run_codex(message, self.session_id, "", on_partial)
+                if new_session_id and new_session_id != self.session_id:
+                    self.adapter.save_session_id(self.worker_name, self.sessions_dir, new_session_id)
+                    self.session_id = new_session_id
+            else:
+                output, returncode = getattr(self.adapter, f"run_{self.backend}")(message)
+                response = self.adapter.build_response(output, returncode)
+            self.stats["runs"] += 1
+            if response:
+                self._post(response, trace_id)
+        return returncode
+
+    def _draft(self, text):
+        """Partial Codex output for the bridge's live draft (same connection)."""
+        try:
+            self.client.post({"session": self.worker_name, "text": text}, path=self.draft_path)
+        except Exception as e:
+            print(f"[adapter-agent] Failed to send draft: {e}", file=sys.stderr, flush=True)
+
+    def _post(self, response, trace_id=""):
+        payload = {"session": self.worker_name, "text": response, "source": self.backend, "escape": True}
+        if trace_id:
+            payload["trace_id"] = trace_id
+        try:
+            if self.client.post(payload) == 200:
+                self.stats["forwarded"] += 1
+                return
+            self.stats["errors"] += 1
+        except Exception as e:
+            self.stats["errors"] += 1
+            print(f"[adapter-agent] Failed to send to bridge: {e}", file=sys.stderr, flush=True)
+
+
+def make_handler(agent):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def _reply(self, status, payload):
+            body = json.dumps(payload).encode()
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def do_POST(self):
+            if self.path != "/run":
+                self._reply(404, {"error": "not found"})
+                return
+            try:
+                message = self.rfile.read(int(self.headers.get("Content-Length", 0))).decode("utf-8")
+                self._reply(200, {"returncode": agent.run(message)})
+            except Exception as e:
+                agent.stats["errors"] += 1
+                print(f"[adapter-agent] Run error: {e}", file=sys.stderr, flush=True)
+                self._reply(500, {"error": str(e)})
+
+        def do_GET(self):
+            self._reply(200, dict(agent.stats, bridge_connects=agent.client.connects))
+
+        def log_message(self, format, *args):
+            pass  # Unix socket peers have no address; bridge logs the responses
+
+    return Handler
+
+
+class UnixServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+def main():
+    if len(sys.argv) != 6 or sys.argv[2] not in ADAPTERS:
+        print("Usage: adapter-agent.py <socket_path> <codex|gemini|opencode> <worker-name> <bridge-url> <sessions-dir>",
+              file=sys.stderr)
+        return 1
+    socket_path, backend, worker_name, bridge_url, sessions_dir = sys.argv[1:]
+
+    try:
+        os.unlink(socket_path)  # Stale socket from a previous run
+    except FileNotFoundError:
+        pass
+    old_umask = os.umask(0o177)  # Socket is 0o600: only this user can submit prompts
+    try:
+        server = UnixServer(socket_path, make_handler(AdapterAgent(backend, worker_name, bridge_url, sessions_dir)))
+    finally:
+        os.umask(old_umask)
+    socket_ino = os.stat(socket_path).st_ino
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    # Exit with the bridge that started us
+    parent = os.getppid()
+    try:
+        while os.getppid() == parent:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    server.server_close()
+    try:
+        # After a hot restart the path may already be the new bridge's agent
+        if os.stat(socket_path).st_ino == socket_ino:
+            os.unlink(socket_path)
+    except FileNotFoundError:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,19 +1,21 @@
 #!/usr/bin/env python3
 """Codex adapter - non-interactive mode via codex exec --json with session resume.
 
-Blocking: each call blocks until codex finishes. Bridge spawns via Popen so it
-doesn't block. Prompts piped via stdin ('-') to handle long messages and avoid
-CLI flag parsing issues with messages starting with '-'.
+Blocking: each call blocks until codex finishes. The bridge runs one call per
+worker at a time from its adapter queue, off the request thread. Prompts piped
+via stdin ('-') to handle long messages and avoid CLI flag parsing issues with
+messages starting with '-'.
 """
 
 import json
 import os
 import subprocess
 import sys
+import tempfile
 import urllib.request
 from contextlib import contextmanager
 from pathlib import Path
-from typing import Optional
+from typing import Callable, Optional
 
 try:
     import fcntl  # type: ignore
@@ -62,6 +64,14 @@ def save_session_id(worker_name: str, sessions_dir: str, session_id: str):
     f.write_text(session_id)
 
 
+def load_trace_id(worker_name: str, sessions_dir: str) -> str:
+    """Trace id the bridge wrote for the message being answered ("" if none)."""
+    try:
+        return (Path(sessions_dir) / worker_name / "trace").read_text().strip()
+    except OSError:
+        return ""
+
+
 def parse_jsonl_response(output: str) -> tuple[str, str]:
     """Parse JSONL output from codex exec.
 
@@ -101,8 +111,13 @@ def parse_jsonl_response(output: str) -> tuple[str, str]:
     return '\n'.join(response_parts).strip(), thread_id
 
 
-def run_codex(message: str, session_id: str = "", workdir: str = "") -> tuple[str, str, int]:
-    """Run codex exec and return (response, session_id, returncode)."""
+def run_codex(message: str, session_id: str = "", workdir: str = "",
+              on_partial: Optional[Callable[[str], None]] = None) -> tuple[str, str, int]:
+    """Run codex exec and return (response, session_id, returncode).
+
+    With on_partial, JSONL events are read as they arrive and on_partial gets
+    the agent text so far after each completed agent message.
+    """
     cmd = ["codex", "exec", "--json", "--yolo"]
 
     if workdir:
@@ -116,22 +131,53 @@ def run_codex(message: str, session_id: str = "", workdir: str = "") -> tuple[st
         cmd.append("-")
 
     try:
-        result = subprocess.run(
-            cmd,
-            input=message,
-            capture_output=True,
-            text=True
-            # No timeout - let codex run as long as needed
-        )
-        response, new_session_id = parse_jsonl_response(result.stdout)
-        if result.returncode != 0 and not response:
-            stderr = (result.stderr or "").strip()
+        if on_partial is None:
+            result = subprocess.run(
+                cmd,
+                input=message,
+                capture_output=True,
+                text=True
+                # No timeout - let codex run as long as needed
+            )
+            stdout, stderr, returncode = result.stdout, result.stderr, result.returncode
+        else:
+            stdout, stderr, returncode = stream_codex(cmd, message, on_partial)
+        response, new_session_id = parse_jsonl_response(stdout)
+        if returncode != 0 and not response:
+            stderr = (stderr or "").strip()
             response = stderr or "Codex exec failed."
-        return response, new_session_id or session_id, result.returncode
+        return response, new_session_id or session_id, returncode
     except Exception as e:
         return f"Error: {e}", session_id, 1
 
 
+def stream_codex(cmd: list, message: str, on_partial: Callable[[str], None]) -> tuple[str, str, int]:
+    """Run codex exec, calling on_partial as agent messages complete.
+
+    Returns (stdout, stderr, returncode) like subprocess.run would.
+    """
+    with tempfile.TemporaryFile() as err:
+        proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=err, text=True)
+        proc.stdin.write(message)
+        proc.stdin.close()
+        lines = []
+        shown = ""
+        for line in proc.stdout:
+            lines.append(line)
+            if '"agent_message"' not in line:
+                continue
+            text, _ = parse_jsonl_response("".join(lines))
+            if text and text != shown:
+                shown = text
+                try:
+                    on_partial(text)
+                except Exception as e:
+                    print(f"Draft update failed: {e}", file=sys.stderr)
+        returncode = proc.wait()
+        err.seek(0)
+        return "".join(lines), err.read().decode("utf-8", errors="replace"), returncode
+
+
 def send_to_bridge(session_name: str, text: str, bridge_url: str, extra: Optional[dict] = None) -> bool:
     """Send response to bridge (raw text, no escaping)."""
     try:
@@ -151,6 +197,21 @@ def send_to_bridge(session_name: str, text: str, bridge_url: str, extra: Optiona
         return False
 
 
+def send_draft(session_name: str, text: str, bridge_url: str) -> bool:
+    """Send the turn's text so far to the bridge's live draft (STREAM_DRAFTS=1)."""
+    try:
+        req = urllib.request.Request(
+            f"{bridge_url}/draft",
+            data=json.dumps({"session": session_name, "text": text}).encode(),
+            headers={"Content-Type": "application/json"}
+        )
+        with urllib.request.urlopen(req, timeout=5) as r:
+            return r.status == 200
+    except Exception as e:
+        print(f"Failed to send draft to bridge: {e}", file=sys.stderr)
+        return False
+
+
 def main() -> int:
     if len(sys.argv) < 4:
         print("Usage: codex-tmux-adapter.py <worker-name> <message> <bridge-url> [sessions-dir] [workdir]", file=sys.stderr)
@@ -166,9 +227,13 @@ def main() -> int:
     with session_lock(lock_path):
         # Load existing session ID if any
         session_id = load_session_id(worker_name, sessions_dir)
+        trace_id = load_trace_id(worker_name, sessions_dir)
 
         # Run codex
-        response, new_session_id, returncode = run_codex(message, session_id, workdir)
+        on_partial = None
+        if os.environ.get("STREAM_DRAFTS") == "1":
+            on_partial = lambda text: send_draft(worker_name, text, bridge_url)
+        response, new_session_id, returncode = run_codex(message, session_id, workdir, on_partial)
 
         # Save session ID for next time
         if new_session_id:
@@ -176,7 +241,10 @@ def main() -> int:
 
         # Send response to bridge
         if response:
-            send_to_bridge(worker_name, response, bridge_url, extra={"source": "codex", "escape": True})
+            extra = {"source": "codex", "escape": True}
+            if trace_id:
+                extra["trace_id"] = trace_id
+            send_to_bridge(worker_name, response, bridge_url, extra=extra)
 
     return returncode
 
@@ -1,62 +1,29 @@
 #!/usr/bin/env python3
 """Forward extracted Claude response to bridge."""
 
+import os
 import sys
-import re
 import json
+import importlib.util
 import urllib.request
+from pathlib import Path
 
+# Shared with the bridge: one-pass markdown -> Telegram HTML (dash in the name)
+_spec = importlib.util.spec_from_file_location("telegram_html", Path(__file__).resolve().parent / "telegram-html.py")
+telegram_html = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(telegram_html)
+esc = telegram_html.esc
+markdown_to_html = telegram_html.markdown_to_html
 
-def esc(s):
-    """Escape HTML special characters."""
-    return s.replace('&', '&amp;').replace('<', '&lt;').replace('>', '&gt;')
 
-
-def markdown_to_html(text):
-    """Convert markdown to Telegram-compatible HTML."""
-    # Extract code blocks and inline code first (to protect from other formatting)
-    blocks, inlines = [], []
-
-    # Code blocks: ```lang\ncode```
-    text = re.sub(
-        r'```(\w*)\n?(.*?)```',
-        lambda m: (blocks.append((m.group(1) or '', m.group(2))), f"\x00B{len(blocks)-1}\x00")[1],
-        text, flags=re.DOTALL
-    )
-
-    # Inline code: `code`
-    text = re.sub(
-        r'`([^`\n]+)`',
-        lambda m: (inlines.append(m.group(1)), f"\x00I{len(inlines)-1}\x00")[1],
-        text
-    )
-
-    # Escape HTML
-    text = esc(text)
-
-    # Bold: **text**
-    text = re.sub(r'\*\*(.+?)\*\*', r'<b>\1</b>', text)
-
-    # Italic: *text* (but not **text**)
-    text = re.sub(r'(?<!\*)\*([^*]+)\*(?!\*)', r'<i>\1</i>', text)
-
-    # Restore code blocks
-    for i, (lang, code) in enumerate(blocks):
-        if lang:
-            text = text.replace(f"\x00B{i}\x00", f'<pre><code class="language-{lang}">{esc(code.strip())}</code></pre>')
-        else:
-            text = text.replace(f"\x00B{i}\x00", f'<pre>{esc(code.strip())}</pre>')
-
-    # Restore inline code
-    for i, code in enumerate(inlines):
-        text = text.replace(f"\x00I{i}\x00", f'<code>{esc(code)}</code>')
-
-    return text
-
-
-def forward_to_bridge(text, session, bridge_url):
+def forward_to_bridge(text, session, bridge_url, wait_ms=None, trace_id=None):
     """Send formatted text to bridge via HTTP POST."""
-    data = json.dumps({"session": session, "text": text}).encode()
+    payload = {"session": session, "text": text}
+    if wait_ms is not None:
+        payload["transcript_wait_ms"] = wait_ms
+    if trace_id:
+        payload["trace_id"] = trace_id
+    data = json.dumps(payload).encode()
     req = urllib.request.Request(
         bridge_url,
         data=data,
@@ -70,11 +37,13 @@ def forward_to_bridge(text, session, bridge_url):
 
 
 def main():
-    if len(sys.argv) != 4:
-        print(f"Usage: {sys.argv[0]} <tmpfile> <session> <bridge_url>", file=sys.stderr)
+    if len(sys.argv) not in (4, 5):
+        print(f"Usage: {sys.argv[0]} <tmpfile> <session> <bridge_url> [wait_ms]", file=sys.stderr)
         sys.exit(2)
 
     tmpfile, session, bridge_url = sys.argv[1], sys.argv[2], sys.argv[3]
+    # Time the hook spent waiting for the transcript flush (latency reporting)
+    wait_ms = int(sys.argv[4]) if len(sys.argv) == 5 and sys.argv[4].isdigit() else None
 
     with open(tmpfile) as f:
         text = f.read().strip()
@@ -86,7 +55,8 @@ def main():
     text = markdown_to_html(text)
 
     try:
-        forward_to_bridge(text, session, bridge_url)
+        # Set by send-to-telegram.sh from the session's trace file
+        forward_to_bridge(text, session, bridge_url, wait_ms, os.environ.get("BRIDGE_TRACE_ID"))
     except Exception as e:
         print(f"Failed to forward to bridge: {e}", file=sys.stderr)
         sys.exit(1)
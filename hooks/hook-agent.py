@@ -0,0 +1,311 @@
+#!/usr/bin/env python3
+"""Resident Stop-hook agent (one per node, started by the bridge with HOOK_AGENT=1).
+
+Usage: hook-agent.py <socket_path> <sessions_dir> <tmux_prefix> <bridge_endpoint>
+
+The per-turn hook otherwise spawns bash, several `tmux show-environment`
+calls, grep/jq/awk and a cold `python3 forward-to-bridge.py` for every reply.
+With the agent running, send-to-telegram.sh only does:
+
+    curl --unix-socket $HOOK_AGENT_SOCKET -H "X-Tmux-Pane: $TMUX_PANE" --data-binary @- http://hook-agent/stop
+
+and the agent resolves the session (pane -> session name, cached), reads the
+transcript with transcript-tail.py's incremental reader, converts markdown
+with telegram-html.py (as forward-to-bridge.py does), and POSTs to /response over one keep-alive
+connection. Config comes from the bridge at startup, so no env lookups.
+
+Replies to the hook:
+  200 - handled (reply queued for the bridge, or nothing to answer)
+  204 - no assistant text after waiting (hook runs its tmux capture fallback)
+  4xx - not handled (hook runs its normal path)
+"""
+
+import http.client
+import importlib.util
+import json
+import os
+import queue
+import select
+import signal
+import socketserver
+import subprocess
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+
+HOOK_DIR = Path(__file__).resolve().parent
+TRANSCRIPT_WAIT = 5  # Same budget as the hook's own wait
+FLUSH_TIMEOUT = 60  # Max seconds to post queued replies after SIGTERM
+
+
+def load_sibling(name, filename):
+    """Import a hook script that has a dash in its file name."""
+    spec = importlib.util.spec_from_file_location(name, HOOK_DIR / filename)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+tail = load_sibling("transcript_tail", "transcript-tail.py")
+telegram_html = load_sibling("telegram_html", "telegram-html.py")
+
+
+class BridgeClient:
+    """Keep-alive HTTP client for the bridge's /response endpoint."""
+
+    def __init__(self, endpoint):
+        url = urllib.parse.urlsplit(endpoint)
+        self.https = url.scheme == "https"
+        self.host = url.hostname or "localhost"
+        self.port = url.port
+        self.path = url.path or "/response"
+        self._conn = None
+        self.requests = 0
+        self.connects = 0
+
+    def _connect(self):
+        cls = http.client.HTTPSConnection if self.https else http.client.HTTPConnection
+        self._conn = cls(self.host, self.port, timeout=10)
+        self.connects += 1
+
+    def _dropped(self):
+        """The idle keep-alive socket is readable: the bridge closed it."""
+        sock = self._conn.sock
+        if sock is None:
+            return True
+        try:
+            return bool(select.select([sock], [], [], 0)[0])
+        except (OSError, ValueError):
+            return True
+
+    def post(self, payload, path=None):
+        """POST to /response (or another bridge path on the same host).
+
+        An idle connection the bridge already closed is replaced before use.
+        A reused connection that fails while the request is being written is
+        replaced once; after the write the error is raised, because the
+        bridge may have taken the reply and a resend would post it twice.
+        """
+        body = json.dumps(payload).encode()
+        headers = {"Content-Type": "application/json", "Connection": "keep-alive"}
+        reused = self._conn is not None
+        if reused and self._dropped():
+            self.close()
+            reused = False
+        while True:
+            if self._conn is None:
+                self._connect()
+            sent = False
+            try:
+                self._conn.request("POST", path or self.path, body=body, headers=headers)
+                sent = True
+                resp = self._conn.getresponse()
+                resp.read()
+                if resp.will_close:
+                    self.close()
+                self.requests += 1
+                return resp.status
+            except (http.client.RemoteDisconnected, BrokenPipeError, ConnectionResetError):
+                self.close()
+                if not reused or sent:
+                    raise
+                reused = False  # Stale keep-alive socket before the write: reconnect once
+            except Exception:
+                self.close()
+                raise
+
+    def close(self):
+        if self._conn is not None:
+            self._conn.close()
+            self._conn = None
+
+
+class HookAgent:
+    def __init__(self, sessions_dir, tmux_prefix, endpoint):
+        self.sessions_dir = Path(sessions_dir)
+        self.tmux_prefix = tmux_prefix
+        self.client = BridgeClient(endpoint)
+        self._panes = {}  # tmux pane id -> session name
+        self._outbox = queue.Queue()
+        self._active = 0  # Stop events being handled
+        self._active_lock = threading.Lock()
+        self.stats = {"handled": 0, "fallback": 0, "forwarded": 0, "errors": 0}
+        threading.Thread(target=self._sender, daemon=True).start()
+
+    def session_for_pane(self, pane):
+        """Worker session name for a tmux pane id, cached for the pane's life."""
+        name = self._panes.get(pane)
+        if name:
+            return name
+        try:
+            result = subprocess.run(
+                ["tmux", "display-message", "-p", "-t", pane, "#{session_name}"],
+                capture_output=True, text=True, timeout=5
+            )
+        except (OSError, subprocess.TimeoutExpired):
+            return None
+        name = result.stdout.strip()
+        if result.returncode != 0 or not name:
+            return None
+        # Only cache worker sessions; pool slots get renamed when claimed
+        if name.startswith(self.tmux_prefix):
+            self._panes[pane] = name
+        return name
+
+    def handle_stop(self, event, pane, bridge_session=""):
+        """Process one Stop event. Returns the HTTP status for the hook."""
+        with self._active_lock:
+            self._active += 1
+        try:
+            return self._handle_stop(event, pane, bridge_session)
+        finally:
+            with self._active_lock:
+                self._active -= 1
+
+    def _handle_stop(self, event, pane, bridge_session):
+        session_name = self.session_for_pane(pane) if pane else None
+        if not session_name and bridge_session:
+            session_name = f"{self.tmux_prefix}{bridge_session}"  # Docker mode
+        if not session_name or not session_name.startswith(self.tmux_prefix):
+            return 404
+        name = session_name[len(self.tmux_prefix):]
+        session_dir = self.sessions_dir / name
+        transcript_path = event.get("transcript_path") or ""
+        if not (session_dir / "chat_id").exists() or not os.path.isfile(transcript_path):
+            return 200  # Not a bridge-driven turn: nothing to send
+
+        rc, text, wait_ms = tail.read_reply(
+            transcript_path, str(session_dir / "transcript_offset"), TRANSCRIPT_WAIT
+        )
+        if rc == 1:
+            self.stats["fallback"] += 1
+            return 204
+        if rc == 0:
+            try:
+                trace_id = (session_dir / "trace").read_text().strip()
+            except OSError:
+                trace_id = ""
+            self._outbox.put((name, text, wait_ms, trace_id))
+        try:
+            (session_dir / "pending").unlink()
+        except FileNotFoundError:
+            pass
+        self.stats["handled"] += 1
+        return 200
+
+    def _sender(self):
+        """Forward replies in order over the shared bridge connection."""
+        while True:
+            name, text, wait_ms, trace_id = self._outbox.get()
+            payload = {"session": name, "text": telegram_html.markdown_to_html(text)}
+            if wait_ms is not None:
+                payload["transcript_wait_ms"] = wait_ms
+            if trace_id:
+                payload["trace_id"] = trace_id
+            try:
+                status = self.client.post(payload)
+                if status == 200:
+                    self.stats["forwarded"] += 1
+                else:
+                    self.stats["errors"] += 1
+                    print(f"[hook-agent] Bridge error for '{name}': {status}", flush=True)
+            except Exception as e:
+                self.stats["errors"] += 1
+                print(f"[hook-agent] Failed to forward '{name}': {e}", flush=True)
+            self._outbox.task_done()
+
+    def flush(self, timeout):
+        """Wait until Stop events in progress are handled and their replies posted."""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            with self._active_lock:
+                if not self._active and not self._outbox.unfinished_tasks:
+                    return True
+            time.sleep(0.05)
+        return False
+
+
+def make_handler(agent):
+    class Handler(BaseHTTPRequestHandler):
+        def do_POST(self):
+            status = 400
+            try:
+                body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+                if self.path == "/stop":
+                    status = agent.handle_stop(
+                        json.loads(body or b"{}"),
+                        self.headers.get("X-Tmux-Pane", ""),
+                        self.headers.get("X-Bridge-Session", ""),
+                    )
+            except Exception as e:
+                print(f"[hook-agent] Stop event error: {e}", flush=True)
+                agent.stats["errors"] += 1
+                status = 500
+            self.send_response(status)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+
+        def do_GET(self):
+            body = json.dumps(dict(agent.stats, bridge_connects=agent.client.connects)).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, format, *args):
+            pass  # Unix socket peers have no address; bridge logs the responses
+
+    return Handler
+
+
+class UnixServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+def main():
+    if len(sys.argv) != 5:
+        print("Usage: hook-agent.py <socket_path> <sessions_dir> <tmux_prefix> <bridge_endpoint>", file=sys.stderr)
+        return 1
+    socket_path, sessions_dir, tmux_prefix, endpoint = sys.argv[1:]
+
+    try:
+        os.unlink(socket_path)  # Stale socket from a previous run
+    except FileNotFoundError:
+        pass
+    old_umask = os.umask(0o177)  # Socket is 0o600: only this user can hand over events
+    agent = HookAgent(sessions_dir, tmux_prefix, endpoint)
+    try:
+        server = UnixServer(socket_path, make_handler(agent))
+    finally:
+        os.umask(old_umask)
+    socket_ino = os.stat(socket_path).st_ino
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print(f"[hook-agent] Listening on {socket_path}", flush=True)
+
+    # Exit with the bridge that started us, or on its SIGTERM
+    stop = threading.Event()
+    signal.signal(signal.SIGTERM, lambda signum, frame: stop.set())
+    parent = os.getppid()
+    try:
+        while os.getppid() == parent and not stop.wait(1):
+            pass
+    except KeyboardInterrupt:
+        pass
+    server.server_close()
+    if not agent.flush(FLUSH_TIMEOUT):
+        print("[hook-agent] Exiting with replies not posted", flush=True)
+    try:
+        # After a hot restart the path may already be the new bridge's agent
+        if os.stat(socket_path).st_ino == socket_ino:
+            os.unlink(socket_path)
+    except FileNotFoundError:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -30,6 +30,14 @@ def get_lock_file(worker_name: str, sessions_dir: str) -> Path:
     return Path(sessions_dir) / worker_name / "opencode.lock"
 
 
+def load_trace_id(worker_name: str, sessions_dir: str) -> str:
+    """Trace id the bridge wrote for the message being answered ("" if none)."""
+    try:
+        return (Path(sessions_dir) / worker_name / "trace").read_text().strip()
+    except OSError:
+        return ""
+
+
 class SessionLock:
     """Serialize opencode session access per worker."""
     def __init__(self, lock_path: Path):
@@ -115,7 +123,17 @@ def extract_response(raw: str) -> str:
     return raw.strip()
 
 
-def send_to_bridge(session_name: str, text: str, bridge_url: str) -> bool:
+def build_response(output: str, returncode: int) -> str:
+    """Reply text for one run_opencode() result (never empty)."""
+    if returncode != 0 and not output.strip():
+        return "OpenCode request failed."
+    response = extract_response(output)
+    if not response:
+        response = output.strip() or "No response from OpenCode."
+    return response
+
+
+def send_to_bridge(session_name: str, text: str, bridge_url: str, trace_id: str = "") -> bool:
     """Send response to bridge."""
     try:
         payload = {
@@ -124,6 +142,8 @@ def send_to_bridge(session_name: str, text: str, bridge_url: str) -> bool:
             "source": "opencode",
             "escape": True
         }
+        if trace_id:
+            payload["trace_id"] = trace_id
         data = json.dumps(payload).encode()
         req = urllib.request.Request(
             f"{bridge_url}/response",
@@ -151,20 +171,17 @@ def main() -> int:
 
     lock_path = get_lock_file(worker_name, sessions_dir)
     with SessionLock(lock_path):
+        trace_id = load_trace_id(worker_name, sessions_dir)
+
         # Run opencode
         output, returncode = run_opencode(message)
 
         # Extract response
-        if returncode != 0 and not output.strip():
-            response = "OpenCode request failed."
-        else:
-            response = extract_response(output)
-            if not response:
-                response = output.strip() or "No response from OpenCode."
+        response = build_response(output, returncode)
 
         # Send to bridge
         if response:
-            send_to_bridge(worker_name, response, bridge_url)
+            send_to_bridge(worker_name, response, bridge_url, trace_id)
 
     return 0
 
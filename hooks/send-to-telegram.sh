@@ -10,13 +10,32 @@
 #   TMUX_PREFIX   - Session prefix (e.g., "claude-prod-")
 #   SESSIONS_DIR  - Path to session files
 #   PORT          - Bridge port (fallback if BRIDGE_URL not set)
+#   HOOK_AGENT_SOCKET - Resident hook agent socket (bridge HOOK_AGENT=1)
 #
 # FLAGS:
 #   TMUX_FALLBACK=0  - Disable tmux capture fallback (enabled by default)
+#   PANE_STREAM=1    - Bridge streams the pane; the fallback asks it instead of tmux capture
 
 set -euo pipefail
 
-INPUT=$(cat)
+# Builtin read: no fork when the resident agent handles the event
+IFS= read -r -d '' INPUT || true
+
+# ─────────────────────────────────────────────────────────────────────────────
+# Resident hook agent: hand the Stop event over and exit (one curl, no tmux/jq)
+# 200 = handled, 204 = no transcript text (tmux fallback below), else full path
+# ─────────────────────────────────────────────────────────────────────────────
+TRANSCRIPT_WAIT=5
+if [ -n "${HOOK_AGENT_SOCKET:-}" ] && [ -S "$HOOK_AGENT_SOCKET" ] && command -v curl >/dev/null; then
+    AGENT_STATUS=$(curl -s -o /dev/null -w '%{http_code}' --max-time 15 \
+        --unix-socket "$HOOK_AGENT_SOCKET" \
+        -H "X-Tmux-Pane: ${TMUX_PANE:-}" -H "X-Bridge-Session: ${BRIDGE_SESSION:-}" \
+        --data-binary @- http://hook-agent/stop <<<"$INPUT") || true
+    [ "$AGENT_STATUS" = "200" ] && exit 0
+    # Agent already waited for the transcript: go straight to the fallback
+    [ "$AGENT_STATUS" = "204" ] && TRANSCRIPT_WAIT=0
+fi
+
 TRANSCRIPT_PATH=$(echo "$INPUT" | jq -r '.transcript_path')
 
 # ─────────────────────────────────────────────────────────────────────────────
@@ -84,6 +103,9 @@ PENDING_FILE="$SESSION_DIR/pending"
 [ ! -f "$CHAT_ID_FILE" ] && exit 0
 [ ! -f "$TRANSCRIPT_PATH" ] && exit 0
 
+# Trace id of the message being answered, echoed back so the bridge can time it
+TRACE_ID=$(cat "$SESSION_DIR/trace" 2>/dev/null || true)
+
 # Build endpoint URL: BRIDGE_URL takes precedence, fall back to localhost:PORT
 if [ -n "$BRIDGE_URL" ]; then
     # Strip trailing slash and append /response
@@ -92,33 +114,61 @@ else
     BRIDGE_ENDPOINT="http://localhost:${BRIDGE_PORT}/response"
 fi
 
-# Find last user message line
-LAST_USER_LINE=$(grep -n '"type":"user"' "$TRANSCRIPT_PATH" | tail -1 | cut -d: -f1 || true)
-[ -z "$LAST_USER_LINE" ] && rm -f "$PENDING_FILE" && exit 0
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+TAIL_HELPER="$SCRIPT_DIR/transcript-tail.py"
+# Byte offsets (scanned, last user message) so each Stop reads only new bytes
+OFFSET_FILE="$SESSION_DIR/transcript_offset"
 
-# Extract text from transcript (with retry for race condition)
+# Extract text from transcript. The helper waits on file events (inotify/kqueue)
+# for up to TRANSCRIPT_WAIT (5) seconds, so it returns as soon as the reply lands.
 extract_from_transcript() {
-    local tmp=$(mktemp)
-    cat "$TRANSCRIPT_PATH" > "$tmp" 2>/dev/null
-    local lines=$(tail -n "+$LAST_USER_LINE" "$tmp" | grep '"type":"assistant"') || { rm -f "$tmp"; return 1; }
-    TEXT=$(echo "$lines" | jq -rs '[.[].message.content[] | select(.type == "text") | .text | select(. != "(no content)")] | join("\n\n")') || { rm -f "$tmp"; return 1; }
-    rm -f "$tmp"
-    [ -n "$TEXT" ] && [ "$TEXT" != "null" ]
+    local rc=0
+    TEXT=$(python3 "$TAIL_HELPER" "$TRANSCRIPT_PATH" "$OFFSET_FILE" --wait "$TRANSCRIPT_WAIT") || rc=$?
+    # Time spent waiting for the flush, reported to the bridge
+    WAIT_MS=$(jq -r '.wait_ms // empty' "$OFFSET_FILE" 2>/dev/null || true)
+    # 2 = no user message in transcript: nothing to answer
+    [ "$rc" -eq 2 ] && rm -f "$PENDING_FILE" && exit 0
+    [ "$rc" -eq 0 ] && [ -n "$TEXT" ] && [ "$TEXT" != "null" ]
 }
 
-# Try transcript extraction first (10 attempts × 500ms = 5s max)
+# Older installs without the helper: full scan of the transcript
+if [ ! -f "$TAIL_HELPER" ]; then
+    LAST_USER_LINE=$(grep -n '"type":"user"' "$TRANSCRIPT_PATH" | tail -1 | cut -d: -f1 || true)
+    [ -z "$LAST_USER_LINE" ] && rm -f "$PENDING_FILE" && exit 0
+    extract_from_transcript() {
+        local lines=$(tail -n "+$LAST_USER_LINE" "$TRANSCRIPT_PATH" | grep '"type":"assistant"') || return 1
+        TEXT=$(echo "$lines" | jq -rs '[.[].message.content[] | select(.type == "text") | .text | select(. != "(no content)")] | join("\n\n")') || return 1
+        [ -n "$TEXT" ] && [ "$TEXT" != "null" ]
+    }
+fi
+
 TEXT=""
-for attempt in $(seq 1 10); do
-    if extract_from_transcript; then
-        break
-    fi
-    sleep 0.5
-done
+WAIT_MS=""
+if [ -f "$TAIL_HELPER" ]; then
+    extract_from_transcript || true
+else
+    # Legacy retry loop (10 attempts × 500ms = 5s max)
+    for attempt in $(seq 1 10); do
+        if extract_from_transcript; then
+            break
+        fi
+        sleep 0.5
+    done
+fi
 
 # Fallback: extract from tmux capture (enabled by default, set TMUX_FALLBACK=0 to disable)
 TMUX_FALLBACK_USED=false
 if [ -z "$TEXT" ] || [ "$TEXT" = "null" ]; then
     if [ "${TMUX_FALLBACK:-1}" != "0" ] && [ -n "$SESSION_NAME" ]; then
+        # Bridge streams the pane (PANE_STREAM=1): it extracts the reply from its buffer
+        _tmux_pane_stream="$(get_tmux_env PANE_STREAM)"
+        if [ "${_tmux_pane_stream:-${PANE_STREAM:-0}}" = "1" ] && command -v curl >/dev/null; then
+            curl -s -o /dev/null --max-time 5 -H "Content-Type: application/json" \
+                -d "{\"session\":\"$BRIDGE_SESSION\",\"pane_fallback\":true,\"trace_id\":\"$TRACE_ID\"}" \
+                "$BRIDGE_ENDPOINT" || true
+            rm -f "$PENDING_FILE"
+            exit 0
+        fi
         TMUX_FALLBACK_USED=true
         # Capture pane content (last 500 lines)
         TMUX_CONTENT=$(tmux capture-pane -t "$SESSION_NAME" -p -S -500 2>/dev/null)
@@ -181,13 +231,12 @@ if [ -z "$TEXT" ] || [ "$TEXT" = "null" ]; then
 fi
 
 # Forward to bridge (non-blocking with timeout)
-SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 TMPFILE=$(mktemp)
 echo "$TEXT" > "$TMPFILE"
 
 # Run forward in background with 5s timeout, then cleanup
 (
-    timeout 5 python3 "$SCRIPT_DIR/forward-to-bridge.py" "$TMPFILE" "$BRIDGE_SESSION" "$BRIDGE_ENDPOINT"
+    BRIDGE_TRACE_ID="$TRACE_ID" timeout 5 python3 "$SCRIPT_DIR/forward-to-bridge.py" "$TMPFILE" "$BRIDGE_SESSION" "$BRIDGE_ENDPOINT" $WAIT_MS
     rm -f "$TMPFILE"
 ) &
 
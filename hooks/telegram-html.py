@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Markdown to Telegram HTML, and markup-safe message splitting.
+
+Shared by the Stop hook (forward-to-bridge.py, hook-agent.py) and the bridge
+(loaded from hooks/ like transcript-tail.py). Each function is one linear
+scan: a multi-hundred-KB diff or log is no longer rescanned once per markdown
+construct and once more per code block placeholder.
+"""
+
+import bisect
+import re
+
+# One alternation, tried left to right at each position. Bold and italic may
+# contain whole code spans, never half of one, so `a*b` stays code.
+MARKDOWN_RE = re.compile(
+    r"```(?P<lang>\w*)\n?(?P<block>.*?)```"                        # Fenced code block
+    r"|`(?P<code>[^`\n]+)`"                                         # Inline code
+    r"|\*\*(?P<bold>(?:`[^`\n]+`|[^`\n])+?)\*\*"                    # Bold (one line)
+    r"|(?<!\*)\*(?P<italic>(?:`[^`\n]+`|[^*`\n])+)\*(?!\*)",        # Italic (one line, not **)
+    re.DOTALL,
+)
+
+# Tags and entities: a split never lands inside one
+MARKUP_RE = re.compile(r"<(/?)([a-zA-Z][\w-]*)[^>]*>|&#?\w+;")
+BREAKS = ("\n\n", "\n", " ")  # Preferred cut points, best first
+
+
+def esc(s):
+    """Escape HTML special characters."""
+    return s.replace('&', '&amp;').replace('<', '&lt;').replace('>', '&gt;')
+
+
+def markdown_to_html(text):
+    """Convert markdown to Telegram-compatible HTML."""
+    out = []
+    last = 0
+    for m in MARKDOWN_RE.finditer(text):
+        out.append(esc(text[last:m.start()]))
+        last = m.end()
+        if m.group("block") is not None:
+            lang, code = m.group("lang"), esc(m.group("block").strip())
+            out.append(f'<pre><code class="language-{lang}">{code}</code></pre>' if lang else f"<pre>{code}</pre>")
+        elif m.group("code") is not None:
+            out.append(f"<code>{esc(m.group('code'))}</code>")
+        elif m.group("bold") is not None:
+            out.append(f"<b>{markdown_to_html(m.group('bold'))}</b>")
+        else:
+            out.append(f"<i>{markdown_to_html(m.group('italic'))}</i>")
+    out.append(esc(text[last:]))
+    return "".join(out)
+
+
+def _closers(stack):
+    return "".join(f"</{name}>" for name, _ in reversed(stack))
+
+
+def _apply(stack, closing, name, tag):
+    """Open-tag stack after one tag (entities leave it unchanged)."""
+    if name is None:
+        return stack
+    if not closing:
+        return stack + ((name, tag),)
+    for i in range(len(stack) - 1, -1, -1):
+        if stack[i][0] == name:
+            return stack[:i]
+    return stack
+
+
+def split_html(html, max_len=4096):
+    """Split HTML into chunks of at most max_len chars without breaking markup.
+
+    Cut points follow the plain-text rule: blank line, then newline, then
+    space (each only past half the chunk), else a hard cut. A cut never lands
+    inside a tag or entity. Tags still open at a cut are closed at the end of
+    the chunk and reopened at the start of the next, so a long <pre> block
+    stays valid in every message.
+    """
+    if len(html) <= max_len:
+        return [html]
+
+    markup = [(m.start(), m.end(), m.group(1) == "/", m.group(2), m.group(0)) for m in MARKUP_RE.finditer(html)]
+    starts = [t[0] for t in markup]
+    n = len(html)
+    chunks = []
+    stack = ()  # ((name, open_tag), ...) open at `start`
+    start = 0
+
+    while start < n:
+        prefix = "".join(tag for _, tag in stack)
+        best = {}  # break -> (cut, stack at cut)
+        cur, pos = stack, start
+        k = bisect.bisect_left(starts, start)
+        while True:
+            token = markup[k] if k < len(markup) else None
+            run_end = token[0] if token else n
+            limit = start + max_len - len(prefix) - len(_closers(cur))
+            end = min(run_end, limit)
+            for brk in BREAKS:
+                p = html.rfind(brk, pos, end)
+                if p >= 0:
+                    best[brk] = (p + 1, cur)
+            if run_end > limit:
+                hard = (max(limit, start + 1), cur)
+                break
+            if token is None:
+                hard = None  # The rest fits
+                break
+            t_start, t_end, closing, name, tag = token
+            after = _apply(cur, closing, name, tag)
+            if t_end - start + len(prefix) + len(_closers(after)) > max_len:
+                hard = (t_start, cur) if t_start > start else (t_end, after)
+                break
+            cur, pos, k = after, t_end, k + 1
+
+        if hard is None:
+            chunks.append(prefix + html[start:])
+            break
+        cut, cut_stack = hard
+        for brk in BREAKS:
+            if brk in best and best[brk][0] - start > max_len // 2:
+                cut, cut_stack = best[brk]
+                break
+        body = html[start:cut].rstrip()
+        if body:
+            chunks.append(prefix + body + _closers(cut_stack))
+        start, stack = cut, cut_stack
+        while start < n and html[start].isspace():
+            start += 1
+
+    return chunks
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""Incremental transcript reader for the Stop hook.
+
+Usage: transcript-tail.py <transcript_path> <offset_file> [--wait SECONDS]
+
+Prints the assistant text written after the last user message.
+
+The offset file (kept next to `pending`) remembers how far the transcript
+was scanned and where the last user message starts, so each Stop event only
+reads bytes appended since the previous one plus the current turn, instead of
+re-reading a transcript that can grow to tens of MB.
+
+With --wait, the Stop hook may fire before the assistant message is flushed.
+Instead of sleeping a fixed interval between retries, the helper watches the
+transcript (inotify on Linux, kqueue on macOS/BSD, 50 ms stat polling
+elsewhere) and re-reads as soon as it is written. The time spent waiting is
+saved as `wait_ms` in the offset file so the hook can report it to the bridge.
+
+Exit codes:
+  0 - text printed
+  1 - no assistant text yet (hook retries)
+  2 - transcript has no user message (hook clears pending and exits)
+"""
+
+import ctypes
+import ctypes.util
+import json
+import os
+import select
+import sys
+import time
+
+USER_MARK = b'"type":"user"'
+ASSISTANT_MARK = b'"type":"assistant"'
+
+POLL_INTERVAL = 0.05  # Only used when no file-event API is available
+IN_MODIFY = 0x002
+IN_CLOSE_WRITE = 0x008
+IN_NONBLOCK = 0o4000
+IN_CLOEXEC = 0o2000000
+
+
+def load_state(offset_file, transcript_path, size):
+    """Saved scan state, or a fresh one if the transcript changed or shrank."""
+    try:
+        with open(offset_file) as f:
+            state = json.load(f)
+        if state.get("path") == transcript_path and 0 <= state.get("scanned", -1) <= size:
+            return state
+    except (OSError, ValueError, AttributeError):
+        pass
+    return {"path": transcript_path, "scanned": 0, "last_user": None}
+
+
+def save_state(offset_file, state):
+    tmp = f"{offset_file}.tmp"
+    try:
+        fd = os.open(tmp, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o600)
+        with os.fdopen(fd, "w") as f:
+            json.dump(state, f)
+        os.replace(tmp, offset_file)
+    except OSError as e:
+        print(f"[hook] Could not save transcript offset: {e}", file=sys.stderr)
+
+
+def scan_new_lines(f, state):
+    """Advance state over complete lines appended since the last scan."""
+    f.seek(state["scanned"])
+    data = f.read()
+    end = data.rfind(b"\n") + 1  # A trailing partial line is rescanned next time
+    pos = 0
+    while pos < end:
+        nl = data.index(b"\n", pos)
+        if USER_MARK in data[pos:nl]:
+            state["last_user"] = state["scanned"] + pos
+        pos = nl + 1
+    state["scanned"] += end
+
+
+def assistant_text(f, start):
+    """Join assistant text blocks from `start` to the end of the file."""
+    f.seek(start)
+    parts = []
+    for line in f:
+        if ASSISTANT_MARK not in line:
+            continue
+        try:
+            content = json.loads(line).get("message", {}).get("content", [])
+        except ValueError:
+            continue  # Line still being written
+        if not isinstance(content, list):
+            continue
+        for item in content:
+            if isinstance(item, dict) and item.get("type") == "text":
+                text = item.get("text")
+                if text and text != "(no content)":
+                    parts.append(text)
+    return "\n\n".join(parts)
+
+
+class TranscriptWatcher:
+    """Block until the transcript is written to, or a timeout passes.
+
+    Picks inotify, then kqueue, then stat polling. The watch is armed before
+    the first read, so a write that lands between a read and wait() still
+    wakes the waiter.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self.kind = "poll"
+        self._fd = None
+        self._kq = None
+        self._last_size = self._size()
+        self._init_inotify() or self._init_kqueue()
+
+    def _size(self):
+        try:
+            return os.path.getsize(self.path)
+        except OSError:
+            return -1
+
+    def _init_inotify(self):
+        if not sys.platform.startswith("linux"):
+            return False
+        try:
+            libc = ctypes.CDLL(ctypes.util.find_library("c") or "libc.so.6", use_errno=True)
+            fd = libc.inotify_init1(IN_NONBLOCK | IN_CLOEXEC)
+            if fd < 0:
+                return False
+            if libc.inotify_add_watch(fd, os.fsencode(self.path), IN_MODIFY | IN_CLOSE_WRITE) < 0:
+                os.close(fd)
+                return False
+        except (OSError, AttributeError):
+            return False
+        self._fd = fd
+        self.kind = "inotify"
+        return True
+
+    def _init_kqueue(self):
+        if not hasattr(select, "kqueue"):
+            return False
+        try:
+            self._fd = os.open(self.path, os.O_RDONLY)
+            self._kq = select.kqueue()
+            self._event = select.kevent(
+                self._fd,
+                filter=select.KQ_FILTER_VNODE,
+                flags=select.KQ_EV_ADD | select.KQ_EV_CLEAR,
+                fflags=select.KQ_NOTE_WRITE | select.KQ_NOTE_EXTEND,
+            )
+            self._kq.control([self._event], 0, 0)
+        except OSError:
+            self.close()
+            return False
+        self.kind = "kqueue"
+        return True
+
+    def wait(self, timeout):
+        """Return True if the file changed within `timeout` seconds."""
+        if timeout <= 0:
+            return False
+        if self.kind == "inotify":
+            ready, _, _ = select.select([self._fd], [], [], timeout)
+            if not ready:
+                return False
+            try:
+                while os.read(self._fd, 4096):  # Drain queued events
+                    pass
+            except BlockingIOError:
+                pass
+            return True
+        if self.kind == "kqueue":
+            return bool(self._kq.control(None, 1, timeout))
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            time.sleep(min(POLL_INTERVAL, max(0, deadline - time.monotonic())))
+            size = self._size()
+            if size != self._last_size:
+                self._last_size = size
+                return True
+        return False
+
+    def close(self):
+        if self._kq is not None:
+            self._kq.close()
+            self._kq = None
+        if self._fd is not None:
+            os.close(self._fd)
+            self._fd = None
+
+
+def extract(transcript_path, offset_file):
+    """One read attempt. Returns (exit_code, text, state)."""
+    try:
+        size = os.path.getsize(transcript_path)
+        with open(transcript_path, "rb") as f:
+            state = load_state(offset_file, transcript_path, size)
+            scan_new_lines(f, state)
+            if state["last_user"] is None:
+                return 2, "", state
+            text = assistant_text(f, state["last_user"])
+    except OSError as e:
+        print(f"[hook] Could not read transcript: {e}", file=sys.stderr)
+        return 1, "", None
+    return (0 if text else 1), text, state
+
+
+def read_reply(transcript_path, offset_file, wait=0.0):
+    """Extract the current reply, waiting up to `wait` seconds for it to land.
+
+    Returns (exit_code, text, wait_ms); wait_ms is None when wait is 0.
+    Shared by the CLI and the resident hook agent.
+    """
+    start = time.monotonic()
+    watcher = TranscriptWatcher(transcript_path) if wait else None
+    try:
+        while True:
+            rc, text, state = extract(transcript_path, offset_file)
+            remaining = wait - (time.monotonic() - start)
+            if rc != 1 or watcher is None or not watcher.wait(remaining):
+                break
+    finally:
+        if watcher:
+            watcher.close()
+    wait_ms = int((time.monotonic() - start) * 1000) if wait else None
+    if state is not None:
+        if wait_ms is not None:
+            state["wait_ms"] = wait_ms
+        save_state(offset_file, state)
+    return rc, text, wait_ms
+
+
+def main():
+    args = sys.argv[1:]
+    wait = 0.0
+    if len(args) == 4 and args[2] == "--wait":
+        try:
+            wait = max(0.0, float(args[3]))
+        except ValueError:
+            args = []
+        args = args[:2]
+    if len(args) != 2:
+        print("Usage: transcript-tail.py <transcript_path> <offset_file> [--wait SECONDS]", file=sys.stderr)
+        return 1
+    transcript_path, offset_file = args
+
+    rc, text, _ = read_reply(transcript_path, offset_file, wait)
+    if rc == 0:
+        sys.stdout.write(text)
+    return rc
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -5,6 +5,7 @@
 # Usage:
 #   TEST_BOT_TOKEN='...' ./test.sh                    # Basic tests (mock chat ID)
 #   TEST_BOT_TOKEN='...' TEST_CHAT_ID='...' ./test.sh # Full e2e (real Telegram messages)
+#   BENCH=1 ./test.sh                                  # Load/latency benchmark (mock Telegram API)
 #
 # Environment:
 #   TEST_BOT_TOKEN  - Required: Your test bot token from @BotFather
@@ -445,6 +446,148 @@ print('OK')
     fi
 }
 
+test_sandbox_container_reuse() {
+    info "Testing sandbox container reuse, idle pause and image prefetch..."
+    if python3 -c "
+import os, sys, json, tempfile, time
+from pathlib import Path
+tmp = Path(tempfile.mkdtemp())
+(tmp / 'docker').write_text('''#!/usr/bin/env python3
+import json, os, sys
+state_file, args = os.environ['FAKE_DOCKER_STATE'], sys.argv[1:]
+state = json.load(open(state_file)) if os.path.exists(state_file) else {}
+with open(os.environ['FAKE_DOCKER_LOG'], 'a') as f:
+    f.write(' '.join(args) + chr(10))
+cmd, name = args[0], args[-1]
+if cmd == 'image':
+    sys.exit(0 if state.get('image') else 1)  # image inspect
+if cmd == 'pull':
+    state['image'] = 1
+elif cmd == 'ps':
+    print(chr(10).join(k for k, v in state.items() if k.startswith('claude-worker-') and v == 'paused'))
+elif cmd == 'inspect':
+    if name not in state:
+        sys.exit(1)
+    print(state[name], state.get('label:' + name, ''))
+elif cmd == 'create':
+    created = [a for a in args if a.startswith('--name=')][0][7:]
+    state[created] = 'created'
+    state['label:' + created] = [a for a in args if a.startswith('--label=')][0].split('=', 2)[2]
+elif cmd == 'rm':
+    state.pop(name, None)
+    state.pop('label:' + name, None)
+elif cmd in ('start', 'unpause'):
+    state[name] = 'running'
+elif cmd == 'pause':
+    state[name] = 'paused'
+json.dump(state, open(state_file, 'w'))
+''')
+(tmp / 'docker').chmod(0o755)
+os.environ['PATH'] = str(tmp) + os.pathsep + os.environ['PATH']
+os.environ['FAKE_DOCKER_STATE'] = str(tmp / 'state.json')
+os.environ['FAKE_DOCKER_LOG'] = log = str(tmp / 'log')
+os.environ['SANDBOX_ENABLED'] = '1'
+os.environ['SESSIONS_DIR'] = str(tmp / 'sessions')
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+def calls():
+    lines = Path(log).read_text().splitlines()
+    Path(log).write_text('')
+    return lines
+
+def state():
+    return json.load(open(os.environ['FAKE_DOCKER_STATE']))
+
+s = bridge.SandboxContainers(pause_idle=0.05)
+
+# First start creates the container once; the CLI runs through docker exec
+cmd = s.start_cmd('w1')
+assert cmd == 'docker exec -it -w /workspace claude-worker-w1 claude --dangerously-skip-permissions', cmd
+log1 = calls()
+create = [c for c in log1 if c.startswith('create ')]
+assert len(create) == 1 and create[0].endswith(bridge.SANDBOX_IMAGE + ' sleep infinity'), log1
+assert '-e=BRIDGE_SESSION=w1' in create[0] and '-w /workspace' in create[0], create
+assert 'start claude-worker-w1' in log1, log1
+assert state()['claude-worker-w1'] == 'running'
+
+# Restart of a running container: inspect only, no create/run
+s.start_cmd('w1')
+assert [c.split()[0] for c in calls()] == ['inspect'], 'reuse should only inspect'
+assert s.stats['reused'] == 1 and s.stats['created'] == 1
+
+# Stopped container is started, not recreated
+st = state(); st['claude-worker-w1'] = 'exited'; json.dump(st, open(os.environ['FAKE_DOCKER_STATE'], 'w'))
+s.start_cmd('w1')
+assert [c.split()[0] for c in calls()] == ['inspect', 'start']
+
+# Changed mounts: the old container is removed and created with the new args
+bridge.SANDBOX_EXTRA_MOUNTS = [(str(tmp), '/extra', True)]
+s.start_cmd('w1')
+assert [c.split()[0] for c in calls()] == ['inspect', 'rm', 'create', 'start']
+assert s.stats['recreated'] == 1 and s.stats['created'] == 2
+s.start_cmd('w1')
+assert [c.split()[0] for c in calls()] == ['inspect'], 'same config is reused'
+
+# Idle workers with nothing pending are paused; the next message unpauses
+bridge.is_pending = lambda name: True
+time.sleep(0.1)
+s.pause_idle_workers(['w1'])
+assert state()['claude-worker-w1'] == 'running', 'pending worker must not pause'
+bridge.is_pending = lambda name: False
+s.pause_idle_workers(['w1'])
+assert state()['claude-worker-w1'] == 'paused' and s.stats['paused'] == 1
+s.pause_idle_workers(['w1'])
+assert s.stats['paused'] == 1, 'already paused'
+s.touch('w1')
+assert state()['claude-worker-w1'] == 'running' and s.stats['unpaused'] == 1
+calls()
+s.touch('w1')
+assert calls() == [], 'touch of a running worker costs no docker call'
+
+# A message arriving between the pending check and the pause gets unpaused
+time.sleep(0.1)
+real_docker = s._docker
+def docker_then_touch(*args):
+    ok = real_docker(*args)
+    if args[0] == 'pause':
+        s.touch('w1')  # Sees no pause yet, so does not unpause
+    return ok
+s._docker = docker_then_touch
+s.pause_idle_workers(['w1'])
+s._docker = real_docker
+assert state()['claude-worker-w1'] == 'running', 'raced pause is undone'
+assert 'w1' not in s._paused and s.stats['paused'] == 1 and s.stats['unpaused'] == 2
+
+# A new process adopts containers the old one paused: the next message unpauses
+st = state(); st['claude-worker-w1'] = 'paused'; json.dump(st, open(os.environ['FAKE_DOCKER_STATE'], 'w'))
+fresh = bridge.SandboxContainers(pause_idle=60)
+assert fresh.adopt_paused() == 1 and state()['claude-worker-w1'] == 'paused'
+fresh.touch('w1')
+assert state()['claude-worker-w1'] == 'running' and fresh.stats['unpaused'] == 1
+st = state(); st['claude-worker-w1'] = 'paused'; json.dump(st, open(os.environ['FAKE_DOCKER_STATE'], 'w'))
+assert bridge.SandboxContainers(pause_idle=0).adopt_paused() == 1
+assert state()['claude-worker-w1'] == 'running', 'idle pause off: unpaused at startup'
+calls()
+
+# Prefetch pulls a missing image, then finds it
+assert s.prefetch_image()
+assert 'pull ' + bridge.SANDBOX_IMAGE in calls()
+assert s.prefetch_image() and not any(c.startswith('pull') for c in calls())
+
+# SANDBOX_REUSE=0 keeps docker run --rm
+bridge.SANDBOX_REUSE = False
+cmd = s.start_cmd('w2')
+assert cmd.startswith('docker run -it --name=claude-worker-w2 --rm'), cmd
+assert calls() == []
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Sandbox containers reused across restarts, idle pause and prefetch work"
+    else
+        fail "Sandbox container reuse test failed"
+    fi
+}
+
 test_bridge_starts() {
     info "Starting bridge on port $PORT..."
 
@@ -1804,7 +1947,6 @@ bridge.worker_manager.get_registered_sessions = lambda registered=None: {'alice'
 bridge.worker_manager.is_online = lambda name, session=None: True
 bridge.worker_manager.send = lambda name, message, chat_id=None, session=None: True
 bridge.worker_set_pending = lambda name, chat_id: None
-bridge.send_typing_loop = lambda chat_id, name: None
 
 def boom(*args, **kwargs):
     raise AssertionError('tmux_prompt_empty should not be called for exec backends')
@@ -2014,6 +2156,146 @@ print('OK')
     fi
 }
 
+test_adapter_queue_ordered_merge() {
+    info "Testing non-interactive messages queue per worker and merge..."
+
+    if python3 -c "
+import json, subprocess, sys, tempfile, time
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp(dir='/tmp'))
+log = tmp / 'runs.jsonl'
+# Fake adapter: records its prompt and how many runs overlapped, takes 0.3s
+script = tmp / 'adapter.py'
+script.write_text(chr(10).join([
+    'import json, sys, time',
+    'from pathlib import Path',
+    'active = Path(sys.argv[2] + \".active\")',
+    'n = len(active.read_text()) if active.exists() else 0',
+    'active.write_text(\"x\" * (n + 1))',
+    'time.sleep(0.3)',
+    'with open(sys.argv[2], \"a\") as f:',
+    '    f.write(json.dumps({\"prompt\": sys.argv[1], \"overlap\": n}) + chr(10))',
+    'active.write_text(\"x\" * n)',
+]))
+q = bridge.AdapterQueue(depth=5)
+run = lambda prompt: subprocess.run([sys.executable, str(script), prompt, str(log)])
+
+def wait_idle(name):
+    deadline = time.time() + 5
+    while time.time() < deadline and q.depth_of(name) != (0, 0):
+        time.sleep(0.02)
+
+# Burst of 6: first runs alone, the 5 queued behind it merge into one run
+messages = [f'msg {i}' for i in range(6)]
+assert all(q.submit('alice', m, run) for m in messages)
+time.sleep(0.1)
+assert q.depth_of('alice') == (5, 1), q.depth_of('alice')
+assert not q.submit('alice', 'overflow', run), 'depth limit refuses'
+assert q.is_full('alice')
+wait_idle('alice')
+runs = [json.loads(l) for l in log.read_text().splitlines()]
+assert [r['prompt'] for r in runs] == ['msg 0', chr(10).join(['msg 1', '', 'msg 2', '', 'msg 3', '', 'msg 4', '', 'msg 5'])], runs
+assert all(r['overlap'] == 0 for r in runs), 'one adapter run at a time'
+assert q.stats['runs'] == 2 and q.stats['merged'] == 5 and q.stats['rejected'] == 1
+
+# Merging off: strict one-by-one order; discard drops only waiting messages
+log.unlink()
+q = bridge.AdapterQueue(depth=5, merge=False)
+for m in ('a', 'b', 'c'):
+    q.submit('bob', m, run)
+time.sleep(0.1)
+assert q.discard('bob') == 2
+wait_idle('bob')
+assert [json.loads(l)['prompt'] for l in log.read_text().splitlines()] == ['a']
+
+lines = bridge.format_progress_lines('bob', True, 'codex', True, True, 'codex (non-interactive)', queue=(3, 1))
+assert any(l.startswith('Queue: 3 waiting, 1 in flight') for l in lines), lines
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Non-interactive messages run one at a time per worker and merge"
+    else
+        fail "Adapter queue test failed"
+    fi
+}
+
+test_adapter_agent_resident() {
+    info "Testing resident adapter agent runs codex turns in one process..."
+
+    if python3 -c "
+import json, os, tempfile, threading, time
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp(dir='/tmp'))
+# Fake codex: echoes its resume id and stdin as the agent message
+(tmp / 'bin').mkdir()
+fake = tmp / 'bin' / 'codex'
+fake.write_text(chr(10).join([
+    '#!/usr/bin/env python3',
+    'import json, sys',
+    'args, prompt = sys.argv[1:], sys.stdin.read()',
+    'resumed = args[args.index(\"resume\") + 1] if \"resume\" in args else \"\"',
+    'print(json.dumps({\"type\": \"thread.started\", \"thread_id\": resumed or \"thread-1\"}))',
+    'print(json.dumps({\"type\": \"item.completed\", \"item\": {\"type\": \"agent_message\", \"text\": f\"{resumed}|{prompt}\"}}))',
+]))
+fake.chmod(0o755)
+os.environ['PATH'] = f'{tmp}/bin:' + os.environ['PATH']
+
+replies, peers = [], set()
+class Bridge(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        peers.add(self.client_address)
+        replies.append(json.loads(self.rfile.read(int(self.headers['Content-Length']))))
+        self.send_response(200)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+    def log_message(self, *a):
+        pass
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Bridge)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+bridge_url = f'http://127.0.0.1:{server.server_address[1]}'
+
+bridge.ADAPTER_AGENT = True
+sessions = tmp / 'sessions'
+adapter = Path(bridge.__file__).parent / 'hooks' / 'codex-tmux-adapter.py'
+q = bridge.AdapterQueue(depth=5, merge=False)
+bridge.adapter_queue = q
+for m in ('one', 'two', 'three'):
+    assert bridge.queue_adapter('codex', adapter, 'alice', m, bridge_url, sessions)
+deadline = time.time() + 10
+while time.time() < deadline and len(replies) < 3:
+    time.sleep(0.05)
+agent = bridge.adapter_agents._agents['alice']
+pid = agent.proc.pid
+assert [r['text'] for r in replies] == ['|one', 'thread-1|two', 'thread-1|three'], replies
+assert all(r['session'] == 'alice' and r['source'] == 'codex' for r in replies)
+assert len(peers) == 1, f'replies should share one keep-alive connection: {peers}'
+assert (sessions / 'alice' / 'codex_session_id').read_text() == 'thread-1'
+assert oct(agent.socket_path.stat().st_mode & 0o777) == '0o600'
+
+# Stopped agent (e.g. /relaunch) restarts on the next message; missing script falls back to cold runs
+bridge.adapter_agents.stop('alice')
+assert not agent.socket_path.exists()
+bridge.ADAPTER_AGENT_SCRIPT = tmp / 'missing.py'
+assert bridge.queue_adapter('codex', adapter, 'alice', 'cold', bridge_url, sessions)
+deadline = time.time() + 10
+while time.time() < deadline and len(replies) < 4:
+    time.sleep(0.05)
+assert replies[-1]['text'] == 'thread-1|cold', replies[-1]
+bridge.adapter_agents.stop_all()
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Resident adapter agent keeps session id and bridge connection"
+    else
+        fail "Adapter agent test failed"
+    fi
+}
+
 test_codex_pause_clears_pending() {
     info "Testing codex /pause clears pending without tmux..."
 
@@ -2126,7 +2408,7 @@ class FakeTelegram:
         return {'ok': True}
 
 router = bridge.CommandRouter(FakeTelegram(), bridge.worker_manager)
-router.route_message = lambda name, text, chat_id, msg_id, one_off=False: called.append(name)
+router.deliver_to_worker = lambda name, session, text, chat_id, trace_id=None, check_accepted=True: called.append(name) or (None, False)
 router.route_to_all('hello team', 123, 456)
 
 assert set(called) == {'alice', 'bob'}, f'expected broadcast to include codex worker, got {called}'
@@ -2139,6 +2421,357 @@ print('OK')
     fi
 }
 
+test_broadcast_fan_out() {
+    info "Testing @all and notify fan out in parallel with one summary..."
+
+    if python3 -c "
+import os, sys, time, threading, tempfile
+from pathlib import Path
+os.environ['SESSIONS_DIR'] = tempfile.mkdtemp()
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+names = [f'w{i}' for i in range(12)]
+snapshots = []
+def registered(registered=None):
+    snapshots.append(1)
+    return {n: {'backend': 'claude', 'tmux': f'claude-test-{n}'} for n in names}
+bridge.worker_manager.get_registered_sessions = registered
+bridge.worker_manager.is_online = lambda name, session=None: name != 'w3'
+active = []
+peak = [0]
+lock = threading.Lock()
+def send(name, text, chat_id=None, session=None):
+    with lock:
+        active.append(name)
+        peak[0] = max(peak[0], len(active))
+    time.sleep(0.3)
+    with lock:
+        active.remove(name)
+    return name != 'w5'
+bridge.worker_manager.send = send
+bridge.tmux_prompt_empty = lambda tmux_name, timeout=0.5: True
+
+class FakeTelegram:
+    def __init__(self):
+        self.replies, self.reactions = [], []
+    def send_message(self, chat_id, text, *args, **kwargs):
+        self.replies.append(text)
+        return {'ok': True}
+    def set_reaction(self, chat_id, msg_id, reaction):
+        self.reactions.append(msg_id)
+
+tg = FakeTelegram()
+router = bridge.CommandRouter(tg, bridge.worker_manager)
+started = time.monotonic()
+router.route_to_all('hello team', 123, 456)
+elapsed = time.monotonic() - started
+
+# 11 online workers x 0.3s: serial would be 3.3s; 8 at a time is two rounds
+assert elapsed < 1.5, f'broadcast took {elapsed:.2f}s'
+assert peak[0] == bridge.BROADCAST_CONCURRENCY, peak
+assert len(snapshots) == 1, f'one registry snapshot, got {len(snapshots)}'
+assert tg.reactions == [456], tg.reactions
+assert len(tg.replies) == 1, tg.replies
+summary = tg.replies[0]
+assert summary.startswith('Shared with w0, w1, w2, w4, w6'), summary
+assert 'w3' not in summary and 'Could not send to W5' in summary, summary
+for n in names:
+    if n not in ('w3', 'w5'):
+        assert bridge.is_pending(n), n
+assert not bridge.is_pending('w5')
+
+# All delivered: one short summary, no per-worker replies
+bridge.worker_manager.send = lambda name, text, chat_id=None, session=None: True
+tg.replies.clear()
+router.route_to_all('again', 123, None)
+assert tg.replies == ['Shared with ' + ', '.join(n for n in names if n != 'w3') + '.'], tg.replies
+
+# Spans recorded on the fan-out threads land on the message's trace
+tid = bridge.tracer.begin(123, 457)
+router.route_to_all('traced', 123, None)
+bridge.tracer.end()
+spans = bridge.tracer.get(tid)['spans']
+assert [s['stage'] for s in spans[:2]] == ['received', 'broadcast'], spans
+assert sorted(s['worker'] for s in spans if s['stage'] == 'routed') == sorted(n for n in names if n != 'w3'), spans
+
+# /notify: chats in parallel, session dirs scanned once
+for i, n in enumerate(['a', 'b', 'c', 'd']):
+    bridge.set_pending(n, 1000 + i)
+sent = []
+def api(method, data):
+    if method != 'sendMessage':
+        return {'ok': True}  # Typing ticker for the pending workers
+    time.sleep(0.3)
+    sent.append(data['chat_id'])
+    return {'ok': data['chat_id'] != '1003'}
+bridge.telegram_api = api
+started = time.monotonic()
+assert bridge.notify_all_chats('tunnel down') == 4
+assert time.monotonic() - started < 0.8
+assert sorted(sent) == ['1000', '1001', '1002', '1003', '123']
+scans = []
+real_iterdir = Path.iterdir
+Path.iterdir = lambda self: scans.append(self) or real_iterdir(self)
+bridge.set_pending('e', 2000)
+assert '2000' in bridge.get_all_chat_ids() and scans == [], 'cached after the first scan'
+Path.iterdir = real_iterdir
+bridge.forget_chat_id('e')
+assert '2000' not in bridge.get_all_chat_ids(), 'an ended worker drops its chat'
+assert not bridge.get_chat_id_file('e').exists()
+bridge.known_chat_ids.clear()
+assert '2000' not in bridge.get_all_chat_ids(), 'a rescan does not bring it back'
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "@all and notify fan out with one snapshot and one summary"
+    else
+        fail "Broadcast fan-out test failed"
+    fi
+}
+
+test_worker_hosts_sharding() {
+    info "Testing worker hosts: RPC channel, placement, aggregated registry..."
+
+    if TMUX_CONTROL=0 python3 -c "
+import os, sys, json, socket, threading, tempfile, time
+os.environ['SESSIONS_DIR'] = tempfile.mkdtemp()
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+sock = socket.socket(); sock.bind(('127.0.0.1', 0)); port = sock.getsockname()[1]; sock.close()
+bridge.HOST_AGENT = True
+bridge.HOST_SECRET = 'fleet-secret'
+real_rpc = bridge.handle_host_rpc
+
+# Fake host agent behind the real /rpc endpoint
+calls = []
+remote = {'r1': {'tmux': 'claude-r1', 'backend': 'claude'}}
+def fake_rpc(method, params):
+    calls.append((method, params))
+    if method == 'status':
+        return {'sessions': remote, 'workers': [{'name': n, 'protocol': 'tmux', 'address': i['tmux']} for n, i in remote.items()],
+                'load': {'workers': len(remote), 'load': 0.1, 'mem_free_mb': 8000}}
+    if method == 'hire':
+        remote[params['name']] = {'tmux': 'claude-' + params['name'], 'backend': params['backend']}
+        return [True, None]
+    if method == 'end':
+        remote.pop(params['name'])
+        return [True, None]
+    if method == 'send' and params['name'] == 'slow':
+        time.sleep(1.5)
+    if method == 'put_file':
+        return '/remote/inbox/' + bridge.base64.b64decode(params['data']).decode() + params['ext']
+    if method == 'get_file':
+        if params['path'] != '/remote/out/chart.png':
+            raise ValueError('Photo not found: ' + params['path'])
+        return bridge.base64.b64encode(b'remote-png').decode()
+    return method in ('send', 'is_online')
+bridge.handle_host_rpc = fake_rpc
+server = bridge.ReuseAddrServer(('127.0.0.1', port), bridge.Handler)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+
+bridge.worker_hosts = bridge.WorkerHosts({'box2': f'http://127.0.0.1:{port}'})
+wm = bridge.worker_manager
+wm.scan_tmux_sessions = lambda: {'loc': {'tmux': 'claude-loc', 'backend': 'claude'}}
+bridge.tmux_exists = lambda name: False
+bridge.host_load = lambda workers: {'workers': workers, 'load': 3.0, 'mem_free_mb': 8000}
+
+# One registry across hosts, remote workers tagged with their host (as of the last poll)
+bridge.worker_hosts.poll()
+registered = wm.refresh()
+assert set(registered) == {'loc', 'r1'} and registered['r1']['host'] == 'box2', registered
+assert 'host' not in registered['loc']
+assert any('r1 (' in l and 'host=box2' in l for l in bridge.format_team_lines(registered, 'loc'))
+assert any(w.get('host') == 'box2' and w['name'] == 'r1' for w in wm.get_workers())
+
+# Placement: local is loaded (1 + 2x3.0) and box2 idle (1 + 2x0.1)
+ok, err = wm.hire('newbie', 'claude', chat_id=42)
+assert ok, err
+assert ('hire', {'name': 'newbie', 'backend': 'claude', 'chat_id': 42}) in calls
+assert wm.get_registered_sessions()['newbie']['host'] == 'box2'
+ok, err = wm.hire('r1', 'claude')
+assert not ok and 'already exists' in err
+
+# Files cross hosts over /rpc: inbound copied to the host's inbox, tagged replies fetched from it
+local = bridge.ensure_inbox_dir('newbie') / 'abc.png'
+local.write_bytes(b'pic')
+assert bridge.hand_file_to_worker('newbie', str(local)) == '/remote/inbox/pic.png' and not local.exists()
+assert bridge.hand_file_to_worker('loc', '/tmp/here.png') == '/tmp/here.png', 'local worker keeps its path'
+photos, notices = [], []
+bridge.send_photo = lambda chat_id, path, caption=None: photos.append((path.name, path.read_bytes())) or True
+bridge.outbound.call = lambda chat_id, method, data: notices.append(data['text'])
+bridge.send_media('newbie', 42, [('/remote/out/chart.png', ''), ('/remote/out/gone.png', '')], [])
+assert photos == [('chart.png', b'remote-png')], photos
+assert notices == ['newbie: [Image failed: /remote/out/gone.png]'], notices
+assert not [p for p in bridge.ensure_inbox_dir('newbie').iterdir() if p.name.startswith('.host-')], 'fetched copies removed'
+assert bridge.plaintext_rpc_warnings() == [], 'loopback host needs no https'
+
+# Messages to a remote worker: pending + trace on the front, send over RPC
+bridge.worker_set_pending('r1', 42, 'trace123')
+assert wm.is_online('r1') and wm.send('r1', 'hello', 42)
+assert ('send', {'name': 'r1', 'message': 'hello', 'chat_id': 42, 'trace_id': 'trace123'}) in calls
+host = bridge.worker_hosts.hosts['box2']
+assert len(host._idle) == 1, 'sequential calls reuse one kept-alive connection'
+
+# /end on the remote host clears the front's pending
+ok, err = wm.end('r1')
+assert ok and not bridge.is_pending('r1') and 'r1' not in wm.get_registered_sessions()
+
+# A busy host loses to an idle local machine; short memory excludes a host
+bridge.host_load = lambda workers: {'workers': workers, 'load': 0.0, 'mem_free_mb': 8000}
+assert bridge.worker_hosts.place(0) is None
+host.load = {'load': 0.0, 'mem_free_mb': 100}
+bridge.host_load = lambda workers: {'workers': 9, 'load': 1.0, 'mem_free_mb': 8000}
+assert bridge.worker_hosts.place(9) is None
+
+# Wrong secret is refused; unreachable hosts keep their last listing and get no hires
+bad = bridge.RemoteHost('bad', f'http://127.0.0.1:{port}', secret='nope')
+try:
+    bad.call('status'); raise SystemExit('wrong secret accepted')
+except bridge.HostError as e:
+    assert '403' in str(e)
+gone = bridge.RemoteHost('gone', 'http://127.0.0.1:1')
+gone.sessions = {'old': {'backend': 'claude'}}
+gone.poll()
+assert not gone.online and 'old' in gone.sessions
+
+# A send slower than the RPC timeout is reported, never run twice on the host
+slow = bridge.RemoteHost('box2', f'http://127.0.0.1:{port}', secret='fleet-secret', timeout=0.5)
+slow.call('status')
+try:
+    slow.call('send', name='slow', message='m'); raise SystemExit('timeout not reported')
+except bridge.HostError as e:
+    assert 'may still have run' in str(e), e
+time.sleep(1.5)
+assert [c[0] for c in calls if c[1].get('name') == 'slow'] == ['send'], calls
+assert slow.online
+
+# The registry is served from the last poll: an unreachable host costs hire/end nothing
+bridge.worker_hosts = bridge.WorkerHosts({'gone': 'http://127.0.0.1:1'})
+bridge.worker_hosts.hosts['gone'].call = lambda *a, **k: (time.sleep(2), {})[1]
+started = time.time()
+wm.refresh()
+assert time.time() - started < 0.5
+server.shutdown()
+
+# Agent side: send marks pending on the host too, names are validated
+bridge.handle_host_rpc = real_rpc
+sent = []
+wm.send = lambda name, message, chat_id=None, session=None: sent.append((name, message)) or True
+assert real_rpc('send', {'name': 'w1', 'message': 'hi', 'chat_id': 7, 'trace_id': 't1'})
+assert sent == [('w1', 'hi')] and bridge.is_pending('w1') and bridge.read_trace_id('w1') == 't1'
+try:
+    real_rpc('end', {'name': '../x'}); raise SystemExit('bad name accepted')
+except ValueError:
+    pass
+stored = real_rpc('put_file', {'name': 'w1', 'ext': '.png', 'data': bridge.base64.b64encode(b'img').decode()})
+assert stored.startswith(str(bridge.get_inbox_dir('w1'))) and stored.endswith('.png')
+assert open(stored, 'rb').read() == b'img' and oct(os.stat(stored).st_mode)[-3:] == '600'
+assert bridge.base64.b64decode(real_rpc('get_file', {'name': 'w1', 'path': stored, 'kind': 'photo'})) == b'img'
+try:
+    real_rpc('get_file', {'name': 'w1', 'path': '/etc/passwd', 'kind': 'document'}); raise SystemExit('unsafe path served')
+except ValueError:
+    pass
+bridge.worker_hosts = bridge.WorkerHosts({'far': 'http://10.0.0.5:8090', 'tls': 'https://10.0.0.6'})
+assert [w.split(' is ')[0] for w in bridge.plaintext_rpc_warnings()] == ['Warning: Worker host far http://10.0.0.5:8090']
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Worker hosts: one registry, load-based hires, RPC over kept-alive connections"
+    else
+        fail "Worker hosts sharding test failed"
+    fi
+}
+
+test_hot_restart_handoff() {
+    info "Testing hot restart: socket handoff, no refused connections, drain..."
+
+    if python3 -c "
+import os, signal, sys, time, threading, tempfile, http.client
+from pathlib import Path
+tmp = Path(tempfile.mkdtemp())
+os.environ['SESSIONS_DIR'] = str(tmp / 'sessions')
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+# Stand-in for the new bridge: adopts the fd, says ready, answers 'new'
+child = tmp / 'child.py'
+child.write_text('''
+import os, socket, threading
+from http.server import HTTPServer, BaseHTTPRequestHandler
+class H(BaseHTTPRequestHandler):
+    def do_GET(self):
+        self.send_response(200); self.send_header('Content-Length', '3'); self.end_headers(); self.wfile.write(b'new')
+    def log_message(self, *a): pass
+s = HTTPServer(('127.0.0.1', 0), H, bind_and_activate=False)
+s.socket.close()
+s.socket = socket.socket(fileno=int(os.environ['BRIDGE_LISTEN_FD']))
+threading.Timer(20, os._exit, (0,)).start()
+os.write(int(os.environ['BRIDGE_READY_FD']), b'ready')
+s.serve_forever()
+''')
+(tmp / 'bridge.pid').write_text('1')
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler, workers=4)
+port = server.server_address[1]
+hot = bridge.HotRestart(timeout=10, drain_timeout=10)
+closed = []
+bridge.tmux_control.close = lambda kill_session=True: closed.append(kill_session)
+
+def get():
+    conn = http.client.HTTPConnection('127.0.0.1', port, timeout=5)
+    conn.request('GET', '/metrics')
+    return conn.getresponse().read()
+
+results = {}
+def scenario():
+    try:
+        assert get().startswith(b'# HELP')
+        # A new process that never gets ready: the old one keeps serving
+        hot.command = lambda: [sys.executable, '-c', 'import time; time.sleep(30)']
+        hot.timeout = 1
+        assert not hot.handoff() and not hot.handed_off
+        assert get().startswith(b'# HELP')
+        # An outbound send still queued when the socket is handed on
+        sent = []
+        bridge.outbound.submit(1, lambda: (time.sleep(0.5), sent.append(1)), label='slow')
+        hot.command = lambda: [sys.executable, str(child)]
+        hot.timeout = 10
+        errors = []
+        def hammer():
+            while not results.get('stop'):
+                try:
+                    get()
+                except Exception as e:
+                    errors.append(repr(e))
+        h = threading.Thread(target=hammer); h.start()
+        assert hot.handoff()
+        assert get() == b'new'
+        results['stop'] = True; h.join()
+        results['errors'] = errors
+        results['sent'] = sent
+    except Exception as e:
+        results['fail'] = repr(e)
+        server.shutdown()
+
+threading.Thread(target=scenario, daemon=True).start()
+hot.serve(server)  # Returns once the handoff drained
+assert 'fail' not in results, results
+assert callable(signal.getsignal(signal.SIGUSR2)), 'SIGUSR2 triggers the handoff'
+assert signal.getsignal(signal.SIGHUP) is signal.SIG_DFL, 'a terminal hangup does not'
+assert results['errors'] == [], results['errors'][:3]
+assert results['sent'] == [1], 'drain waits for queued outbound sends'
+assert bridge.outbound.pending() == 0
+assert closed == [False], 'the shared tmux control session survives the drain'
+assert (tmp / 'bridge.pid').read_text() != '1', 'pid file follows the new process'
+assert get() == b'new'
+os.kill(int((tmp / 'bridge.pid').read_text()), 9)
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Hot restart hands the socket over with no refused requests and drains outbound"
+    else
+        fail "Hot restart handoff test failed"
+    fi
+}
+
 test_reserved_names_rejection() {
     info "Testing reserved names rejection..."
 
@@ -2326,35 +2959,35 @@ print('OK')
 }
 
 test_typing_indicator_loop() {
-    info "Testing typing indicator loop calls sendChatAction..."
+    info "Testing typing ticker calls sendChatAction while pending..."
 
-    # Test that send_typing_loop calls telegram_api with sendChatAction
+    # One tick sends typing for a pending worker; clear_pending stops it
     if python3 -c "
 import bridge
 import unittest.mock as mock
 
-# Set up a pending state that will clear after first check
-call_count = [0]
-def mock_is_pending(name):
-    call_count[0] += 1
-    return call_count[0] <= 1  # True first time, False after
-
-# Mock is_pending and telegram_api
-with mock.patch.object(bridge, 'is_pending', mock_is_pending), \
-     mock.patch.object(bridge, 'telegram_api') as mock_api, \
-     mock.patch('time.sleep'):  # Skip the sleep
+ticker = bridge.TypingTicker(interval=4)
+with mock.patch.object(bridge, 'typing_ticker', ticker), \
+     mock.patch.object(ticker, 'start'), \
+     mock.patch.object(bridge, 'telegram_api') as mock_api:
     mock_api.return_value = {'ok': True}
-    bridge.send_typing_loop(12345, 'test')
-
-# Verify sendChatAction was called
-assert mock_api.called, 'telegram_api should be called'
-call_args = mock_api.call_args
-assert call_args[0][0] == 'sendChatAction', f'Expected sendChatAction, got {call_args[0][0]}'
-assert call_args[0][1]['chat_id'] == 12345
-assert call_args[0][1]['action'] == 'typing'
+    bridge.set_pending('typingtest', 12345)
+    ticker.tick()
+    assert mock_api.called, 'telegram_api should be called'
+    call_args = mock_api.call_args
+    assert call_args[0][0] == 'sendChatAction', f'Expected sendChatAction, got {call_args[0][0]}'
+    assert call_args[0][1]['chat_id'] == '12345'
+    assert call_args[0][1]['action'] == 'typing'
+
+    bridge.clear_pending('typingtest')
+    mock_api.reset_mock()
+    ticker._last_sent.clear()
+    ticker.tick()
+    assert not mock_api.called, 'no typing after clear_pending'
+    assert ticker.chats() == set()
 print('OK')
 " 2>/dev/null | grep -q "OK"; then
-        success "Typing indicator loop calls sendChatAction"
+        success "Typing ticker calls sendChatAction"
     else
         fail "Typing indicator behavior test failed"
     fi
@@ -2631,6 +3264,93 @@ print('OK')
     fi
 }
 
+test_session_state_store() {
+    info "Testing session state store (write on change, stat-checked reads)..."
+
+    if python3 -c "
+import os, sys, time, tempfile
+from pathlib import Path
+tmp = Path(tempfile.mkdtemp())
+os.environ['SESSIONS_DIR'] = str(tmp / 'sessions')
+import bridge
+
+writes = []
+real_write = bridge.write_session_file
+bridge.write_session_file = lambda path, text: (writes.append(path.name), real_write(path, text))[1]
+store = bridge.session_store
+
+bridge.set_pending('w1', 123, 'trace-a')
+assert sorted(writes) == ['chat_id', 'pending', 'trace'], writes
+d = bridge.get_session_dir('w1')
+for f in ('pending', 'chat_id', 'trace'):
+    assert oct((d / f).stat().st_mode & 0o777) == '0o600', f
+assert oct(d.stat().st_mode & 0o777) == '0o700'
+
+# Next message, same chat: chat_id and trace are not rewritten
+writes.clear()
+bridge.set_pending('w1', 123, 'trace-a')
+assert 'chat_id' not in writes and 'trace' not in writes, writes
+
+# Reads come from memory while the files are unchanged
+hits = store.stats['hits']
+assert bridge.is_pending('w1') and bridge.is_pending('w1')
+assert bridge.read_trace_id('w1') == 'trace-a'
+assert store.stats['hits'] - hits == 3, store.stats
+
+# A hook removing pending (the Stop hook's rm -f) is seen and chat_id rewritten if lost
+(d / 'pending').unlink()
+assert not bridge.is_pending('w1')
+(d / 'chat_id').unlink()
+writes.clear()
+bridge.set_pending('w1', 123)
+assert sorted(writes) == ['chat_id', 'pending'] and not (d / 'trace').exists(), writes
+assert (d / 'chat_id').read_text() == '123'
+
+# Replaced behind the store's back: the new text is read
+(d / 'chat_id').write_text('456789')
+assert store.read(d / 'chat_id') == '456789'
+
+# Removed session dir is recreated on next use
+import shutil
+shutil.rmtree(d)
+bridge.set_pending('w1', 7)
+assert (d / 'chat_id').read_text() == '7'
+
+# Node files: written once per change
+writes.clear()
+for _ in range(3):
+    bridge.save_last_chat_id(42)
+    bridge.save_last_active('w1')
+assert sorted(writes) == ['last_active', 'last_chat_id'], writes
+assert bridge.load_last_chat_id() == 42 and bridge.load_last_active() == 'w1'
+bridge.save_last_active('w2')
+assert bridge.LAST_ACTIVE_FILE.read_text() == 'w2'
+
+# Concurrent writers of one file: each replace is whole, no temp files left
+import threading
+bridge.write_session_file = real_write
+texts = [str(i) * 50000 for i in range(8)]
+errors = []
+def writer(text):
+    try:
+        for _ in range(30):
+            real_write(d / 'chat_id', text)
+            assert (d / 'chat_id').read_text() in texts
+    except Exception as e:
+        errors.append(e)
+threads = [threading.Thread(target=writer, args=(t,)) for t in texts]
+for t in threads: t.start()
+for t in threads: t.join()
+assert not errors, errors[:1]
+assert not [p for p in d.iterdir() if p.name.endswith('.tmp')], list(d.iterdir())
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Session state store skips unchanged writes and sees hook changes"
+    else
+        fail "Session state store test failed"
+    fi
+}
+
 test_pending_set_and_clear() {
     info "Testing pending set and clear..."
 
@@ -2670,6 +3390,62 @@ print('OK')
     fi
 }
 
+test_response_keeps_next_turn_pending() {
+    info "Testing a delivered reply clears only its own turn's pending..."
+
+    if python3 -c "
+import os, sys, tempfile, threading, time
+from pathlib import Path
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+bridge.SESSIONS_DIR = Path(tempfile.mkdtemp())
+release, sending = threading.Event(), threading.Event()
+def send(*a, **kw):
+    sending.set()
+    release.wait(5)
+bridge.send_response_to_telegram = send
+
+def deliver(trace_id):
+    release.clear(); sending.clear()
+    assert bridge.enqueue_response('w1', 'reply', 1, trace_id=trace_id)
+    assert sending.wait(5)
+
+def settle():
+    deadline = time.time() + 5
+    while time.time() < deadline and bridge.outbound.pending():
+        time.sleep(0.01)
+
+# Turn 2 starts while turn 1's reply is still being sent: turn 2 stays pending
+bridge.set_pending('w1', 1, 't1')
+deliver('t1')
+bridge.set_pending('w1', 1, 't2')
+release.set(); settle()
+assert bridge.is_pending('w1') and bridge.read_trace_id('w1') == 't2'
+
+# The reply to the current turn clears it (pending already removed by the hook)
+bridge.get_pending_file('w1').unlink()
+deliver('t2')
+release.set(); settle()
+assert not bridge.is_pending('w1') and bridge.read_trace_id('w1') is None
+
+# Untraced: the pending timestamp decides
+bridge.set_pending('w1', 1)
+deliver(None)
+bridge.session_store.write(bridge.get_pending_file('w1'), str(int(time.time()) + 5))
+release.set(); settle()
+assert bridge.is_pending('w1')
+deliver(None)
+release.set(); settle()
+assert not bridge.is_pending('w1')
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Reply delivery keeps the next turn's pending and trace"
+    else
+        fail "Response next-turn pending test failed"
+    fi
+}
+
 # ============================================================
 # CLI + HOOK TESTS
 # ============================================================
@@ -3407,10 +4183,843 @@ print('OK')
     fi
 }
 
+test_tmux_control_channel() {
+    info "Testing tmux control-mode channel..."
+
+    # Private tmux server (-L) so real workers are never touched
+    if python3 -c "
+import os, threading, time
+import bridge
+
+label = f'bridge-ctl-test-{os.getpid()}'
+ctl = bridge.TmuxControl('_ctltest', socket_name=label)
+try:
+    assert ctl.start(), 'control client should connect'
+    rc, _ = ctl.run(['new-session', '-d', '-s', 'w1', 'stty -echo; cat'])
+    assert rc == 0, 'new-session via control channel'
+    time.sleep(0.5)
+
+    # Quoting: tmux-special characters and newlines arrive literally
+    text = 'it\'s \\"q\\" \\\$HOME ~ ; #{pane_pid} back\\\\slash'
+    rc, _ = ctl.run(['send-keys', '-t', 'w1', '-l', text])
+    assert rc == 0
+    ctl.run(['send-keys', '-t', 'w1', 'Enter'])
+    time.sleep(0.5)
+    rc, out = ctl.run(['capture-pane', '-t', 'w1', '-p'])
+    assert rc == 0 and text in out, f'pane should contain {text!r}, got {out!r}'
+
+    # Batched: several commands in one write, replies in order
+    results = ctl.run_many([
+        ['set-environment', '-t', 'w1', 'FOO', 'x y'],
+        ['set-environment', '-t', 'w1', 'BAR', '2'],
+        ['show-environment', '-t', 'w1', 'FOO'],
+        ['has-session', '-t', 'nope'],
+    ])
+    assert [r[0] for r in results] == [0, 0, 0, 1], results
+    assert results[2][1].strip() == 'FOO=x y', results
+
+    # Timed out after the write: LOST, never forked again; late reply absorbed
+    class FakeProc:
+        def __init__(self):
+            r, self.feed = os.pipe()
+            self.stdout, self.stdin = os.fdopen(r, 'rb'), open(os.devnull, 'wb')
+        def poll(self):
+            return None
+    fake = bridge.TmuxControl('_fake')
+    fake.proc = FakeProc()
+    threading.Thread(target=fake._reader, args=(fake.proc,), daemon=True).start()
+    forked = []
+    real_subprocess_run = bridge.subprocess.run
+    bridge.subprocess.run = lambda *a, **k: forked.append(a)
+    bridge.tmux_control = fake
+    run = fake.run
+    fake.run = lambda args, timeout=0.2: run(args, timeout)
+    assert bridge.tmux_run(['send-keys', '-t', 'w1', 'Enter']) == (bridge.TmuxControl.LOST, '')
+    bridge.subprocess.run = real_subprocess_run
+    assert forked == [], forked
+    later = []
+    t = threading.Thread(target=lambda: later.append(run(['show-environment'], 2)))
+    t.start()
+    time.sleep(0.1)
+    os.write(fake.proc.feed, b'%begin 1 5 1\\nlate\\n%end 1 5 1\\n%begin 1 9 1\\nnew\\n%end 1 9 1\\n')
+    t.join()
+    assert later == [(0, 'new\\n')], later
+
+    # Closed channel -> run() returns None so callers fall back to subprocess
+    ctl.close()
+    assert not ctl.connected
+    assert ctl.run(['list-sessions']) is None
+finally:
+    os.system(f'tmux -L {label} kill-server 2>/dev/null')
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "tmux control channel runs batched commands"
+    else
+        fail "tmux control channel test failed"
+    fi
+}
+
+test_pane_stream_ring_buffer() {
+    info "Testing pipe-pane stream: ring buffer, prompt detection, hook fallback..."
+    if TMUX_CONTROL=0 python3 -c "
+import os, sys, tempfile, time, subprocess
+os.environ['SESSIONS_DIR'] = tempfile.mkdtemp()
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+# Escapes: colours dropped, cursor moves end lines, cursor-forward is a space
+raw = b'\x1b[1m\xe2\x9d\xaf hi\x1b[0m\x1b[2K\x1b[1A\x1b[G\xe2\x9d\xaf\x1b[1C\r\n\x1b]0;title\x07done'
+text = bridge.pane_text(raw)
+assert text == '❯ hi\n\n\n❯ \ndone', repr(text)
+assert bridge.prompt_accepted(text) and not bridge.prompt_accepted('❯ \n❯ typed')
+
+# Port of the hook's awk: last response block, status lines skipped
+screen = '● First answer\n❯ \n● Second line one\n  line two\n✻ Whirring…\n───────\n❯ '
+assert bridge.extract_pane_response(screen) == 'Second line one\nline two'
+assert bridge.extract_pane_response('● How is Claude doing this session?\n❯') == ''
+
+name = f'panetest{os.getpid()}'
+tmux_name = f'_{name}'
+subprocess.run(['tmux', 'new-session', '-d', '-s', tmux_name, '-x', '120', '-y', '30', 'bash --norc --noprofile'], check=True)
+streams = bridge.PaneStreams(max_bytes=4096)
+bridge.pane_streams = streams
+try:
+    time.sleep(0.3)
+    assert streams.attach(name, tmux_name) and streams.attach(name, tmux_name)
+    assert streams.count() == 1
+
+    # Acceptance is event-driven: returns as soon as an empty prompt is drawn
+    streams.mark(tmux_name)
+    subprocess.run(['tmux', 'send-keys', '-t', tmux_name, 'printf \"typed\\\\n\\\\342\\\\235\\\\257 \\\\n\"', 'Enter'])
+    started = time.monotonic()
+    assert bridge.tmux_prompt_empty(tmux_name, timeout=3)
+    assert time.monotonic() - started < 2, 'should not wait for the timeout'
+
+    # A prompt that still holds text is not accepted (nor by the final capture-pane)
+    streams.mark(tmux_name)
+    subprocess.run(['tmux', 'send-keys', '-t', tmux_name, 'clear; printf \"\\\\342\\\\235\\\\257 pending\\\\n\"', 'Enter'])
+    assert not bridge.tmux_prompt_empty(tmux_name, timeout=0.5)
+
+    # Output the stream cannot read as an empty prompt: one capture-pane decides
+    real_accepted = bridge.prompt_accepted
+    bridge.prompt_accepted = lambda text: False
+    streams.mark(tmux_name)
+    subprocess.run(['tmux', 'send-keys', '-t', tmux_name, 'clear; printf \"\\\\342\\\\235\\\\257 \\\\n\"', 'Enter'])
+    assert bridge.tmux_prompt_empty(tmux_name, timeout=0.5)
+    bridge.prompt_accepted = real_accepted
+
+    # Bounded ring buffer
+    streams.mark(tmux_name)
+    subprocess.run(['tmux', 'send-keys', '-t', tmux_name, 'seq 1 5000; printf \"seq-%s\\\\n\" done', 'Enter'])
+    assert streams.wait(tmux_name, lambda t: 'seq-done' in t, 5)
+    stream = streams._streams[tmux_name]
+    assert len(stream.buffer) <= 4096 and stream.total > 4096, (len(stream.buffer), stream.total)
+
+    # Hook fallback is answered from the buffer (no capture-pane)
+    calls = []
+    real_run = bridge.tmux_run
+    bridge.tmux_run = lambda args, **kw: calls.append(args) or real_run(args, **kw)
+    streams.mark(tmux_name)
+    subprocess.run(['tmux', 'send-keys', '-t', tmux_name, 'clear; printf \"\\\\342\\\\227\\\\217 Streamed **reply**\\\\n\\\\342\\\\235\\\\257 \\\\n\"', 'Enter'])
+    assert streams.wait(tmux_name, lambda t: '● Streamed' in t, 5)
+    html = bridge.pane_fallback_response(name, tmux_name)
+    assert html.startswith('Streamed <b>reply</b>') and 'May be incomplete' in html, html
+    assert not any(a[0] == 'capture-pane' for a in calls), calls
+    bridge.tmux_run = real_run
+
+    fifo = bridge.get_session_dir(name) / 'pane.fifo'
+    assert fifo.exists()
+    streams.detach(tmux_name)
+    assert streams.count() == 0 and not fifo.exists()
+    # Detached: back to capture-pane polling
+    assert bridge.pane_streams.text(tmux_name) is None
+finally:
+    subprocess.run(['tmux', 'kill-session', '-t', tmux_name], capture_output=True)
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Pane stream buffers output and answers prompt checks and the hook fallback"
+    else
+        fail "Pane stream test failed"
+    fi
+}
+
+test_hire_readiness_driven() {
+    info "Testing hire waits on pane readiness, not fixed sleeps..."
+
+    # Fake interactive backend: shows the bypass dialog, then a ❯ prompt, then logs input
+    if python3 -c "
+import os, tempfile, time
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+bridge.SESSIONS_DIR = tmp / 'sessions'
+bridge.TMUX_PREFIX = f'hiretest{os.getpid()}-'
+bridge.save_last_active = lambda name: None
+log = tmp / 'input.log'
+fake = tmp / 'fake.py'
+fake.write_text('''import sys, time
+time.sleep(0.3)
+print(\"Bypass Permissions mode\")
+print(\" 1. No, exit\")
+print(\" 2. Yes, I accept\", flush=True)
+answer = sys.stdin.readline().strip()
+print(\"❯ \", flush=True)
+with open(sys.argv[1], \"a\") as f:
+    f.write(\"answer=\" + answer + chr(10)); f.flush()
+    for line in sys.stdin:
+        f.write(line); f.flush()
+''')
+
+class FakeBackend(bridge.ClaudeBackend):
+    name = 'fake'
+    def start_cmd(self):
+        return f'exec python3 {fake} {log}'
+bridge.BACKENDS['fake'] = FakeBackend()
+
+tmux_name = bridge.TMUX_PREFIX + 'w1'
+try:
+    t = time.monotonic()
+    ok, err = bridge.worker_manager.hire('w1', 'fake')
+    elapsed = time.monotonic() - t
+    assert ok, err
+    assert elapsed < 3.0, f'hire should not block on backend startup, took {elapsed:.1f}s'
+    assert bridge.worker_manager.is_online('w1'), 'booting worker counts as online'
+
+    assert bridge.worker_manager.wait_ready('w1', 15), 'startup should finish'
+    assert not bridge.worker_manager.is_starting('w1')
+    deadline = time.time() + 5
+    while time.time() < deadline and 'connected to Telegram' not in (log.read_text() if log.exists() else ''):
+        time.sleep(0.1)
+    content = log.read_text()
+    assert content.startswith('answer=2'), f'bypass dialog should be answered with 2: {content!r}'
+    assert 'connected to Telegram' in content, f'welcome should be sent after prompt: {content!r}'
+
+    # Message after readiness is delivered
+    assert bridge.worker_manager.send('w1', 'hello there')
+    deadline = time.time() + 5
+    while time.time() < deadline and 'hello there' not in log.read_text():
+        time.sleep(0.1)
+    assert 'hello there' in log.read_text()
+finally:
+    os.system(f'tmux kill-session -t {tmux_name} 2>/dev/null')
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Hire is readiness-driven and non-blocking"
+    else
+        fail "Readiness-driven hire test failed"
+    fi
+}
+
+test_worker_pool_claim() {
+    info "Testing /hire claims a pre-warmed pool session..."
+
+    # Warm one slot with a fake interactive backend, then hire from it
+    if python3 -c "
+import os, tempfile, time
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+bridge.SESSIONS_DIR = tmp / 'sessions'
+bridge.TMUX_PREFIX = f'pooltest{os.getpid()}-'
+bridge.save_last_active = lambda name: None
+log = tmp / 'input.log'
+fake = tmp / 'fake.py'
+fake.write_text('''import sys
+print(\"❯ \", flush=True)
+with open(sys.argv[1], \"a\") as f:
+    for line in sys.stdin:
+        f.write(line); f.flush()
+''')
+
+class FakeBackend(bridge.ClaudeBackend):
+    name = 'fake'
+    def start_cmd(self):
+        return f'exec python3 {fake} {log}'
+bridge.BACKENDS['fake'] = FakeBackend()
+
+assert bridge.parse_worker_pool('fake=1, codex=2, bogus=1') == {'fake': 1}, 'non-interactive/unknown backends are ignored'
+pool = bridge.WorkerPool({'fake': 1})
+bridge.worker_pool = pool
+
+def sessions():
+    rc, out = bridge.tmux_run(['list-sessions', '-F', '#{session_name}'])
+    return [s for s in out.split() if bridge.TMUX_PREFIX in s]
+
+try:
+    slot = pool.slot_prefix('fake') + '-warm1'
+    assert pool.warm_slot(slot, 'fake'), 'slot should reach the prompt'
+    pool._idle['fake'].append(slot)
+    assert 'warm1' not in str(bridge.worker_manager.refresh()), 'pool slots are not workers'
+
+    pool.top_up = lambda: None  # Refill is covered by start(); keep the test deterministic
+    t = time.monotonic()
+    ok, err = bridge.worker_manager.hire('inv1', 'fake')
+    assert ok, err
+    assert time.monotonic() - t < 1.0, 'hire from the pool should be instant'
+    tmux_name = bridge.TMUX_PREFIX + 'inv1'
+    assert tmux_name in sessions() and slot not in sessions(), f'slot should be renamed: {sessions()}'
+    assert pool.idle('fake') == 0 and pool.stats['claimed'] == 1
+    assert bridge.get_tmux_env_value(tmux_name, 'WORKER_BACKEND') == 'fake'
+
+    assert bridge.worker_manager.wait_ready('inv1', 10)
+    deadline = time.time() + 5
+    while time.time() < deadline and 'connected to Telegram' not in log.read_text():
+        time.sleep(0.1)
+    assert 'connected to Telegram' in log.read_text(), 'welcome goes to the claimed session'
+
+    # Empty pool -> cold start fallback
+    assert not pool.claim('inv2', 'fake', bridge.TMUX_PREFIX + 'inv2')
+    assert pool.stats['misses'] == 1
+
+    # Sandbox slot alias maps hook responses back to the worker
+    bridge.ensure_session_dir('inv1')
+    (bridge.SESSIONS_DIR / slot).symlink_to('inv1')
+    assert bridge.resolve_session_alias(slot) == 'inv1'
+    bridge.remove_session_aliases('inv1')
+    assert not (bridge.SESSIONS_DIR / slot).exists()
+finally:
+    for name in sessions():
+        os.system(f'tmux kill-session -t {name} 2>/dev/null')
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Hire claims pre-warmed pool session"
+    else
+        fail "Worker pool claim test failed"
+    fi
+}
+
+test_telegram_connection_pool_reuse() {
+    info "Testing Telegram keep-alive connection pool reuse..."
+
+    if python3 -c "
+import json, threading
+from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
+import bridge
+
+seen = []
+mode = {}
+class FakeTelegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'  # keep-alive
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        seen.append(self.path.rsplit('/', 1)[-1])
+        close_after = mode.pop('close_after', False)  # Read before replying: the client moves on at once
+        if mode.pop('vanish', False):
+            self.close_connection = True  # Took the request, never answered
+            return
+        body = json.dumps({'ok': True, 'result': {'message_id': 1}}).encode()
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+        if close_after:
+            self.close_connection = True  # Closed while idle, no Connection: close header
+    def log_message(self, *args):
+        pass
+
+server = ThreadingHTTPServer(('127.0.0.1', 0), FakeTelegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+
+pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_port}', size=2, idle_timeout=60)
+api = bridge.TelegramAPI('123:abc', pool=pool)
+for _ in range(5):
+    assert api.send_message(1, 'hi')['ok']
+assert pool.stats['created'] == 1, pool.stats
+assert pool.stats['reused'] == 4, pool.stats
+
+# Idle connections past the timeout are closed, not reused
+pool.idle_timeout = 0
+import time; time.sleep(0.01)
+assert api.send_message(1, 'hi')['ok']
+assert pool.stats['expired'] == 1, pool.stats
+assert pool.stats['created'] == 2, pool.stats
+
+# An idle connection the server closed is dropped before use, nothing is resent
+seen.clear()
+pool.idle_timeout = 60
+mode['close_after'] = True
+assert api.send_message(1, 'hi')['ok']
+time.sleep(0.1)
+assert api.send_message(1, 'hi')['ok']
+assert seen == ['sendMessage', 'sendMessage'] and pool.stats['stale'] == 1, (seen, pool.stats)
+
+# Written but unanswered: sendMessage is not resent, getUpdates is
+seen.clear()
+mode['vanish'] = True
+try:
+    pool.request('POST', '/bot123:abc/sendMessage', body=b'{}', headers={'Content-Type': 'application/json'})
+    raise SystemExit('sendMessage must not be retried')
+except (ConnectionError, bridge.http.client.HTTPException):
+    pass
+assert seen == ['sendMessage'], seen
+api.send_message(1, 'warm')  # Put a kept-alive connection back in the pool
+seen.clear()
+mode['vanish'] = True
+status, _ = pool.request('POST', '/bot123:abc/getUpdates', body=b'{}', headers={'Content-Type': 'application/json'})
+assert status == 200 and seen == ['getUpdates', 'getUpdates'], seen
+
+# Shared by the module-level client and media helpers
+assert bridge.telegram.pool is bridge.telegram_pool
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Telegram connection pool reuses keep-alive connections"
+    else
+        fail "Telegram connection pool test failed"
+    fi
+}
+
+test_outbound_dispatcher_rate_limit() {
+    info "Testing outbound dispatcher ordering, 429 retry_after and queue bound..."
+
+    if python3 -c "
+import json, threading, time
+from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
+import bridge
+
+sent = []
+first = [True]
+class FakeTelegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        data = json.loads(self.rfile.read(int(self.headers.get('Content-Length', 0))))
+        if first[0]:
+            first[0] = False
+            status, body = 429, {'ok': False, 'error_code': 429, 'parameters': {'retry_after': 0.3}}
+        else:
+            sent.append(data['text'])
+            status, body = 200, {'ok': True, 'result': {'message_id': len(sent)}}
+        raw = json.dumps(body).encode()
+        self.send_response(status)
+        self.send_header('Content-Length', str(len(raw)))
+        self.end_headers()
+        self.wfile.write(raw)
+    def log_message(self, *args):
+        pass
+
+server = ThreadingHTTPServer(('127.0.0.1', 0), FakeTelegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+api = bridge.TelegramAPI('123:abc', pool=bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_port}'))
+
+dispatcher = bridge.OutboundDispatcher(api, workers=3, max_queue=10)
+done = threading.Event()
+def job(texts, last=False):
+    def run():
+        for t in texts:
+            dispatcher.call(42, 'sendMessage', {'chat_id': 42, 'text': t})
+        if last:
+            done.set()
+    return run
+
+start = time.time()
+assert dispatcher.submit(42, job(['a1', 'a2']))
+assert dispatcher.submit(42, job(['b1', 'b2'], last=True))
+assert done.wait(5), 'jobs did not finish'
+# 429 was waited out and retried; chunk + job order kept within the chat
+assert sent == ['a1', 'a2', 'b1', 'b2'], sent
+assert dispatcher.stats['rate_limited'] == 1, dispatcher.stats
+assert time.time() - start >= 0.3, 'retry_after not honored'
+
+# Bounded queue: no workers draining, third job is rejected
+full = bridge.OutboundDispatcher(api, workers=0, max_queue=2)
+assert full.submit(1, lambda: None)
+assert full.submit(2, lambda: None)
+assert not full.submit(3, lambda: None)
+assert full.stats['rejected'] == 1
+
+# Token bucket: burst then wait
+bucket = bridge.TokenBucket(rate=10, burst=2)
+assert bucket.reserve() == 0 and bucket.reserve() == 0
+assert bucket.reserve() > 0
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Outbound dispatcher keeps order, honors retry_after, bounds queue"
+    else
+        fail "Outbound dispatcher test failed"
+    fi
+}
+
 # ─────────────────────────────────────────────────────────────────────────────
 # Settings command test
 # ─────────────────────────────────────────────────────────────────────────────
 
+test_webhook_ack_and_update_dedupe() {
+    info "Testing webhooks are acknowledged before handling, ordered per chat and deduped..."
+
+    # Slow handler: webhook must return while it runs; a redelivered update_id runs once
+    if python3 -c "
+import json, os, sys, threading, time, urllib.request
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+events, lock = [], threading.Lock()
+def handle(update):
+    chat = update['message']['chat']['id']
+    with lock:
+        events.append(('start', chat, update['update_id'], time.monotonic()))
+    time.sleep(0.5)
+    with lock:
+        events.append(('end', chat, update['update_id'], time.monotonic()))
+
+bridge.WEBHOOK_SECRET = ''
+bridge.update_dispatcher = bridge.UpdateDispatcher(handle, workers=2, max_queue=3)
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler, workers=4)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+http_threads = [t for t in threading.enumerate() if t.name.startswith('http-')]
+assert len(http_threads) == 4, 'fixed request pool'
+
+def post(update_id, chat):
+    body = json.dumps({'update_id': update_id, 'message': {'chat': {'id': chat}, 'text': 'hi'}}).encode()
+    req = urllib.request.Request(f'http://127.0.0.1:{server.server_address[1]}/', data=body)
+    t = time.monotonic()
+    try:
+        with urllib.request.urlopen(req, timeout=5) as r:
+            return r.status, time.monotonic() - t
+    except urllib.error.HTTPError as e:
+        return e.code, time.monotonic() - t
+
+status, elapsed = post(1, 10)
+assert status == 200 and elapsed < 0.3, f'acked before handling ({elapsed:.2f}s)'
+assert post(1, 10)[0] == 200, 'redelivery is acknowledged'
+assert post(2, 10)[0] == 200 and post(3, 20)[0] == 200
+assert post(4, 10)[0] == 503, 'full queue asks Telegram to retry'
+time.sleep(1.5)
+assert post(4, 10)[0] == 200, 'rejected update is not remembered as seen'
+time.sleep(1.2)
+
+ids = [e[2] for e in events if e[0] == 'start']
+assert sorted(ids) == [1, 2, 3, 4], ids
+assert bridge.update_dispatcher.stats['duplicates'] == 1
+chat10 = [e for e in events if e[1] == 10]
+assert [e[2] for e in chat10 if e[0] == 'start'] == [1, 2, 4], 'per-chat arrival order'
+for a, b in zip(chat10, chat10[1:]):
+    assert a[3] <= b[3] and not (a[0] == 'start' and b[0] == 'start'), 'one update per chat at a time'
+start3 = next(e[3] for e in events if e[2] == 3)
+end1 = next(e[3] for e in events if e[0] == 'end' and e[2] == 1)
+assert start3 < end1, 'other chats run in parallel'
+server.shutdown()
+
+# Idle keep-alive agents hold no pool thread: a webhook still gets through
+import http.client
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler, workers=2, idle_timeout=1.5)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+agents = []
+for _ in range(6):
+    conn = http.client.HTTPConnection('127.0.0.1', server.server_address[1], timeout=5)
+    conn.request('POST', '/response', body=b'{}', headers={'Connection': 'keep-alive'})
+    resp = conn.getresponse(); resp.read()
+    assert not resp.will_close
+    agents.append(conn)
+time.sleep(0.2)
+assert server.parked() == 6, server.parked()
+body = json.dumps({'update_id': 5, 'message': {'chat': {'id': 30}, 'text': 'hi'}}).encode()
+t = time.monotonic()
+with urllib.request.urlopen(urllib.request.Request(f'http://127.0.0.1:{server.server_address[1]}/', data=body), timeout=2) as r:
+    assert r.status == 200 and time.monotonic() - t < 1, 'webhook waited behind idle agents'
+sock = agents[0].sock
+agents[0].request('POST', '/response', body=b'{}', headers={'Connection': 'keep-alive'})
+agents[0].getresponse().read()
+assert agents[0].sock is sock, 'parked connection is served again'
+time.sleep(3)
+assert server.parked() == 0, 'idle connections closed after idle_timeout'
+server.shutdown()
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Webhooks ack first, keep per-chat order and drop duplicate updates"
+    else
+        fail "Webhook ack/dedupe test failed"
+    fi
+}
+
+test_update_poller_offset() {
+    info "Testing getUpdates polling feeds the dispatcher and keeps its offset across restarts..."
+
+    # Mock Telegram answers getUpdates from a list; offset must survive a new poller
+    if python3 -c "
+import json, os, sys, tempfile, threading, time
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+calls, pending = [], [
+    {'update_id': 5, 'message': {'chat': {'id': 1}, 'text': 'a'}},
+    {'update_id': 6, 'message': {'chat': {'id': 1}, 'text': 'b'}},
+]
+class Telegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        data = json.loads(self.rfile.read(int(self.headers['Content-Length'])))
+        method = self.path.rsplit('/', 1)[1]
+        calls.append((method, data))
+        if method == 'getUpdates':
+            if data.get('offset') == 99:
+                self.send_response(502)
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+                return
+            result = [u for u in pending if u['update_id'] >= data.get('offset', 0)]
+        else:
+            result = True
+        body = json.dumps({'ok': True, 'result': result}).encode()
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    def log_message(self, *a):
+        pass
+
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Telegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_address[1]}', size=1)
+api = bridge.TelegramAPI('123:fake', pool)
+
+handled = []
+bridge.update_dispatcher = bridge.UpdateDispatcher(lambda u: handled.append(u['message']['text']))
+offset_file = Path(tempfile.mkdtemp(dir='/tmp')) / 'update_offset'
+
+poller = bridge.UpdatePoller(api, offset_file, timeout=0)
+assert poller.offset is None
+poller._loop = lambda: None  # Drive polls by hand
+poller.start()
+assert poller.poll_once() == 0
+deadline = time.time() + 5
+while handled != ['a', 'b'] and time.time() < deadline:
+    time.sleep(0.05)
+assert handled == ['a', 'b'], handled
+assert calls[0][0] == 'deleteWebhook', 'webhook removed before polling'
+first = next(d for m, d in calls if m == 'getUpdates')
+assert 'offset' not in first and first['timeout'] == 0
+assert offset_file.read_text() == '7' and oct(offset_file.stat().st_mode & 0o777) == '0o600'
+
+# Restart: the new poller resumes at the saved offset, nothing is replayed
+calls.clear()
+again = bridge.UpdatePoller(api, offset_file, timeout=0)
+assert again.offset == 7
+assert again.poll_once() == 0
+assert calls[-1] == ('getUpdates', {'timeout': 0, 'offset': 7})
+time.sleep(0.2)
+assert handled == ['a', 'b']
+
+# Errors back off; long-poll calls reuse one connection
+again.offset = 99
+assert again.poll_once() == 2 and again.poll_once() == 4
+assert again.stats['errors'] == 2
+assert pool.stats['created'] <= 2, pool.stats
+server.shutdown()
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Polling resumes from the saved offset and feeds the dispatcher"
+    else
+        fail "Update poller test failed"
+    fi
+}
+
+test_metrics_endpoint() {
+    info "Testing /metrics exposes counters, latency histograms and gauges..."
+
+    # Telegram calls are counted and timed per method; the token never becomes a label
+    if python3 -c "
+import json, os, sys, threading, urllib.request
+from http.server import HTTPServer, BaseHTTPRequestHandler
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+class FakeTelegram(BaseHTTPRequestHandler):
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        body = json.dumps({'ok': self.path.endswith('/sendMessage')}).encode()
+        self.send_response(200 if self.path.endswith('/sendMessage') else 400)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    def log_message(self, *args):
+        pass
+
+fake = HTTPServer(('127.0.0.1', 0), FakeTelegram)
+threading.Thread(target=fake.serve_forever, daemon=True).start()
+pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{fake.server_address[1]}')
+for _ in range(3):
+    pool.request('POST', '/bot123:SECRET/sendMessage', body=b'{}')
+pool.request('POST', '/bot123:SECRET/editMessageText', body=b'{}')
+dead = bridge.TelegramConnectionPool('http://127.0.0.1:1')
+try:
+    dead.request('POST', '/bot123:SECRET/sendMessage', body=b'{}')
+except OSError:
+    pass
+
+bridge.update_dispatcher = bridge.UpdateDispatcher(lambda u: None, workers=1)
+bridge.update_dispatcher.dispatch({'update_id': 7, 'message': {'chat': {'id': 1}}})
+bridge.update_dispatcher.dispatch({'update_id': 7, 'message': {'chat': {'id': 1}}})
+bridge.metrics.observe('worker_turn_seconds', 42, worker='alice', backend='claude')
+
+bridge.WEBHOOK_SECRET = ''
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler, workers=2)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+with urllib.request.urlopen(f'http://127.0.0.1:{server.server_address[1]}/metrics', timeout=5) as r:
+    assert r.headers['Content-Type'].startswith('text/plain; version=0.0.4')
+    text = r.read().decode()
+server.shutdown()
+fake.shutdown()
+
+assert 'SECRET' not in text
+assert 'telegram_requests_total{code=\"200\",method=\"sendMessage\"} 3' in text
+assert 'telegram_requests_total{code=\"400\",method=\"editMessageText\"} 1' in text
+assert 'telegram_requests_total{code=\"error\",method=\"sendMessage\"} 1' in text
+assert 'telegram_api_seconds_count{method=\"sendMessage\"} 4' in text
+assert 'telegram_api_seconds_bucket{method=\"sendMessage\",le=\"+Inf\"} 4' in text
+assert 'telegram_updates_total{result=\"accepted\"} 1' in text
+assert 'telegram_updates_total{result=\"duplicate\"} 1' in text
+assert 'worker_turn_seconds_bucket{backend=\"claude\",worker=\"alice\",le=\"30\"} 0' in text
+assert 'worker_turn_seconds_bucket{backend=\"claude\",worker=\"alice\",le=\"60\"} 1' in text
+assert 'worker_turn_seconds_sum{backend=\"claude\",worker=\"alice\"} 42' in text
+assert '# TYPE hire_seconds histogram' in text and '# TYPE pending_workers gauge' in text
+assert 'outbound_jobs_total{result=\"submitted\"}' in text
+threads = [l for l in text.splitlines() if l.startswith('threads ')]
+assert threads and int(threads[0].split()[1]) > 1
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "/metrics reports per-method Telegram latency, updates and gauges"
+    else
+        fail "Metrics endpoint test failed"
+    fi
+}
+
+test_message_trace_spans() {
+    info "Testing per-message trace ids from routing to delivered reply..."
+
+    # Trace id is written next to pending, echoed on /response and served by /trace/<id>
+    if python3 -c "
+import json, os, sys, tempfile, threading, time, urllib.request
+from pathlib import Path
+from importlib.util import spec_from_loader, module_from_spec
+from importlib.machinery import SourceFileLoader
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+bridge.SESSIONS_DIR = tmp
+log = tmp / 'spans.jsonl'
+bridge.tracer = bridge.Tracer(keep=2, log_path=str(log))
+delivered = threading.Event()
+bridge.send_response_to_telegram = lambda *a, **k: delivered.set()
+
+# A command that never reaches a worker stores nothing
+unused = bridge.tracer.begin(1, 9, time.time())
+bridge.tracer.end()
+assert bridge.tracer.get(unused) is None and not log.exists()
+
+tid = bridge.tracer.begin(1, 10, time.time() - 2)
+bridge.tracer.span(bridge.tracer.current(), 'routed', worker='alice', backend='gemini')
+bridge.set_pending('alice', 1, tid)
+bridge.tracer.span(tid, 'sent', worker='alice', ok=True)
+bridge.tracer.end()
+assert bridge.tracer.current() is None
+assert (tmp / 'alice' / 'trace').read_text() == tid
+assert oct((tmp / 'alice' / 'trace').stat().st_mode)[-3:] == '600'
+
+spec = spec_from_loader('gemini_adapter', SourceFileLoader('gemini_adapter', 'hooks/gemini-adapter.py'))
+adapter = module_from_spec(spec)
+spec.loader.exec_module(adapter)
+assert adapter.load_trace_id('alice', str(tmp)) == tid and adapter.load_trace_id('bob', str(tmp)) == ''
+
+bridge.WEBHOOK_SECRET = ''
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler, workers=2)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+base = f'http://127.0.0.1:{server.server_address[1]}'
+body = json.dumps({'session': 'alice', 'text': 'done', 'trace_id': tid, 'source': 'gemini', 'transcript_wait_ms': 12}).encode()
+with urllib.request.urlopen(urllib.request.Request(base + '/response', data=body), timeout=5) as r:
+    assert r.status == 200
+assert delivered.wait(5)
+time.sleep(0.2)
+assert not (tmp / 'alice' / 'trace').exists(), 'cleared with pending'
+
+with urllib.request.urlopen(base + '/trace/' + tid, timeout=5) as r:
+    trace = json.loads(r.read())
+stages = [span['stage'] for span in trace['spans']]
+assert stages == ['received', 'routed', 'sent', 'response', 'delivered'], stages
+assert trace['chat_id'] == 1 and trace['message_id'] == 10
+assert trace['spans'][0]['telegram_lag_ms'] >= 2000
+assert trace['spans'][3]['transcript_wait_ms'] == 12 and trace['spans'][3]['source'] == 'gemini'
+ms = [span['ms'] for span in trace['spans']]
+assert ms == sorted(ms) and trace['total_ms'] == ms[-1]
+assert 'done' not in json.dumps(trace), 'no message text'
+try:
+    urllib.request.urlopen(base + '/trace/nope', timeout=5)
+    raise SystemExit('unknown trace must 404')
+except urllib.error.HTTPError as e:
+    assert e.code == 404
+
+# Not public: tunnelled requests are refused; with a webhook secret it is required
+def status(path, headers):
+    try:
+        return urllib.request.urlopen(urllib.request.Request(base + path, headers=headers), timeout=5).status
+    except urllib.error.HTTPError as e:
+        return e.code
+assert status('/trace/' + tid, {'Cf-Connecting-Ip': '203.0.113.5'}) == 403
+assert status('/metrics', {'X-Forwarded-For': '203.0.113.5'}) == 403
+bridge.WEBHOOK_SECRET = 'hooksecret'
+assert status('/trace/' + tid, {}) == 403 and status('/metrics', {}) == 403
+assert status('/trace/' + tid, {'Authorization': 'Bearer hooksecret'}) == 200
+assert status('/metrics', {'Authorization': 'Bearer hooksecret'}) == 200
+bridge.WEBHOOK_SECRET = ''
+server.shutdown()
+
+assert oct(log.stat().st_mode)[-3:] == '600', 'trace log holds chat ids'
+lines = [json.loads(l) for l in log.read_text().splitlines()]
+assert [l['stage'] for l in lines] == stages and all(l['trace_id'] == tid for l in lines)
+
+# Bounded: oldest traces are evicted
+for i in range(3):
+    t = bridge.tracer.begin(1, i)
+    bridge.tracer.span(t, 'routed', worker='alice')
+    bridge.tracer.end()
+assert bridge.tracer.get(tid) is None and bridge.tracer.get(t) is not None
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Trace follows a message from routing to delivery; /trace/<id> serves its spans"
+    else
+        fail "Message trace test failed"
+    fi
+}
+
+test_bench_mock_telegram() {
+    info "Testing benchmark harness against the mock Telegram API..."
+
+    # Small run: every message is acked, answered by a stub worker and delivered to the mock
+    local out
+    out=$(timeout 120 python3 "$SCRIPT_DIR/bench.py" --workers 2 --messages 20 --concurrency 4 --rate-limit-every 7 2>/dev/null || true)
+    if echo "$out" | python3 -c "
+import json, sys
+r = json.loads(sys.stdin.read().strip().splitlines()[-1])
+assert r['workers'] == 2 and r['delivered'] == r['messages'] == 20, r
+assert r['rate_limited'] >= 1, '429 path exercised'
+for key in ('ack_p50_ms', 'ack_p99_ms', 'delivery_p50_ms', 'delivery_p99_ms', 'msgs_per_sec', 'rss_kb'):
+    assert isinstance(r[key], (int, float)) and r[key] > 0, key
+assert r['ack_p50_ms'] <= r['ack_p99_ms'] and r['delivery_p50_ms'] <= r['delivery_p99_ms']
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Bench run delivers every reply through the mock API and reports JSON"
+    else
+        fail "Bench harness test failed"
+    fi
+}
+
+test_bench_load() {
+    info "Benchmarking ${BENCH_MESSAGES:-200} messages for ${BENCH_WORKERS:-1,10,50} workers..."
+
+    local output="$SCRIPT_DIR/bench_output.txt"
+    if python3 "$SCRIPT_DIR/bench.py" --workers "${BENCH_WORKERS:-1,10,50}" --messages "${BENCH_MESSAGES:-200}" \
+        --latency-ms "${BENCH_LATENCY_MS:-0}" --rate-limit-every "${BENCH_RATE_LIMIT_EVERY:-0}" --output "$output"; then
+        success "Benchmark complete (appended to bench_output.txt)"
+    else
+        fail "Benchmark lost replies or failed to start"
+    fi
+}
+
 test_settings_command() {
     info "Testing /settings command..."
 
@@ -4121,6 +5730,73 @@ print('OK')
     fi
 }
 
+test_inbox_gc_quotas() {
+    info "Testing inbox GC: worker/node quotas, TTL, referenced files kept..."
+
+    if python3 -c "
+import os, sys, time, tempfile
+from pathlib import Path
+tmp = Path(tempfile.mkdtemp())
+os.environ['SESSIONS_DIR'] = str(tmp / 'sessions')
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')
+import bridge
+bridge.FILE_INBOX_ROOT = tmp / 'inboxes'
+bridge.INBOX_CACHE_DIR = bridge.FILE_INBOX_ROOT / '_cache'
+
+def put(worker, name, size):
+    path = bridge.ensure_inbox_dir(worker) / name
+    path.write_bytes(b'x' * size)
+    time.sleep(0.01)  # Distinct ctimes give the LRU order
+    return path
+
+mb = 1024 * 1024
+# Worker quota 10000 bytes: a1 is named by a pending message, so a2 and a3 go
+gc = bridge.InboxCollector(interval=60, ttl=0, worker_quota_mb=10000 / mb, node_quota_mb=0)
+a = [put('alice', f'a{i}.png', 4000) for i in range(1, 5)]
+gc.protect('alice', a[0])
+bridge.set_pending('alice', 1)
+gc._protected['alice'][str(a[0])] -= 120  # Delivered before the grace window
+assert gc.sweep() == 2
+assert [p.exists() for p in a] == [True, False, False, True], [p.exists() for p in a]
+assert gc.size_of('alice') == (2, 8000), gc.size_of('alice')
+
+# Node quota counts hardlinked copies once; the cache copy goes with the last link
+bridge.INBOX_CACHE_DIR.mkdir(parents=True)
+shared = bridge.INBOX_CACHE_DIR / 'uniq1.png'
+shared.write_bytes(b'y' * 6000)
+b1 = bridge.link_into_inbox(shared, bridge.ensure_inbox_dir('bob')); time.sleep(0.01)
+c1 = bridge.link_into_inbox(shared, bridge.ensure_inbox_dir('carol')); time.sleep(0.01)
+c2 = put('carol', 'c2.txt', 3000)
+gc = bridge.InboxCollector(interval=60, ttl=0, worker_quota_mb=0, node_quota_mb=10000 / mb)
+gc.protect('alice', a[0]); gc._protected['alice'][str(a[0])] -= 120
+evicted = gc.sweep()
+# Unique bytes 8000 + 6000 + 3000 over 10000: a4 (oldest) goes, then b1 and c1 free the shared copy
+assert not b1.exists() and not c1.exists() and not shared.exists() and c2.exists(), (b1.exists(), c1.exists(), shared.exists())
+assert a[0].exists() and evicted == 3 and not a[3].exists(), evicted
+
+# TTL: everything unused past it goes, except the pending worker's file
+gc = bridge.InboxCollector(interval=60, ttl=3600, worker_quota_mb=0, node_quota_mb=0)
+gc.protect('alice', a[0])
+assert gc.sweep(now=time.time() + 7200) == 1 and a[0].exists() and not c2.exists()
+bridge.clear_pending('alice')
+assert gc.sweep(now=time.time() + 7200) == 1 and not a[0].exists()
+assert not gc._protected and gc.stats['evicted_ttl'] == 2
+
+# Reported on /metrics and /progress
+put('dave', 'd.bin', 2048)
+gc.sweep()
+bridge.inbox_gc = gc
+assert 'inbox_bytes{worker=\"dave\"} 2048' in bridge.metrics.render()
+lines = bridge.format_progress_lines('dave', False, 'claude', True, True, 'tmux', inbox=gc.size_of('dave'))
+assert 'Inbox: 1 file, 2.0 KB' in lines, lines
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Inbox GC enforces quotas and TTL without touching referenced files"
+    else
+        fail "Inbox GC test failed"
+    fi
+}
+
 test_image_path_restriction() {
     info "Testing image path restriction validation..."
 
@@ -4196,17 +5872,44 @@ print('OK')
 }
 
 test_typing_indicator_sent_while_pending() {
-    info "Testing typing indicator sent while pending..."
+    info "Testing typing ticker sends once per chat per tick..."
 
+    # Three workers pending in one chat + one in another: 2 calls per tick, not 4.
+    # A worker whose pending file was removed by the hook is dropped.
     if python3 -c "
-from bridge import send_typing_loop
-
-# Verify typing loop function exists
-assert callable(send_typing_loop), 'send_typing_loop should be callable'
+import bridge
+import unittest.mock as mock
 
+ticker = bridge.TypingTicker(interval=4)
+with mock.patch.object(bridge, 'typing_ticker', ticker), \
+     mock.patch.object(ticker, 'start'), \
+     mock.patch.object(bridge, 'telegram_api') as mock_api:
+    mock_api.return_value = {'ok': True}
+    for name in ('tta', 'ttb', 'ttc'):
+        bridge.set_pending(name, 111)
+    bridge.set_pending('ttd', 222)
+
+    ticker.tick()
+    chats = sorted(c[0][1]['chat_id'] for c in mock_api.call_args_list)
+    assert chats == ['111', '222'], f'expected one call per chat, got {chats}'
+
+    # Immediate re-tick (e.g. wake-up for a new chat) must not double-send
+    mock_api.reset_mock()
+    ticker.tick()
+    assert not mock_api.called, 'no duplicate typing inside one interval'
+
+    # Hook removed the pending file for ttd -> chat 222 stops typing
+    bridge.get_pending_file('ttd').unlink()
+    ticker._last_sent.clear()
+    mock_api.reset_mock()
+    ticker.tick()
+    chats = sorted(c[0][1]['chat_id'] for c in mock_api.call_args_list)
+    assert chats == ['111'], f'expected only chat 111, got {chats}'
+    for name in ('tta', 'ttb', 'ttc'):
+        bridge.clear_pending(name)
 print('OK')
 " 2>/dev/null | grep -q "OK"; then
-        success "Typing indicator function exists"
+        success "Typing ticker dedupes per chat"
     else
         fail "Typing indicator test failed"
     fi
@@ -4461,6 +6164,260 @@ test_hook_transcript_extraction_retry() {
     fi
 }
 
+test_hook_transcript_wait_on_write() {
+    info "Testing hook wakes on transcript write instead of fixed retries..."
+
+    if python3 -c "
+import importlib.util, json, subprocess, sys, tempfile, threading, time
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+transcript = tmp / 'transcript.jsonl'
+offset = tmp / 'transcript_offset'
+helper = 'hooks/transcript-tail.py'
+
+spec = importlib.util.spec_from_file_location('transcript_tail', helper)
+tail = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(tail)
+transcript.write_text('')
+watcher = tail.TranscriptWatcher(str(transcript))
+if sys.platform.startswith('linux'):
+    assert watcher.kind == 'inotify', watcher.kind
+watcher.close()
+
+def line(kind, content):
+    return json.dumps({'type': kind, 'message': {'content': content}}, separators=(',', ':')) + chr(10)
+transcript.write_text(line('user', 'q1'))
+
+# Reply flushed 300 ms after the hook starts: helper returns right after the write
+def late_write():
+    time.sleep(0.3)
+    with transcript.open('a') as f:
+        f.write(line('assistant', [{'type': 'text', 'text': 'late reply'}]))
+threading.Thread(target=late_write).start()
+t = time.monotonic()
+r = subprocess.run(['python3', helper, str(transcript), str(offset), '--wait', '5'], capture_output=True, text=True)
+elapsed = time.monotonic() - t
+assert r.returncode == 0 and r.stdout == 'late reply', (r.returncode, r.stdout)
+assert elapsed < 1.5, f'should wake on write, took {elapsed:.2f}s'
+# Counted from the helper's own start, so interpreter startup is not in it
+wait_ms = json.loads(offset.read_text())['wait_ms']
+assert 0 < wait_ms <= elapsed * 1000, (wait_ms, elapsed)
+
+# Nothing written: gives up after the wait budget
+with transcript.open('a') as f:
+    f.write(line('user', 'q2'))
+r = subprocess.run(['python3', helper, str(transcript), str(offset), '--wait', '0.3'], capture_output=True, text=True)
+assert r.returncode == 1 and r.stdout == ''
+assert json.loads(offset.read_text())['wait_ms'] >= 250
+
+# Bridge records the reported wait and shows it in /progress
+bridge.transcript_wait_stats.update(count=0, total_ms=0, max_ms=0)
+assert bridge.record_transcript_wait('w1', 120) == 120
+assert bridge.record_transcript_wait('w1', 'bogus') is None
+assert bridge.transcript_wait_stats == {'count': 1, 'total_ms': 120, 'max_ms': 120}
+lines = bridge.format_progress_lines('w1', False, 'claude', True, True, 'tmux', transcript_wait_ms=bridge.last_transcript_wait.get('w1'))
+assert 'Last reply flush wait: 120 ms' in lines, lines
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Hook waits on transcript file events"
+    else
+        fail "Hook transcript wait test failed"
+    fi
+
+    if grep -q 'transcript_wait_ms' "$SCRIPT_DIR/hooks/forward-to-bridge.py" && grep -q -- '--wait' "$SCRIPT_DIR/hooks/send-to-telegram.sh"; then
+        success "Hook reports transcript wait to bridge"
+    else
+        fail "Hook does not report transcript wait"
+    fi
+}
+
+test_hook_agent_handoff() {
+    info "Testing Stop hook hands events to the resident hook agent..."
+
+    if ! command -v curl &>/dev/null; then
+        info "Skipping hook agent test (curl not installed)"
+        return 0
+    fi
+
+    # Real hook script + agent + bridge /response handler (enqueue stubbed)
+    if python3 -c "
+import http.client, json, os, subprocess, tempfile, threading, time, urllib.request
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+bridge.SESSIONS_DIR = tmp / 'sessions'
+bridge.TMUX_PREFIX = f'agenttest{os.getpid()}-'
+sent = []
+bridge.enqueue_response = lambda name, text, chat_id, **kw: sent.append((name, text, chat_id)) or True
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), bridge.Handler)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+bridge.PORT = server.server_address[1]
+
+tmux_name = bridge.TMUX_PREFIX + 'w1'
+agent = bridge.HookAgentProcess()
+
+def line(kind, content):
+    return json.dumps({'type': kind, 'message': {'content': content}}, separators=(',', ':')) + chr(10)
+
+def run_hook(transcript, env):
+    event = json.dumps({'transcript_path': str(transcript)})
+    return subprocess.run(['bash', 'hooks/send-to-telegram.sh'], input=event, capture_output=True, text=True, env=env, timeout=20)
+
+try:
+    subprocess.run(['tmux', 'new-session', '-d', '-s', tmux_name], check=True)
+    pane = subprocess.run(['tmux', 'display-message', '-p', '-t', tmux_name, '#{pane_id}'], capture_output=True, text=True).stdout.strip()
+    assert agent.start(), 'agent should start'
+    assert oct(agent.socket_path.stat().st_mode & 0o777) == '0o600'
+
+    d = bridge.ensure_session_dir('w1')
+    (d / 'chat_id').write_text('123')
+    transcript = tmp / 't.jsonl'
+    transcript.write_text(line('user', 'q1') + line('assistant', [{'type': 'text', 'text': '**hi** there'}]))
+    # Only the agent socket and pane in env: no TMUX_PREFIX/SESSIONS_DIR lookups needed
+    env = {'PATH': os.environ['PATH'], 'HOME': str(tmp), 'HOOK_AGENT_SOCKET': str(agent.socket_path), 'TMUX_PANE': pane}
+
+    for turn in (1, 2):
+        (d / 'pending').write_text('1')
+        if turn == 2:
+            with transcript.open('a') as f:
+                f.write(line('user', 'q2') + line('assistant', [{'type': 'text', 'text': 'second'}]))
+        r = run_hook(transcript, env)
+        assert r.returncode == 0, r.stderr
+        assert not (d / 'pending').exists(), 'agent clears pending'
+        deadline = time.time() + 5
+        while time.time() < deadline and len(sent) < turn:
+            time.sleep(0.05)
+    assert sent == [('w1', '<b>hi</b> there', 123), ('w1', 'second', 123)], sent
+    assert bridge.last_transcript_wait.get('w1') is not None, 'agent reports transcript wait'
+
+    stats = json.loads(subprocess.run(['curl', '-s', '--unix-socket', str(agent.socket_path), 'http://hook-agent/stats'], capture_output=True, text=True).stdout)
+    assert stats['forwarded'] == 2 and stats['bridge_connects'] == 1, f'one keep-alive connection: {stats}'
+
+    # Unknown pane -> 404 -> hook takes its normal path (exits: no tmux env for it)
+    r = run_hook(transcript, dict(env, TMUX_PANE='%999999'))
+    assert r.returncode == 0 and len(sent) == 2
+
+    # Draining (hot restart): keep-alive is refused and SIGTERM posts queued replies first
+    server.draining = True
+    conn = http.client.HTTPConnection('127.0.0.1', bridge.PORT, timeout=5)
+    conn.request('POST', '/response', body=b'{}', headers={'Connection': 'keep-alive'})
+    resp = conn.getresponse(); resp.read()
+    assert resp.getheader('Connection') == 'close' and resp.will_close
+    slow = bridge.enqueue_response
+    bridge.enqueue_response = lambda *a, **kw: time.sleep(1) or slow(*a, **kw)
+    for text in ('third', 'fourth'):  # fourth waits in the outbox behind the slow third
+        (d / 'pending').write_text('1')
+        with transcript.open('a') as f:
+            f.write(line('user', 'q') + line('assistant', [{'type': 'text', 'text': text}]))
+        assert run_hook(transcript, env).returncode == 0
+    agent.stop(timeout=10)
+    assert sent[2:] == [('w1', 'third', 123), ('w1', 'fourth', 123)], sent
+
+    # BridgeClient: a stale idle socket is replaced, a POST lost after the write is not resent
+    from http.server import BaseHTTPRequestHandler
+    posts, actions = [], ['reply_close', 'reply', 'drop', 'reply']
+    class Bridge(BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.1'
+        def do_POST(self):
+            posts.append(self.rfile.read(int(self.headers['Content-Length'])))
+            self.close_connection = actions[0] != 'reply'
+            if actions.pop(0) == 'drop':
+                return
+            self.send_response(200)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+        def log_message(self, *a):
+            pass
+    fake = bridge.ReuseAddrServer(('127.0.0.1', 0), Bridge)
+    threading.Thread(target=fake.serve_forever, daemon=True).start()
+    client = bridge.load_hook_module('hook_agent', 'hook-agent.py').BridgeClient(f'http://127.0.0.1:{fake.server_address[1]}/response')
+    assert client.post({'n': 1}) == 200
+    time.sleep(0.2)  # Bridge closed the idle connection
+    assert client.post({'n': 2}) == 200 and client.connects == 2
+    try:
+        client.post({'n': 3})  # Bridge read it, then the connection died
+        raise AssertionError('POST lost after the write should raise')
+    except http.client.RemoteDisconnected:
+        pass
+    assert [json.loads(p)['n'] for p in posts] == [1, 2, 3], posts
+    fake.shutdown()
+finally:
+    agent.stop()
+    os.system(f'tmux kill-session -t {tmux_name} 2>/dev/null')
+    server.shutdown()
+assert not agent.socket_path.exists(), 'socket removed on stop'
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Stop hook hands events to the hook agent"
+    else
+        fail "Hook agent handoff test failed"
+    fi
+}
+
+test_hook_transcript_incremental_tail() {
+    info "Testing hook transcript tail reads only appended bytes..."
+
+    if python3 -c "
+import json, os, subprocess, tempfile
+from pathlib import Path
+
+tmp = Path(tempfile.mkdtemp())
+transcript = tmp / 'transcript.jsonl'
+offset = tmp / 'transcript_offset'
+helper = 'hooks/transcript-tail.py'
+
+def user(text):
+    return json.dumps({'type': 'user', 'message': {'content': text}}, separators=(',', ':')) + chr(10)
+def assistant(text):
+    return json.dumps({'type': 'assistant', 'message': {'content': [{'type': 'text', 'text': text}]}}, separators=(',', ':')) + chr(10)
+def run():
+    r = subprocess.run(['python3', helper, str(transcript), str(offset)], capture_output=True, text=True)
+    return r.returncode, r.stdout
+def state():
+    return json.loads(offset.read_text())
+
+# No user message yet -> exit 2 (hook clears pending)
+transcript.write_text(assistant('boot'))
+assert run()[0] == 2
+
+# Turn 1: only text after the last user message
+with transcript.open('a') as f:
+    f.write(user('q1') + assistant('old answer') + user('q2') + assistant('part one') + assistant('(no content)') + assistant('part two'))
+rc, out = run()
+assert rc == 0 and out == 'part one' + chr(10) * 2 + 'part two', repr(out)
+assert state()['scanned'] == transcript.stat().st_size
+assert oct(offset.stat().st_mode & 0o777) == '0o600'
+
+# Turn 2: scan resumes at the saved offset; a partial trailing line is not consumed
+before = state()['scanned']
+tail = user('q3') + assistant('new answer')
+with transcript.open('a') as f:
+    f.write(tail + '{\"type\":\"us')
+rc, out = run()
+assert rc == 0 and out == 'new answer', repr(out)
+assert state()['scanned'] == before + len(tail.encode()), 'partial line must be rescanned later'
+assert state()['last_user'] == before
+
+# User message, no reply yet -> exit 1 (hook retries)
+with transcript.open('a') as f:
+    f.write('er\",\"message\":{\"content\":\"q4\"}}' + chr(10))
+assert run()[0] == 1
+
+# New transcript (relaunch) or shrink -> state resets
+transcript.write_text(user('fresh') + assistant('fresh answer'))
+rc, out = run()
+assert rc == 0 and out == 'fresh answer', repr(out)
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Hook transcript tail is incremental"
+    else
+        fail "Hook transcript incremental tail test failed"
+    fi
+}
+
 test_hook_tmux_fallback_warning() {
     info "Testing hook tmux fallback warning..."
 
@@ -4638,6 +6595,352 @@ print('OK')
 # Document & Image Security Tests (NEW)
 # ─────────────────────────────────────────────────────────────────────────────
 
+test_download_streamed_and_deduplicated() {
+    info "Testing inbound downloads stream to disk and dedupe by file_unique_id..."
+
+    if python3 -c "
+import json, os, tempfile, threading, tracemalloc
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+files = {'photos/a.png': os.urandom(4 * 1024 * 1024), 'docs/big.log': b'x' * 5000, 'docs/n.txt': b'plain'}
+calls = []
+class Telegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def reply(self, body):
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    def do_POST(self):
+        req = json.loads(self.rfile.read(int(self.headers['Content-Length'])))
+        calls.append('getFile')
+        self.reply(json.dumps({'ok': True, 'result': {'file_path': req['file_id']}}).encode())
+    def do_GET(self):
+        calls.append('download')
+        self.reply(files[self.path.split('/', 3)[3]])
+    def log_message(self, *a):
+        pass
+
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Telegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+bridge.telegram_pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_address[1]}')
+bridge.BOT_TOKEN = '123:fake'
+bridge.FILE_INBOX_ROOT = Path(tempfile.mkdtemp())
+bridge.INBOX_CACHE_DIR = bridge.FILE_INBOX_ROOT / '_cache'
+
+# First delivery: streamed into the cache, hardlinked into the inbox
+tracemalloc.start()
+p1 = Path(bridge.download_telegram_file('photos/a.png', 'w1', 'AQADuid-1'))
+peak = tracemalloc.get_traced_memory()[1]
+tracemalloc.stop()
+assert peak < 1024 * 1024, f'download buffered the file: peak {peak}'
+assert p1.parent == bridge.get_inbox_dir('w1') and p1.suffix == '.png'
+assert p1.read_bytes() == files['photos/a.png']
+assert p1.stat().st_nlink == 2 and oct(p1.stat().st_mode & 0o777) == '0o400'
+assert calls == ['getFile', 'download']
+
+# Same file to another worker: no getFile, no download, same inode
+p2 = Path(bridge.download_telegram_file('photos/a.png', 'w2', 'AQADuid-1'))
+assert calls == ['getFile', 'download'], calls
+assert p2.parent == bridge.get_inbox_dir('w2') and os.path.samefile(p1, p2)
+cached = bridge.find_cached_file('AQADuid-1')
+assert cached and cached.stat().st_nlink == 3
+
+# Running size limit (getFile reported no size); partial file removed
+bridge.MAX_FILE_SIZE = 1000
+assert bridge.download_telegram_file('docs/big.log', 'w1', 'AQADbig') is None
+assert bridge.find_cached_file('AQADbig') is None
+assert not [f for f in bridge.INBOX_CACHE_DIR.iterdir() if f.name.endswith('.part')]
+bridge.MAX_FILE_SIZE = 20 * 1024 * 1024
+
+# No unique id: straight into the inbox
+p3 = Path(bridge.download_telegram_file('docs/n.txt', 'w1'))
+assert p3.read_bytes() == b'plain' and p3.stat().st_nlink == 1 and oct(p3.stat().st_mode & 0o777) == '0o600'
+
+# cleanup_inbox keeps the single copy while any inbox links it
+bridge.cleanup_inbox('w1')
+assert cached.exists() and p2.exists()
+bridge.cleanup_inbox('w2')
+assert not cached.exists(), 'unreferenced cache entry pruned'
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Downloads stream to disk and dedupe by file_unique_id"
+    else
+        fail "Streamed/deduplicated download test failed"
+    fi
+}
+
+test_media_albums_parallel() {
+    info "Testing multi-image responses go out as parallel sendMediaGroup albums..."
+
+    # Mock Telegram: every upload takes 0.4s; albums containing bad.txt are rejected,
+    # uploads containing lost.txt get no answer
+    if python3 -c "
+import json, re, tempfile, threading, time
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+calls = []
+class Telegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers['Content-Length']))
+        method = self.path.rsplit('/', 1)[1]
+        ok = True
+        if method != 'sendMessage':
+            time.sleep(0.4)
+            ok = not (method == 'sendMediaGroup' and b'bad.txt' in body)
+        names = re.findall(rb'filename=\"([^\"]+)\"', body)
+        media = re.search(rb'name=\"media\"\r\n\r\n(.*?)\r\n--', body, re.S)
+        calls.append((method, [n.decode() for n in names], json.loads(media.group(1)) if media else None, time.monotonic()))
+        if b'lost.txt' in body:
+            self.close_connection = True
+            return
+        reply = json.dumps({'ok': ok, 'result': {'message_id': len(calls)}}).encode()
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+    def log_message(self, *a):
+        pass
+
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Telegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_address[1]}')
+bridge.telegram_pool = pool
+bridge.BOT_TOKEN = '123:fake'
+bridge.outbound.telegram = bridge.TelegramAPI('123:fake', pool)
+
+tmp = Path(tempfile.mkdtemp(dir='/tmp'))
+for i in range(12):
+    (tmp / f'chart{i}.png').write_bytes(b'png' * 100)
+for n in ('a.txt', 'b.txt', 'bad.txt', 'lost.txt'):
+    (tmp / n).write_text(n)
+
+# 12 charts -> two albums of 6, uploaded at the same time
+assert [len(b) for b in bridge.plan_media_batches('photo', [(i, '') for i in range(12)])] == [6, 6]
+assert [len(b) for b in bridge.plan_media_batches('photo', [(1, 'x' * 2000), (2, ''), (3, '')])] == [2, 1]
+images = [(str(tmp / f'chart{i}.png'), f'c{i}') for i in range(12)]
+t = time.monotonic()
+bridge.send_media('w1', 1001, images, [])
+elapsed = time.monotonic() - t
+albums = [c for c in calls if c[0] == 'sendMediaGroup']
+assert len(calls) == 2 and len(albums) == 2, [c[:2] for c in calls]
+assert elapsed < 0.75, f'albums should upload in parallel, took {elapsed:.2f}s'
+assert albums[0][2][0] == {'type': 'photo', 'media': 'attach://file0', 'caption': 'w1: c0'} or albums[1][2][0]['caption'] == 'w1: c0'
+assert sorted(n for c in albums for n in c[1]) == sorted(f'chart{i}.png' for i in range(12))
+
+# Rejected album falls back to single sends; invalid path gets the failure notice
+calls.clear()
+bridge.send_media('w1', 1002, [(str(tmp / 'missing.png'), '')], [(str(tmp / n), '') for n in ('a.txt', 'bad.txt', 'b.txt')])
+methods = [c[0] for c in calls]
+assert methods.count('sendMediaGroup') == 1 and methods.count('sendDocument') == 3, methods
+texts = [c for c in calls if c[0] == 'sendMessage']
+assert len(texts) == 1, methods
+
+# Album with no answer may have been posted: not resent item by item
+calls.clear()
+bridge.send_media('w1', 1003, [], [(str(tmp / n), '') for n in ('a.txt', 'lost.txt')])
+methods = [c[0] for c in calls]
+assert methods == ['sendMediaGroup', 'sendMessage', 'sendMessage'], methods
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Media goes out as parallel sendMediaGroup albums"
+    else
+        fail "Media album/parallel upload test failed"
+    fi
+}
+
+test_streaming_drafts() {
+    info "Testing partial output streams into one edited draft message..."
+
+    if python3 -c "
+import json, os, sys, tempfile, threading, time
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+out, sys.stdout = sys.stdout, open(os.devnull, 'w')  # Bridge logs say 'Telegram OK'
+calls = []
+class Telegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        body = json.loads(self.rfile.read(int(self.headers['Content-Length'])))
+        calls.append((self.path.rsplit('/', 1)[1], body))
+        reply = json.dumps({'ok': True, 'result': {'message_id': 100 + len(calls)}}).encode()
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+    def log_message(self, *a):
+        pass
+
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Telegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_address[1]}')
+bridge.telegram_pool = pool
+bridge.BOT_TOKEN = '123:fake'
+bridge.outbound.telegram = bridge.TelegramAPI('123:fake', pool)
+bridge.SESSIONS_DIR = Path(tempfile.mkdtemp(dir='/tmp'))
+bridge.draft_streamer = streamer = bridge.DraftStreamer(interval=0.3)
+
+def wait_for(cond, timeout=3):
+    deadline = time.time() + timeout
+    while time.time() < deadline and not cond():
+        time.sleep(0.02)
+    return cond()
+
+# First partial goes out at once; a burst inside the interval is one edit with the latest text
+bridge.set_pending('w1', 555)
+assert streamer.update('w1', 555, 'Looking <at> the repo')
+assert wait_for(lambda: len(calls) == 1)
+assert calls[0][0] == 'sendMessage' and calls[0][1]['text'] == '<b>w1:</b>' + chr(10) + 'Looking &lt;at&gt; the repo …'
+for i in range(5):
+    streamer.update('w1', 555, f'Step {i}')
+assert wait_for(lambda: len(calls) == 2)
+time.sleep(0.4)
+assert len(calls) == 2 and calls[1][0] == 'editMessageText', calls
+assert calls[1][1]['message_id'] == 101 and 'Step 4' in calls[1][1]['text']
+
+# Final response edits the draft into its first chunk; the rest are new messages
+final = 'x' * 5000
+assert bridge.enqueue_response('w1', final, 555)
+assert wait_for(lambda: len(calls) == 4)
+assert calls[2][0] == 'editMessageText' and calls[2][1]['message_id'] == 101 and calls[2][1]['text'].endswith('x')
+assert calls[3][0] == 'sendMessage' and calls[3][1]['reply_to_message_id'] == 101
+assert not streamer.update('w1', 555, 'late partial'), 'closed draft drops late partials'
+bridge.set_pending('w1', 555)
+assert streamer.update('w1', 555, 'next turn')
+assert wait_for(lambda: len(calls) == 5) and calls[4][0] == 'sendMessage'
+
+# Long partials keep the tail; tags are stripped
+html = bridge.render_draft('w1', '[[image:/tmp/a.png]]' + '&' * 3000 + 'END')
+assert len(html) <= bridge.TELEGRAM_MAX_LENGTH and html.endswith('END …') and 'image:' not in html
+
+# Claude: the poller peeks the transcript only once a new user message exists
+tmp = Path(tempfile.mkdtemp(dir='/tmp'))
+transcript = tmp / 't.jsonl'
+user = json.dumps({'type': 'user', 'message': {'content': 'hi'}}, separators=(',', ':'))
+asst = lambda t: json.dumps({'type': 'assistant', 'message': {'content': [{'type': 'text', 'text': t}]}}, separators=(',', ':'))
+transcript.write_text(user + chr(10) + asst('old reply') + chr(10))
+tail = bridge.load_hook_module('transcript_tail', 'transcript-tail.py')
+offset = bridge.get_session_dir('w2') / 'transcript_offset'
+bridge.set_pending('w2', 556)
+tail.read_reply(str(transcript), str(offset))
+seen = []
+streamer.update = lambda name, chat, text: seen.append((name, chat, text))
+poller = bridge.TranscriptDraftPoller()
+poller._tail = tail
+saved = offset.read_text()
+poller.poll()
+assert seen == [], 'previous turn is not a draft'
+with open(transcript, 'a') as f:
+    f.write(user + chr(10) + asst('thinking about it') + chr(10))
+poller.poll()
+assert seen == [('w2', '556', 'thinking about it')], seen
+assert offset.read_text() == saved, 'poller never writes the offset file'
+
+# Codex: partials as agent messages complete
+codex = bridge.load_hook_module('codex_adapter', 'codex-tmux-adapter.py')
+(tmp / 'bin').mkdir()
+fake = tmp / 'bin' / 'codex'
+fake.write_text(chr(10).join(['#!/bin/sh', 'cat > /dev/null',
+    'echo \'{\"type\":\"thread.started\",\"thread_id\":\"t1\"}\'',
+    'echo \'{\"type\":\"item.completed\",\"item\":{\"type\":\"agent_message\",\"text\":\"one\"}}\'',
+    'echo \'{\"type\":\"item.completed\",\"item\":{\"type\":\"agent_message\",\"text\":\"two\"}}\'']))
+fake.chmod(0o755)
+os.environ['PATH'] = f'{tmp}/bin:' + os.environ['PATH']
+partials = []
+response, sid, rc = codex.run_codex('go', '', '', partials.append)
+assert partials == ['one', 'one' + chr(10) + 'two'] and response == partials[-1] and sid == 't1' and rc == 0, partials
+server.shutdown()
+print('OK', file=out)
+" 2>/dev/null | grep -q "OK"; then
+        success "Partial output streams into one edited draft"
+    else
+        fail "Streaming draft test failed"
+    fi
+}
+
+test_streaming_multipart_upload() {
+    info "Testing file uploads stream from disk with a known length..."
+
+    # Mock Telegram server hashes the body in chunks; tracemalloc checks no full-file buffer
+    if python3 -c "
+import hashlib, json, os, tempfile, threading, tracemalloc
+from http.server import BaseHTTPRequestHandler
+from pathlib import Path
+import bridge
+
+seen = []
+class Telegram(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    def do_POST(self):
+        length = int(self.headers['Content-Length'])
+        digest, received, head = hashlib.sha256(), 0, b''
+        while received < length:
+            chunk = self.rfile.read(min(65536, length - received))
+            if len(head) < 4096:
+                head += chunk[:4096]
+            digest.update(chunk)
+            received += len(chunk)
+        seen.append({'path': self.path, 'length': received, 'sha': digest.hexdigest(), 'head': head,
+                     'chunked': self.headers.get('Transfer-Encoding'), 'type': self.headers['Content-Type']})
+        body = json.dumps({'ok': True}).encode()
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    def log_message(self, *a):
+        pass
+
+server = bridge.ReuseAddrServer(('127.0.0.1', 0), Telegram)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+bridge.telegram_pool = bridge.TelegramConnectionPool(f'http://127.0.0.1:{server.server_address[1]}')
+bridge.BOT_TOKEN = '123:fake'
+
+tmp = Path(tempfile.mkdtemp(dir='/tmp'))
+doc = tmp / 'build.zip'
+doc.write_bytes(os.urandom(8 * 1024 * 1024))
+photo = tmp / 'shot.png'
+photo.write_bytes(os.urandom(1024))
+
+tracemalloc.start()
+assert bridge.send_document(42, doc, 'artifact')
+peak = tracemalloc.get_traced_memory()[1]
+tracemalloc.stop()
+assert peak < 2 * 1024 * 1024, f'upload buffered the file: peak {peak} bytes'
+assert bridge.send_photo(42, photo)
+
+d, p = seen
+body = bridge.MultipartBody({'chat_id': 42, 'caption': 'artifact'}, [('document', doc, 'application/zip')])
+assert d['path'] == '/bot123:fake/sendDocument' and d['chunked'] is None
+assert d['length'] == len(body), 'Content-Length matches the streamed body'
+boundary = d['type'].split('boundary=')[1]
+assert d['head'].startswith(f'--{boundary}'.encode())
+assert b'name=\"chat_id\"' in d['head'] and b'artifact' in d['head'] and b'filename=\"build.zip\"' in d['head']
+assert p['path'].endswith('/sendPhoto') and b'name=\"photo\"' in p['head']
+
+# Body is re-iterable (stale-connection retry resends it) and frames the file exactly
+whole = b''.join(body)
+assert whole == b''.join(body) and len(whole) == len(body)
+start = whole.index(b'\r\n\r\n', whole.index(b'filename=')) + 4
+assert whole[start:start + doc.stat().st_size] == doc.read_bytes()
+assert whole.endswith(f'\r\n--{body.boundary}--\r\n'.encode())
+server.shutdown()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Uploads stream from disk with Content-Length"
+    else
+        fail "Streaming multipart upload test failed"
+    fi
+}
+
 test_document_no_path_restriction() {
     info "Testing documents can be sent from any path..."
 
@@ -5263,69 +7566,148 @@ print('OK')
 }
 
 test_pipe_reader_liveness_check() {
-    info "Testing pipe reader restarts when thread dies..."
+    info "Testing pipe multiplexer restarts when its thread dies..."
 
     if python3 -c "
-import threading, time
-from bridge import (
-    start_pipe_reader, stop_pipe_reader, _pipe_reader_threads,
-    get_worker_pipe_path, ensure_worker_pipe, cleanup_worker_pipe
-)
+import os, time
+import bridge
+from bridge import start_pipe_reader, get_worker_pipe_path, ensure_worker_pipe, cleanup_worker_pipe, pipe_mux
+
+got = []
+bridge._forward_pipe_message = lambda name, msg: got.append((name, msg))
+
+def wait_for(cond):
+    deadline = time.time() + 2
+    while time.time() < deadline and not cond():
+        time.sleep(0.01)
+    return cond()
 
 test_name = 'liveness_test'
 pipe_path = get_worker_pipe_path(test_name)
-
-# Setup: create pipe
 pipe_path.parent.mkdir(parents=True, exist_ok=True, mode=0o700)
 ensure_worker_pipe(test_name)
-
-# Verify reader thread is alive
-assert test_name in _pipe_reader_threads, 'Thread should be registered'
-thread1, stop1 = _pipe_reader_threads[test_name]
-assert thread1.is_alive(), 'Thread should be alive initially'
-thread1_id = thread1.ident
-
-# Simulate crash: stop the thread but leave a dead entry in the registry
-stop1.set()
-# Unblock reader by writing to pipe
-import os
-try:
-    fd = os.open(str(pipe_path), os.O_WRONLY | os.O_NONBLOCK)
-    os.write(fd, b'\n')
-    os.close(fd)
-except OSError:
-    pass
-thread1.join(timeout=2.0)
-
-# Manually re-insert the dead thread to simulate a crash leaving stale entry
-_pipe_reader_threads[test_name] = (thread1, stop1)
-assert not thread1.is_alive(), 'Thread should be dead after stop'
-assert test_name in _pipe_reader_threads, 'Stale entry should exist'
-
-# Now call start_pipe_reader — it should detect dead thread and restart
+assert pipe_mux.is_running() and wait_for(lambda: test_name in pipe_mux.readers())
+thread1 = pipe_mux._thread
+
+# Simulate a crash inside the selector loop
+real_read = pipe_mux._read
+def boom(state):
+    raise RuntimeError('simulated crash')
+pipe_mux._read = boom
+with open(pipe_path, 'w') as f:
+    f.write('lost' + chr(10))
+assert wait_for(lambda: not thread1.is_alive()), 'Thread should die'
+pipe_mux._read = real_read
+
+# start_pipe_reader restarts the thread; the unread line survives the crash
 start_pipe_reader(test_name)
+assert pipe_mux.is_running() and pipe_mux._thread is not thread1
+with open(pipe_path, 'w') as f:
+    f.write('after restart' + chr(10))
+assert wait_for(lambda: got == [(test_name, 'lost'), (test_name, 'after restart')]), got
 
-assert test_name in _pipe_reader_threads, 'New thread should be registered'
-thread2, stop2 = _pipe_reader_threads[test_name]
-assert thread2.is_alive(), 'New thread should be alive'
-assert thread2.ident is not thread1_id, 'Should be a different thread'
-
-# Cleanup
 cleanup_worker_pipe(test_name)
-if pipe_path.parent.exists():
-    try:
-        pipe_path.parent.rmdir()
-    except:
-        pass
-
+pipe_mux.stop()
 print('OK')
 " 2>/dev/null | grep -q "OK"; then
-        success "Pipe reader detects dead thread and restarts"
+        success "Pipe multiplexer detects dead thread and restarts"
     else
         fail "Pipe reader liveness check failed"
     fi
 }
 
+test_pipe_multiplexer_single_thread() {
+    info "Testing one multiplexer thread reads every worker pipe with framing..."
+
+    if python3 -c "
+import os, tempfile, threading, time
+from pathlib import Path
+import bridge
+
+bridge.SESSIONS_DIR = Path(tempfile.mkdtemp(dir='/tmp'))
+got = []
+bridge._forward_pipe_message = lambda name, msg: got.append((name, msg))
+
+def wait_for(cond):
+    deadline = time.time() + 3
+    while time.time() < deadline and not cond():
+        time.sleep(0.01)
+    return cond()
+
+before = threading.active_count()
+names = [f'w{i}' for i in range(50)]
+for n in names:
+    bridge.ensure_worker_pipe(n)
+assert threading.active_count() - before == 1, 'one thread for all pipes'
+assert wait_for(lambda: bridge.pipe_mux.readers() == sorted(names))
+
+# One line per message, across writers that open and close the FIFO
+for n in names:
+    with open(bridge.get_worker_pipe_path(n), 'w') as f:
+        f.write(f'hello {n}' + chr(10))
+assert wait_for(lambda: len(got) == 50), len(got)
+assert sorted(got) == sorted((n, f'hello {n}') for n in names)
+
+# <<< ... >>> frames one multi-line message; split writes are reassembled
+got.clear()
+path = bridge.get_worker_pipe_path('w1')
+fd = os.open(path, os.O_WRONLY)
+os.write(fd, b'<<<' + bytes([10]) + b'line 1' + bytes([10]) + b'li')
+time.sleep(0.05)
+os.write(fd, b'ne 2' + bytes([10]) + b'>>>' + bytes([10]) + b'single' + bytes([10]))
+os.close(fd)
+assert wait_for(lambda: len(got) == 2), got
+assert got == [('w1', 'line 1' + chr(10) + 'line 2'), ('w1', 'single')], got
+
+# An oversized frame is dropped up to its >>>; one never closed times out
+got.clear()
+bridge.PIPE_FRAME_MAX, bridge.PIPE_FRAME_TIMEOUT = 16, 0.3
+fd = os.open(path, os.O_WRONLY)
+os.write(fd, bytes([10]).join([b'<<<', b'x' * 20, b'more', b'>>>', b'after big', b'<<<', b'never closed', b'']))
+assert wait_for(lambda: got == [('w1', 'after big')]), got
+t = time.monotonic()
+assert wait_for(lambda: bridge.pipe_mux._pipes['w1'].frame is None), 'open frame expires'
+assert time.monotonic() - t < 1.0
+os.write(fd, b'next' + bytes([10]))
+os.close(fd)
+assert wait_for(lambda: got == [('w1', 'after big'), ('w1', 'next')]), got
+bridge.PIPE_FRAME_MAX, bridge.PIPE_FRAME_TIMEOUT = 1048576, 30.0
+
+# Stopping a reader is immediate and does not touch the others
+t = time.monotonic()
+for n in names[:25]:
+    bridge.cleanup_worker_pipe(n)
+assert time.monotonic() - t < 0.5
+assert wait_for(lambda: bridge.pipe_mux.readers() == sorted(names[25:]))
+got.clear()
+with open(bridge.get_worker_pipe_path('w30'), 'w') as f:
+    f.write('still here' + chr(10))
+assert wait_for(lambda: got == [('w30', 'still here')]), got
+
+# A slow send to one worker does not hold up the selector or other workers
+got.clear()
+release = threading.Event()
+def forward(name, msg):
+    if name == 'w30':
+        release.wait(5)
+    got.append((name, msg))
+bridge._forward_pipe_message = forward
+for n, msg in (('w30', 'slow 1'), ('w30', 'slow 2'), ('w31', 'fast')):
+    with open(bridge.get_worker_pipe_path(n), 'w') as f:
+        f.write(msg + chr(10))
+assert wait_for(lambda: got == [('w31', 'fast')]), got
+release.set()
+assert wait_for(lambda: len(got) == 3), got
+assert got[1:] == [('w30', 'slow 1'), ('w30', 'slow 2')], got
+bridge.pipe_mux.stop()
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "One multiplexer thread reads all worker pipes"
+    else
+        fail "Pipe multiplexer test failed"
+    fi
+}
+
 # ─────────────────────────────────────────────────────────────────────────────
 # Worker-to-Worker Pipe Communication Tests (TDD)
 # ─────────────────────────────────────────────────────────────────────────────
@@ -5808,6 +8190,61 @@ print('OK')
     fi
 }
 
+test_telegram_html_shared_renderer() {
+    info "Testing shared markdown renderer and markup-safe splitting..."
+
+    # Hook and bridge use one module; long <pre> blocks split into valid HTML chunks
+    if python3 -c "
+import re
+from importlib.util import spec_from_loader, module_from_spec
+from importlib.machinery import SourceFileLoader
+import bridge
+
+spec = spec_from_loader('forward_to_bridge', SourceFileLoader('forward_to_bridge', 'hooks/forward-to-bridge.py'))
+forward = module_from_spec(spec)
+spec.loader.exec_module(forward)
+md = forward.markdown_to_html
+assert md is forward.telegram_html.markdown_to_html
+assert bridge.split_message.__doc__ and bridge.telegram_html.split_html
+
+assert md('**bold** and *it* ' + chr(96) + 'a<b' + chr(96)) == '<b>bold</b> and <i>it</i> <code>a&lt;b</code>'
+fence = chr(96) * 3
+assert md(fence + 'py' + chr(10) + 'x < 1' + chr(10) + fence) == '<pre><code class=\"language-py\">x &lt; 1</code></pre>'
+assert md('* one' + chr(10) + '* two') == '* one' + chr(10) + '* two', 'list bullets are not italic'
+assert md('*x ' + chr(96) + 'a*b' + chr(96)) == '*x <code>a*b</code>', 'code wins over a half-open italic'
+assert md('**a *b* c**') == '<b>a <i>b</i> c</b>'
+
+# 60 KB code block plus text: every chunk fits, is balanced and never cuts an entity
+body = chr(10).join('row %d: a &amp;&amp; b &lt; c' % i for i in range(2500))
+html = 'Intro' + chr(10) + chr(10) + '<pre><code class=\"language-sh\">' + body + '</code></pre>' + chr(10) + 'Done <b>ok</b>'
+chunks = bridge.split_message(html, 4000)
+assert len(chunks) > 10
+for c in chunks:
+    assert len(c) <= 4000, len(c)
+    assert c.count('<pre>') == c.count('</pre>') and c.count('<code') == c.count('</code>')
+    assert not re.search(r'&[a-z]*$', c.split('</code>')[0]), 'entity cut'
+assert chunks[1].startswith('<pre><code class=\"language-sh\">'), 'tags reopened'
+strip = lambda c: re.sub(r'<[^>]+>', '', c)
+assert ''.join(strip(c) for c in chunks).replace(chr(10), '') == strip(html).replace(chr(10), '')
+
+# Plain text keeps the old rules: newline breaks, hard cut with nothing lost
+lines = chr(10).join('Line ' + str(i) + ' ' + 'x' * 100 for i in range(50))
+assert all(c.endswith('x') for c in bridge.split_message(lines, 4096))
+assert [len(c) for c in bridge.split_message('x' * 10000, 4096)] == [4096, 4096, 1808]
+
+# One scan finds both media tag kinds; code spans are left alone
+clean, images, files = bridge.parse_media_tags(
+    'see [[file:' + bridge.__file__ + '|src]] ' + chr(96) + '[[file:/etc/hosts]]' + chr(96) + chr(10) * 4 + 'end')
+assert files == [(bridge.__file__, 'src')] and images == []
+assert clean == 'see  ' + chr(96) + '[[file:/etc/hosts]]' + chr(96) + chr(10) * 2 + 'end', repr(clean)
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Hook and bridge share one renderer; splits keep HTML valid"
+    else
+        fail "Shared renderer test failed"
+    fi
+}
+
 test_backend_registry_exists() {
     info "Testing backend registry exists and contains expected backends..."
 
@@ -5882,6 +8319,90 @@ print('OK')
     fi
 }
 
+test_worker_registry_cached() {
+    info "Testing worker registry is cached between reads..."
+
+    # Reads reuse the registry (no tmux scan); refresh/invalidate rescan;
+    # with the reconcile thread alive a stale registry is still served.
+    if python3 -c "
+import tempfile, threading
+from pathlib import Path
+import bridge
+
+tmp = Path(tempfile.mkdtemp())
+bridge.SESSIONS_DIR = tmp
+wm = bridge.worker_manager
+scans = [0]
+workers = {'alice': {'tmux': bridge.TMUX_PREFIX + 'alice', 'backend': 'claude'}}
+def fake_scan():
+    scans[0] += 1
+    return {k: dict(v) for k, v in workers.items()}
+wm.scan_tmux_sessions = fake_scan
+
+for _ in range(5):
+    assert 'alice' in bridge.get_registered_sessions()
+assert scans[0] == 1, f'expected 1 scan for 5 reads, got {scans[0]}'
+
+# Callers get a copy; mutating it does not poison the registry
+bridge.get_registered_sessions()['alice']['backend'] = 'codex'
+assert bridge.get_registered_sessions()['alice']['backend'] == 'claude'
+
+# hire/end/restart and /team call refresh()
+workers['bob'] = {'tmux': bridge.TMUX_PREFIX + 'bob', 'backend': 'claude'}
+assert 'bob' not in bridge.get_registered_sessions()
+wm.refresh()
+assert 'bob' in bridge.get_registered_sessions()
+assert scans[0] == 2
+
+# Stale + reconcile thread alive -> served from memory, no scan
+wm._registry_at = 0
+stop = threading.Event()
+wm._reconcile_thread = threading.Thread(target=stop.wait, daemon=True)
+wm._reconcile_thread.start()
+bridge.get_registered_sessions()
+assert scans[0] == 2, f'reconcile thread owns rescans, got {scans[0]}'
+stop.set(); wm._reconcile_thread.join()
+
+# Stale and no reconcile thread -> read rescans
+bridge.get_registered_sessions()
+assert scans[0] == 3, f'stale registry should rescan, got {scans[0]}'
+
+# Changing SESSIONS_DIR drops the registry
+bridge.SESSIONS_DIR = Path(tempfile.mkdtemp())
+bridge.get_registered_sessions()
+assert scans[0] == 4
+
+# A reconcile scan that started before a hire's refresh cannot undo it
+release, scanning = threading.Event(), threading.Event()
+def slow_scan():
+    snapshot = {k: dict(v) for k, v in workers.items()}
+    scanning.set()
+    release.wait(5)
+    return snapshot
+wm.scan_tmux_sessions = slow_scan
+reconcile = threading.Thread(target=wm.refresh)
+reconcile.start()
+assert scanning.wait(5)
+workers['carol'] = {'tmux': bridge.TMUX_PREFIX + 'carol', 'backend': 'claude'}
+wm.scan_tmux_sessions = fake_scan
+assert 'carol' in wm.refresh()
+release.set(); reconcile.join()
+assert 'carol' in bridge.get_registered_sessions(), 'stale scan overwrote the registry'
+
+# No entry point takes a scan from outside the generation check (startup uses refresh())
+for fn in (bridge.get_registered_sessions, wm.get_registered_sessions):
+    try:
+        fn({'ghost': {}}); raise SystemExit('outside scan accepted')
+    except TypeError:
+        pass
+print('OK')
+" 2>/dev/null | grep -q "OK"; then
+        success "Worker registry cached between reads"
+    else
+        fail "Worker registry cache test failed"
+    fi
+}
+
 test_direct_mode_graceful_shutdown() {
     info "Testing graceful_shutdown kills direct workers..."
 
@@ -7437,13 +9958,16 @@ run_unit_tests() {
     test_equals_syntax
     test_sandbox_config
     test_sandbox_docker_cmd
+    test_sandbox_container_reuse
 
     # Unit tests - Backend registry / non-interactive mode
     log ""
     log "── Backend Registry Tests (Unit) ───────────────────────────────────────"
     test_forward_to_bridge_html_escape
+    test_telegram_html_shared_renderer
     test_backend_registry_exists
     test_get_registered_sessions_includes_noninteractive_workers
+    test_worker_registry_cached
 
     # Unit tests - Worker naming
     log ""
@@ -7460,9 +9984,14 @@ run_unit_tests() {
     test_codex_pause_clears_pending
     test_get_workers_includes_codex
     test_pipe_forwarding_to_codex
+    test_adapter_queue_ordered_merge
+    test_adapter_agent_resident
     test_codex_response_requires_escape
     test_update_bot_commands_includes_codex
     test_broadcast_includes_codex
+    test_broadcast_fan_out
+    test_worker_hosts_sharding
+    test_hot_restart_handoff
 
     # Unit tests - Security constants
     log ""
@@ -7477,12 +10006,25 @@ run_unit_tests() {
     log "── Persistence Functions Tests (Unit) ──────────────────────────────────"
     test_persistence_file_functions
     test_pending_auto_timeout
+    test_session_state_store
     test_pending_set_and_clear
+    test_response_keeps_next_turn_pending
 
     # Unit tests - Concurrency
     log ""
     log "── Concurrency Tests (Unit) ────────────────────────────────────────────"
     test_tmux_send_locks
+    test_tmux_control_channel
+    test_pane_stream_ring_buffer
+    test_hire_readiness_driven
+    test_worker_pool_claim
+    test_telegram_connection_pool_reuse
+    test_outbound_dispatcher_rate_limit
+    test_webhook_ack_and_update_dedupe
+    test_update_poller_offset
+    test_metrics_endpoint
+    test_message_trace_spans
+    test_bench_mock_telegram
 
     # Unit tests - Message formatting
     log ""
@@ -7560,6 +10102,7 @@ run_unit_tests() {
     test_download_failure_notification
     test_inbox_path_under_tmp
     test_inbox_cleanup_on_offboard
+    test_inbox_gc_quotas
     test_image_path_restriction
     test_send_failure_notification
 
@@ -7596,6 +10139,9 @@ run_unit_tests() {
     log "── Hook Behavior Details Tests (Unit) ──────────────────────────────────"
     test_hook_reads_tmux_env_first
     test_hook_transcript_extraction_retry
+    test_hook_transcript_incremental_tail
+    test_hook_transcript_wait_on_write
+    test_hook_agent_handoff
     test_hook_tmux_fallback_warning
     test_hook_async_forward_timeout
     test_hook_helper_script_exists
@@ -7618,6 +10164,10 @@ run_unit_tests() {
     log ""
     log "── Document/Image Security Tests (Unit) ────────────────────────────────"
     test_document_no_path_restriction
+    test_streaming_multipart_upload
+    test_download_streamed_and_deduplicated
+    test_media_albums_parallel
+    test_streaming_drafts
     test_blocked_filenames_list
     test_20mb_size_limit
 
@@ -7635,6 +10185,7 @@ run_unit_tests() {
     test_worker_pipe_creation_on_startup
     test_worker_pipe_cleanup_on_end
     test_pipe_reader_liveness_check
+    test_pipe_multiplexer_single_thread
 
     # Unit tests - send_to_worker abstraction
     log ""
@@ -7827,6 +10378,12 @@ run_integration_tests() {
     send_message "/end testbot1" >/dev/null 2>&1 || true
 }
 
+run_bench_tests() {
+    log ""
+    log "── Benchmark (mock Telegram API) ───────────────────────────────────────"
+    test_bench_load
+}
+
 run_tunnel_tests() {
     # Tunnel tests
     log ""
@@ -7849,6 +10406,9 @@ main() {
     elif [[ "${FULL:-}" == "1" ]]; then
         mode="full"
         mode_desc="FULL mode: All tests including tunnel (~5 min)"
+    elif [[ "${BENCH:-}" == "1" ]]; then
+        mode="bench"
+        mode_desc="BENCH mode: Throughput and latency against a mock Telegram API (~1-2 min)"
     else
         mode_desc="DEFAULT mode: Unit + Integration tests (~2-3 min)"
     fi
@@ -7856,16 +10416,21 @@ main() {
     log "═══════════════════════════════════════════════════════════════════════"
     log ""
 
-    require_token
-
     cd "$SCRIPT_DIR"
 
-    # Always run unit and CLI tests
-    run_unit_tests
-    run_cli_tests
+    if [[ "$mode" == "bench" ]]; then
+        # No token needed: nothing reaches Telegram
+        run_bench_tests
+    else
+        require_token
+
+        # Always run unit and CLI tests
+        run_unit_tests
+        run_cli_tests
+    fi
 
-    # Skip integration tests in FAST mode
-    if [[ "$mode" != "fast" ]]; then
+    # Skip integration tests in FAST and BENCH mode
+    if [[ "$mode" != "fast" && "$mode" != "bench" ]]; then
         run_integration_tests
 
     fi